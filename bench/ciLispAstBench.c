@@ -0,0 +1,211 @@
+#include <time.h>
+#include <unistd.h>
+#include "ciLispApi.h"
+
+// Binary AST benchmark.
+// Generates a program of forms like the ones programs write (let sections with typed variables and a lambda,
+// nested arithmetic over them), then reports forms per second for parsing its text with --stream's
+// ciLispStreamNext and for loading its --dump-ast file with astLoadNext, without checks or evaluation.
+// The loaded forms are dumped again and must give back the file byte for byte.
+//
+//      cilisp_ast_bench [forms] [iterations]
+
+#define NAMES 200 // let variables are drawn from this many names
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// xorshift, so the generated program is the same on every run
+static uint64_t nextRandom(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// symbols are letters only: name i is "v" followed by its base 26 digits
+static void writeName(FILE *out, long i)
+{
+    putc('v', out);
+    do
+    {
+        putc('a' + (int) (i % 26), out);
+        i /= 26;
+    } while (i > 0);
+}
+
+// names NULL: literals only, so a let value does not refer to itself or to its neighbours
+static void writeExpression(FILE *out, uint64_t *state, const long *names, int depth)
+{
+    static const char *opers[] = {"add", "sub", "mult", "max", "min"};
+    int kind = (int) (nextRandom(state) % (depth > 0 ? 5 : 3));
+
+    switch ((kind == 2 && names == NULL) ? 0 : kind)
+    {
+        case 0:
+            fprintf(out, "%ld", (long) (nextRandom(state) % 100000) - 50000);
+            return;
+        case 1:
+            fprintf(out, "%.3f", (double) (nextRandom(state) % 1000000) / 1000);
+            return;
+        case 2:
+            writeName(out, names[nextRandom(state) % 4]);
+            return;
+        default:
+            fprintf(out, "(%s ", opers[nextRandom(state) % 5]);
+            writeExpression(out, state, names, depth - 1);
+            putc(' ', out);
+            writeExpression(out, state, names, depth - 1);
+            putc(')', out);
+    }
+}
+
+// ((let (int a ...) (double b ...) (c ...) (d ...) (f lambda (x y) ...)) (f ... ...)), one per line
+static void writeProgram(FILE *out, long forms)
+{
+    uint64_t state = 2463534242ULL;
+
+    for (long i = 0; i < forms; i++)
+    {
+        long names[4];
+        for (int n = 0; n < 4; n++)
+            names[n] = (long) (nextRandom(&state) % NAMES);
+
+        fputs("((let", out);
+        for (int n = 0; n < 4; n++)
+        {
+            fputs(n == 0 ? " (int " : n == 1 ? " (double " : " (", out);
+            writeName(out, names[n]);
+            putc(' ', out);
+            writeExpression(out, &state, NULL, 1);
+            putc(')', out);
+        }
+        fputs(" (f lambda (x y) (add (mult x ", out);
+        writeName(out, names[0]);
+        fputs(") ", out);
+        writeExpression(out, &state, names, 2);
+        fputs(" y))) (f ", out);
+        writeExpression(out, &state, names, 3);
+        putc(' ', out);
+        writeExpression(out, &state, names, 3);
+        fputs("))\n", out);
+    }
+}
+
+static long fileSize(FILE *file)
+{
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    return size;
+}
+
+// the forms of in, parsed (binary false) or loaded, freed again; written to dump when it is not NULL
+static long readForms(FILE *in, bool binary, FILE *dump)
+{
+    CILISP_CONTEXT ctx;
+    long forms = 0;
+    AST_NODE *form;
+
+    ciLispContextInit(&ctx);
+    if (dump != NULL)
+        astDumpBegin(&ctx, dump);
+
+    rewind(in);
+    if (binary ? !astLoadBegin(&ctx, in) : !ciLispStreamBegin(&ctx, in))
+        forms = -1;
+
+    while (forms >= 0 && (form = binary ? astLoadNext(&ctx) : ciLispStreamNext(&ctx)) != NULL)
+    {
+        astDumpForm(&ctx, form);
+        freeNode(form);
+        forms++;
+    }
+
+    if (ctx.errorCount > 0)
+        forms = -1;
+    ciLispContextFree(&ctx); // closes dump
+    return forms;
+}
+
+// best time of iterations runs
+static double timeForms(FILE *in, bool binary, int iterations, long expected, long *failures)
+{
+    double best = INFINITY;
+
+    for (int run = 0; run < iterations; run++)
+    {
+        double start = now();
+        long forms = readForms(in, binary, NULL);
+        double elapsed = now() - start;
+
+        if (forms != expected)
+            (*failures)++;
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    long forms = argc > 1 ? atol(argv[1]) : 100000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 5;
+    char textPath[] = "/tmp/cilisp_ast_bench_XXXXXX";
+    char astPath[] = "/tmp/cilisp_ast_bench_XXXXXX";
+    int textFile = mkstemp(textPath);
+    int astFile = mkstemp(astPath);
+    long failures = 0;
+
+    if (forms < 1 || iterations < 1 || textFile < 0 || astFile < 0)
+        return EXIT_FAILURE;
+    close(astFile);
+
+    FILE *text = fdopen(textFile, "w+");
+    writeProgram(text, forms);
+    fflush(text);
+
+    // the file is written by a parse of the text, the same as cilisp --stream --dump-ast
+    if (readForms(text, false, fopen(astPath, "wb")) != forms)
+        failures++;
+    FILE *ast = fopen(astPath, "rb");
+
+    // a dump of the loaded forms is the file again
+    char *copy = NULL;
+    size_t copyLength = 0;
+    if (readForms(ast, true, open_memstream(&copy, &copyLength)) != forms)
+        failures++;
+    long astLength = fileSize(ast);
+    char *original = malloc(astLength);
+    if (fread(original, 1, astLength, ast) != (size_t) astLength || copyLength != (size_t) astLength ||
+        memcmp(original, copy, astLength) != 0)
+    {
+        printf("the loaded forms do not dump to the same file\n");
+        failures++;
+    }
+
+    double parseTime = timeForms(text, false, iterations, forms, &failures);
+    double loadTime = timeForms(ast, true, iterations, forms, &failures);
+    long textLength = fileSize(text);
+
+    printf("%-8s %12s %14s %12s\n", "input", "MB", "forms/s", "ms");
+    printf("%-8s %12.1f %14.0f %12.1f\n", "text", textLength / 1e6, forms / parseTime, parseTime * 1e3);
+    printf("%-8s %12.1f %14.0f %12.1f\n", "ast", astLength / 1e6, forms / loadTime, loadTime * 1e3);
+    printf("load is %.1fx faster, the file %.0f%% of the text\n", parseTime / loadTime, 100.0 * astLength / textLength);
+
+    fclose(text);
+    fclose(ast);
+    unlink(textPath);
+    unlink(astPath);
+    free(original);
+    free(copy);
+
+    printf("failures: %ld\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
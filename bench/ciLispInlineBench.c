@@ -0,0 +1,104 @@
+#include <time.h>
+#include "ciLispApi.h"
+
+// Lambda call benchmark.
+// Evaluates programs built around small helper lambdas, the calls optimizeForm inlines, and reports evaluations
+// and lambda calls per second. The factorial and the sum are recursive and stay plain calls, as a reference.
+// Build the library with -DINLINE_MAX_NODES=0 to get the numbers without inlining.
+// The metrics counters (cilispMetricsEnable) give the calls that were really made and the heap allocations for
+// their arguments, which should stay at the few that size the argument value stack.
+//
+//      cilisp_inline_bench [iterations]
+
+typedef struct {
+    const char *name;
+    const char *source;
+    long calls; // lambda calls per evaluation
+    long expected;
+} INLINE_CASE;
+
+static const INLINE_CASE cases[] = {
+        {"square",
+                "((let (sq lambda (x) (mult x x)) (s 0)) (progn (dotimes (i 1000) (set s (add s (sq i)))) s))",
+                1000, 332833500},
+        {"nested",
+                "((let (sq lambda (x) (mult x x)) (norm lambda (a b) (add (sq a) (sq b))) (s 0))"
+                " (progn (dotimes (i 1000) (set s (add s (norm i 2)))) s))",
+                3000, 332837500},
+        {"clamp",
+                "((let (clamp lambda (x lo hi) (cond (less x lo) lo (cond (greater x hi) hi x))) (s 0))"
+                " (progn (dotimes (i 1000) (set s (add s (clamp i 100 900)))) s))",
+                1000, 499600},
+        {"factorial",
+                "((let (f lambda (n) (cond (less n 1) 1 (mult n (f (sub n 1)))))) (add (f 10) (f 10) (f 10)))",
+                33, 10886400},
+        {"sum",
+                "((let (f lambda (n acc) (cond (less n 1) acc (f (sub n 1) (add acc n))))) (f 300 0))",
+                301, 45150},
+};
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// a counter of the metrics, summed over every handle so far
+static unsigned long metric(const char *name)
+{
+    char *text = NULL;
+    size_t length = 0;
+    FILE *out = open_memstream(&text, &length);
+    unsigned long value = 0;
+
+    cilispMetricsWrite(out);
+    fclose(out);
+
+    char pattern[128];
+    snprintf(pattern, sizeof(pattern), "\n%s ", name);
+    char *line = strstr(text, pattern);
+    if (line != NULL)
+        value = strtoul(line + strlen(pattern), NULL, 10);
+
+    free(text);
+    return value;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    char error[ERROR_BUFFER];
+    long failures = 0;
+
+    cilispMetricsEnable();
+    printf("%-10s %14s %16s %14s %16s\n", "program", "evals/s", "calls/s", "real calls", "allocations");
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        CILISP_PROGRAM *program = cilispCompile(cases[c].source, error, sizeof(error));
+        if (program == NULL)
+        {
+            printf("%s: %s\n", cases[c].name, error);
+            return EXIT_FAILURE;
+        }
+
+        RET_VAL result;
+        unsigned long calls = metric("cilisp_lambda_calls_total");
+        unsigned long allocations = metric("cilisp_argument_allocations_total");
+        double start = now();
+        for (int i = 0; i < iterations; i++)
+        {
+            if (cilispEval(program, &result) != 0 || result.type != INT_TYPE || result.value.ival != cases[c].expected)
+                failures++;
+        }
+        double evalRate = iterations / (now() - start);
+
+        cilispFree(program);
+        printf("%-10s %14.0f %16.0f %14lu %16lu\n", cases[c].name, evalRate, evalRate * cases[c].calls,
+               metric("cilisp_lambda_calls_total") - calls, metric("cilisp_argument_allocations_total") - allocations);
+    }
+
+    printf("failures: %ld\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
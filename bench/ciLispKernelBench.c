@@ -0,0 +1,151 @@
+#include <time.h>
+#include "ciLispApi.h"
+
+// Operator kernel benchmark.
+// Times the int pow, remainder and the log2/log10 kernels of ciLispOperators.def against the alternatives:
+// pow through libm and lround (the old int pow), fmod on the operands converted to double (what a double
+// operand costs), and a log divided by log(2) or log(10) (what log2 and log10 had to be written as before).
+// The same operands go through both, and every result of the alternative that differs is counted: pow
+// operands are chosen so the result fits in a long, a difference is a result rounded through a double.
+//
+//      cilisp_kernel_bench [operations] [iterations]
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// xorshift, so the operands are the same on every run
+static uint64_t nextRandom(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static long oldPow(long a, long b) { return lround(pow(a, b)); }
+static long oldRemainder(long a, long b) { return (long) fmod((double) a, (double) b); }
+static double oldLog2(double a) { return log(a) / log(2); }
+static double oldLog10(double a) { return log(a) / log(10); }
+
+static long newPow(long a, long b) { return POWIntKernel(a, b); }
+static long newRemainder(long a, long b) { return REMAINDERIntKernel(a, b); }
+static double newLog2(double a) { return LOG2DoubleKernel(a, 0); }
+static double newLog10(double a) { return LOG10DoubleKernel(a, 0); }
+
+static volatile long longSink;
+static volatile double doubleSink;
+
+// best time of iterations runs over all operands, in ns per operation
+static double timeInt(long (*kernel)(long, long), const long *a, const long *b, long count, int iterations)
+{
+    double best = INFINITY;
+
+    for (int run = 0; run < iterations; run++)
+    {
+        long sum = 0;
+        double start = now();
+        for (long i = 0; i < count; i++)
+            sum += kernel(a[i], b[i]);
+        double elapsed = now() - start;
+        longSink = sum;
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    return best * 1e9 / count;
+}
+
+static double timeDouble(double (*kernel)(double), const double *a, long count, int iterations)
+{
+    double best = INFINITY;
+
+    for (int run = 0; run < iterations; run++)
+    {
+        double sum = 0;
+        double start = now();
+        for (long i = 0; i < count; i++)
+            sum += kernel(a[i]);
+        double elapsed = now() - start;
+        doubleSink = sum;
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    return best * 1e9 / count;
+}
+
+static void compareInt(const char *name, long (*oldKernel)(long, long), long (*newKernel)(long, long),
+                       const long *a, const long *b, long count, int iterations)
+{
+    long differences = 0;
+    for (long i = 0; i < count; i++)
+        differences += oldKernel(a[i], b[i]) != newKernel(a[i], b[i]);
+
+    double oldTime = timeInt(oldKernel, a, b, count, iterations);
+    double newTime = timeInt(newKernel, a, b, count, iterations);
+    printf("%-10s old %6.2f ns  new %6.2f ns  %5.1fx  %ld of %ld results differ\n",
+           name, oldTime, newTime, oldTime / newTime, differences, count);
+}
+
+static void compareDouble(const char *name, double (*oldKernel)(double), double (*newKernel)(double),
+                          const double *a, long count, int iterations)
+{
+    long differences = 0;
+    for (long i = 0; i < count; i++)
+        differences += oldKernel(a[i]) != newKernel(a[i]);
+
+    double oldTime = timeDouble(oldKernel, a, count, iterations);
+    double newTime = timeDouble(newKernel, a, count, iterations);
+    printf("%-10s old %6.2f ns  new %6.2f ns  %5.1fx  %ld of %ld results differ\n",
+           name, oldTime, newTime, oldTime / newTime, differences, count);
+}
+
+int main(int argc, char **argv)
+{
+    long count = argc > 1 ? atol(argv[1]) : 1000000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 5;
+    if (count < 1 || iterations < 1)
+        return EXIT_FAILURE;
+
+    long *a = malloc(count * sizeof(long));
+    long *b = malloc(count * sizeof(long));
+    double *x = malloc(count * sizeof(double));
+    uint64_t state = 88172645463325252ULL;
+
+    // pow: bases -40..40 and exponents up to the largest one that does not overflow
+    for (long i = 0; i < count; i++)
+    {
+        a[i] = (long) (nextRandom(&state) % 81) - 40;
+        long largest = (labs(a[i]) < 2) ? 62 : (long) (62 / log2((double) labs(a[i])));
+        b[i] = (long) (nextRandom(&state) % (uint64_t) (largest + 1));
+    }
+    compareInt("pow", oldPow, newPow, a, b, count, iterations);
+
+    // remainder: any sign, divisors never 0
+    for (long i = 0; i < count; i++)
+    {
+        a[i] = (long) (nextRandom(&state) >> 1) - (long) (nextRandom(&state) >> 1);
+        b[i] = (long) (nextRandom(&state) % 2000000) - 1000000;
+        if (b[i] == 0)
+            b[i] = 7;
+    }
+    compareInt("remainder", oldRemainder, newRemainder, a, b, count, iterations);
+
+    // log: integers, half of them powers of 2 or of 10, where the exact result is an integer
+    for (long i = 0; i < count; i++)
+        x[i] = (i % 2) ? (double) (nextRandom(&state) % 1000000 + 1) : exp2((double) (nextRandom(&state) % 64));
+    compareDouble("log2", oldLog2, newLog2, x, count, iterations);
+
+    for (long i = 0; i < count; i++)
+        x[i] = (i % 2) ? (double) (nextRandom(&state) % 1000000 + 1) : pow(10, (double) (nextRandom(&state) % 16));
+    compareDouble("log10", oldLog10, newLog10, x, count, iterations);
+
+    free(a);
+    free(b);
+    free(x);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+#include <time.h>
+#include "ciLispApi.h"
+
+// Scanner benchmark.
+// Parses large generated forms made of one kind of token (int literals, double literals or symbols) and
+// reports tokens per second for the scan and parse, without checks or evaluation.
+// Every literal is also parsed with parseDecimal and compared with strtod/strtol; a different bit is a failure.
+//
+//      cilisp_lex_bench [tokens] [iterations]
+
+// operands of one (add ...), the form is a list of them: a single list of all the tokens would need a
+// parser stack as deep as the list
+#define GROUP_SIZE 500
+
+typedef enum {
+    INT_LITERALS,
+    DOUBLE_LITERALS,
+    SYMBOLS
+} TOKEN_KIND;
+
+static const char *kindNames[] = {"ints", "doubles", "symbols"};
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// xorshift, so the generated text is the same on every run
+static uint64_t nextRandom(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// a literal of 1 to 20 digits, doubles with 0 to 19 of them after the point (at least one in front of it)
+static int randomLiteral(char *text, TOKEN_KIND kind, uint64_t *state)
+{
+    int length = 0;
+    int digits = 1 + (int) (nextRandom(state) % 20);
+    int point = (kind == DOUBLE_LITERALS) ? (int) (nextRandom(state) % digits) : -1;
+
+    if (nextRandom(state) % 4 == 0)
+        text[length++] = '-';
+    for (int i = 0; i < digits; i++)
+    {
+        if (i == digits - point)
+            text[length++] = '.';
+        text[length++] = (char) ('0' + nextRandom(state) % 10);
+    }
+    if (point == 0)
+        text[length++] = '.';
+    text[length] = '\0';
+
+    return length;
+}
+
+static long checkLiterals(long count)
+{
+    uint64_t state = 88172645463325252ULL;
+    char text[32];
+    long failures = 0;
+
+    for (long i = 0; i < count; i++)
+    {
+        TOKEN_KIND kind = (i % 2) ? DOUBLE_LITERALS : INT_LITERALS;
+        int length = randomLiteral(text, kind, &state);
+        RET_VAL val = parseDecimal(text, (size_t) length);
+
+        bool same;
+        if (kind == INT_LITERALS)
+            same = (val.type == INT_TYPE && val.value.ival == strtol(text, NULL, 10));
+        else
+        {
+            double expected = strtod(text, NULL);
+            same = (val.type == DOUBLE_TYPE && memcmp(&val.value.dval, &expected, sizeof(double)) == 0);
+        }
+
+        if (!same && failures++ == 0)
+            printf("parseDecimal(%s) differs from strto*\n", text);
+    }
+
+    return failures;
+}
+
+// (add (add t t ...) (add t t ...) ...), the number of tokens it has goes to tokenCount
+static char *benchSource(TOKEN_KIND kind, long tokens, long *tokenCount)
+{
+    long groups = tokens / (GROUP_SIZE + 3) + 1;
+    size_t size = (size_t) groups * (GROUP_SIZE * 24 + 16) + 64;
+    char *source = malloc(size);
+    uint64_t state = 2463534242ULL;
+    size_t length = 0;
+    char text[32];
+
+    *tokenCount = 0;
+    if (kind == SYMBOLS)
+    {
+        length += snprintf(source + length, size - length, "((let (x 1)) ");
+        *tokenCount += 8;
+    }
+
+    length += snprintf(source + length, size - length, "(add");
+    *tokenCount += 2;
+
+    for (long g = 0; g < groups; g++)
+    {
+        length += snprintf(source + length, size - length, " (add");
+        for (int i = 0; i < GROUP_SIZE; i++)
+        {
+            if (kind == SYMBOLS)
+                strcpy(text, "x");
+            else
+                randomLiteral(text, kind, &state);
+            length += snprintf(source + length, size - length, " %s", text);
+        }
+        length += snprintf(source + length, size - length, ")");
+        *tokenCount += GROUP_SIZE + 3;
+    }
+
+    snprintf(source + length, size - length, kind == SYMBOLS ? "))" : ")");
+    *tokenCount += (kind == SYMBOLS) ? 2 : 1;
+
+    return source;
+}
+
+int main(int argc, char **argv)
+{
+    long tokens = argc > 1 ? atol(argv[1]) : 1000000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 10;
+    long failures = checkLiterals(1000000);
+
+    printf("%-8s %12s %14s %12s\n", "tokens", "count", "tokens/s", "MB/s");
+
+    for (TOKEN_KIND kind = INT_LITERALS; kind <= SYMBOLS; kind++)
+    {
+        long tokenCount;
+        char *source = benchSource(kind, tokens, &tokenCount);
+        CILISP_CONTEXT ctx;
+
+        ciLispContextInit(&ctx);
+
+        double start = now();
+        for (int i = 0; i < iterations; i++)
+        {
+            AST_NODE *form = ciLispParse(&ctx, source);
+            if (form == NULL || ctx.errorCount != 0)
+                failures++;
+            freeNode(form);
+        }
+        double elapsed = now() - start;
+
+        printf("%-8s %12ld %14.0f %12.1f\n", kindNames[kind], tokenCount, tokenCount * iterations / elapsed,
+               strlen(source) * iterations / elapsed / 1e6);
+
+        ciLispContextFree(&ctx);
+        free(source);
+    }
+
+    printf("failures: %ld\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,105 @@
+#include <time.h>
+#include "ciLispApi.h"
+
+// Symbol lookup benchmark.
+// For growing binding counts n, compiles and evaluates ((let (va 1) (vb (add va 1)) ...) (add <last> va)):
+// every binding refers to the one before it, so one evaluation does n lookups spread over the whole let block.
+// Parse and eval throughput are reported per binding count; the result is checked against n + 1.
+// Build the library with -DSCOPE_INDEX_THRESHOLD=1000000 to get the numbers of plain list scopes.
+//
+//      cilisp_scope_bench [maxBindings] [iterations]
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// symbols are letters only: "v" followed by the index in base 26
+static void bindingName(char *name, int index)
+{
+    char digits[16];
+    int length = 0;
+
+    do
+    {
+        digits[length++] = (char) ('a' + index % 26);
+        index /= 26;
+    } while (index > 0);
+
+    *name++ = 'v';
+    while (length > 0)
+        *name++ = digits[--length];
+    *name = '\0';
+}
+
+static char *benchSource(int bindings)
+{
+    size_t size = (size_t) bindings * 32 + 64;
+    char *source = malloc(size);
+    char name[16];
+    char previous[16];
+    size_t length = 0;
+
+    length += snprintf(source + length, size - length, "((let");
+    for (int i = 0; i < bindings; i++)
+    {
+        bindingName(name, i);
+        if (i == 0)
+            length += snprintf(source + length, size - length, " (%s 1)", name);
+        else
+            length += snprintf(source + length, size - length, " (%s (add %s 1))", name, previous);
+        strcpy(previous, name);
+    }
+    snprintf(source + length, size - length, ") (add %s va))", previous);
+
+    return source;
+}
+
+int main(int argc, char **argv)
+{
+    int maxBindings = argc > 1 ? atoi(argv[1]) : 4096;
+    int iterations = argc > 2 ? atoi(argv[2]) : 100;
+    char error[ERROR_BUFFER];
+    long failures = 0;
+
+    printf("%8s %14s %14s %16s\n", "bindings", "parses/s", "evals/s", "lookups/s");
+
+    for (int bindings = 4; bindings <= maxBindings; bindings *= 4)
+    {
+        char *source = benchSource(bindings);
+        // keep the total work per row roughly the same
+        int rounds = iterations * 4096 / bindings;
+        CILISP_PROGRAM *program = NULL;
+
+        double start = now();
+        for (int i = 0; i < rounds; i++)
+        {
+            cilispFree(program);
+            if ((program = cilispCompile(source, error, sizeof(error))) == NULL)
+            {
+                printf("%d bindings: %s\n", bindings, error);
+                return EXIT_FAILURE;
+            }
+        }
+        double parseRate = rounds / (now() - start);
+
+        RET_VAL result;
+        start = now();
+        for (int i = 0; i < rounds; i++)
+        {
+            if (cilispEval(program, &result) != 0 || result.type != INT_TYPE || result.value.ival != bindings + 1)
+                failures++;
+        }
+        double evalRate = rounds / (now() - start);
+
+        printf("%8d %14.0f %14.0f %16.0f\n", bindings, parseRate, evalRate, evalRate * (bindings + 1));
+
+        cilispFree(program);
+        free(source);
+    }
+
+    printf("failures: %ld\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,168 @@
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "ciLispApi.h"
+
+// Load generator for cilisp --serve.
+// Every connection runs on a thread of its own and keeps depth requests in flight: a new one is sent as soon as
+// a response comes back. Each request binds new input values to the same expression and every response is
+// checked. Latency is from sending a request to reading its response; percentiles are over all connections.
+//
+//      cilisp --serve /tmp/cilisp.sock &
+//      cilisp_server_bench /tmp/cilisp.sock [connections] [depth] [requests per connection]
+
+#define BENCH_EXPRESSION "((let (f lambda (a b) (add (mult a a) b))) (f x (mult y 2)))"
+
+typedef struct {
+    const char *path;
+    int depth;
+    long requests;
+    double *latencies;
+    long failures;
+} BENCH_CONNECTION;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool readFully(int fd, void *data, size_t length)
+{
+    for (size_t done = 0; done < length;)
+    {
+        ssize_t count = read(fd, (char *) data + done, length - done);
+        if (count <= 0)
+            return false;
+        done += (size_t) count;
+    }
+    return true;
+}
+
+static bool sendRequest(int fd, long i)
+{
+    char frame[256];
+    int length = snprintf(frame + 4, sizeof(frame) - 4, "%s\nx %ld\ny 0.25", BENCH_EXPRESSION, i % 1000);
+    uint32_t prefix = htonl((uint32_t) length);
+
+    memcpy(frame, &prefix, 4);
+    return write(fd, frame, (size_t) length + 4) == length + 4;
+}
+
+// x * x + 0.5, the response is "double <value>"
+static bool checkResponse(const char *response, long i)
+{
+    long x = i % 1000;
+    return strncmp(response, "double ", 7) == 0 && strtod(response + 7, NULL) == (double) (x * x) + 0.5;
+}
+
+static void *benchConnection(void *argument)
+{
+    BENCH_CONNECTION *connection = argument;
+    struct sockaddr_un address = {AF_UNIX};
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    double sent[connection->depth];
+
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", connection->path);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0)
+    {
+        perror(connection->path);
+        connection->failures = connection->requests;
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+
+    // responses come back in the order of the requests, so the send times are a ring
+    long next = 0;
+    for (; next < connection->depth && next < connection->requests; next++)
+    {
+        sent[next % connection->depth] = now();
+        sendRequest(fd, next);
+    }
+
+    for (long i = 0; i < connection->requests; i++)
+    {
+        uint32_t length;
+        char response[256];
+
+        if (!readFully(fd, &length, 4) || (length = ntohl(length)) >= sizeof(response) ||
+            !readFully(fd, response, length))
+        {
+            connection->failures += connection->requests - i;
+            break;
+        }
+        response[length] = '\0';
+        connection->latencies[i] = now() - sent[i % connection->depth];
+
+        if (!checkResponse(response, i) && connection->failures++ == 0)
+            printf("unexpected response to request %ld: %s\n", i, response);
+
+        if (next < connection->requests)
+        {
+            sent[next % connection->depth] = now();
+            sendRequest(fd, next++);
+        }
+    }
+
+    close(fd);
+    return NULL;
+}
+
+static int compareLatencies(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s SOCKET [connections] [depth] [requests per connection]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int connectionCount = argc > 2 ? atoi(argv[2]) : 4;
+    int depth = argc > 3 ? atoi(argv[3]) : 16;
+    long requests = argc > 4 ? atol(argv[4]) : 100000;
+    if (connectionCount < 1 || depth < 1 || requests < 1)
+        return EXIT_FAILURE;
+
+    BENCH_CONNECTION connections[connectionCount];
+    pthread_t threads[connectionCount];
+    double *latencies = calloc((size_t) (requests * connectionCount), sizeof(double));
+
+    double start = now();
+    for (int c = 0; c < connectionCount; c++)
+    {
+        connections[c] = (BENCH_CONNECTION) {argv[1], depth, requests, latencies + c * requests, 0};
+        pthread_create(&threads[c], NULL, benchConnection, &connections[c]);
+    }
+
+    long failures = 0;
+    for (int c = 0; c < connectionCount; c++)
+    {
+        pthread_join(threads[c], NULL);
+        failures += connections[c].failures;
+    }
+    double elapsed = now() - start;
+
+    long total = requests * connectionCount;
+    qsort(latencies, total, sizeof(double), compareLatencies);
+
+    printf("%d connections, %d in flight each: %ld requests in %.3f s, %.0f requests/s\n",
+           connectionCount, depth, total, elapsed, total / elapsed);
+    printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+           latencies[total / 2] * 1e6, latencies[total * 9 / 10] * 1e6, latencies[total * 99 / 100] * 1e6,
+           latencies[total * 999 / 1000] * 1e6, latencies[total - 1] * 1e6);
+    printf("failures: %ld\n", failures);
+
+    free(latencies);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
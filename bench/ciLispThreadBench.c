@@ -0,0 +1,113 @@
+#include <pthread.h>
+#include <time.h>
+#include "ciLispApi.h"
+
+// Multi-threaded stress benchmark.
+// Every thread compiles and evaluates its own programs (one interpreter context per handle) and checks the
+// results, first with parsing in the loop and then evaluating one compiled program with new inputs each time.
+// Throughput is reported for 1, 2, 4... threads so the scaling can be compared against the single thread run.
+//
+//      cilisp_thread_bench [maxThreads] [iterations]
+
+#define BENCH_SOURCE "((let (f lambda (n) (cond (less n 1) 1 (mult n (f (sub n 1))))) (int k 3)) (add (f k) (mult x y) (rand)))"
+
+typedef struct {
+    int iterations;
+    bool reparse;
+    long failures;
+} BENCH_THREAD;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool check(CILISP_PROGRAM *program, long x)
+{
+    RET_VAL result;
+
+    cilispBindInt(program, "x", x);
+    cilispBindDouble(program, "y", 0.5);
+    if (cilispEval(program, &result) != 0 || result.type != DOUBLE_TYPE)
+        return false;
+
+    // 3! + x * 0.5 + rand, with rand in [0, 1]
+    double expected = 6 + x * 0.5;
+    return result.value.dval >= expected && result.value.dval <= expected + 1;
+}
+
+static void *benchThread(void *arg)
+{
+    BENCH_THREAD *thread = arg;
+    char error[ERROR_BUFFER];
+    CILISP_PROGRAM *program = NULL;
+
+    for (int i = 0; i < thread->iterations; i++)
+    {
+        if (program == NULL && (program = cilispCompile(BENCH_SOURCE, error, sizeof(error))) == NULL)
+        {
+            thread->failures++;
+            continue;
+        }
+
+        if (!check(program, i))
+            thread->failures++;
+
+        if (thread->reparse)
+        {
+            cilispFree(program);
+            program = NULL;
+        }
+    }
+
+    cilispFree(program);
+    return NULL;
+}
+
+static double run(int threadCount, int iterations, bool reparse, long *failures)
+{
+    pthread_t threads[threadCount];
+    BENCH_THREAD state[threadCount];
+
+    double start = now();
+    for (int i = 0; i < threadCount; i++)
+    {
+        state[i] = (BENCH_THREAD) {iterations, reparse, 0};
+        pthread_create(&threads[i], NULL, benchThread, &state[i]);
+    }
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        pthread_join(threads[i], NULL);
+        *failures += state[i].failures;
+    }
+
+    return (double) threadCount * iterations / (now() - start);
+}
+
+int main(int argc, char **argv)
+{
+    int maxThreads = argc > 1 ? atoi(argv[1]) : 8;
+    int iterations = argc > 2 ? atoi(argv[2]) : 20000;
+    long failures = 0;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        bool reparse = (pass == 0);
+        double single = 0;
+
+        printf("%s\n", reparse ? "parse + eval" : "eval only");
+        for (int threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+        {
+            double rate = run(threadCount, iterations, reparse, &failures);
+            if (threadCount == 1)
+                single = rate;
+            printf("  %2d threads: %12.0f evals/s  (%.2fx)\n", threadCount, rate, rate / single);
+        }
+    }
+
+    printf("failures: %ld\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,40 +1,122 @@
+#include <limits.h>
+#include <time.h>
 #include "ciLisp.h"
 
 
-void yyerror(char *s) {
-    fprintf(stderr, "\nERROR: %s\n", s);
+void yyerror(yyscan_t scanner, CILISP_CONTEXT *ctx, const char *s) {
+    if (ctx != NULL && ctx->metrics != NULL)
+        METRIC_ADD(ctx->metrics->parseErrors, 1);
+    ciLispError(ctx, s);
+}
+
+void ciLispError(CILISP_CONTEXT *ctx, const char *s) {
+    if (ctx == NULL) {
+        fprintf(stderr, "\nERROR: %s\n", s);
+        return;
+    }
+
+    if (ctx->errorCount++ == 0)
+        snprintf(ctx->error, ERROR_BUFFER, "%s", s);
+
+    if (ctx->errorStream != NULL)
+        fprintf(ctx->errorStream, "\nERROR: %s\n", s);
     // note stderr that normally defaults to stdout, but can be redirected: ./src 2> src.log
     // CLion will display stderr in a different color from stdin and stdout
 }
 
-// Array of string values for operations.
-// Must be in sync with funcs in the OPER_TYPE enum in order for resolveFunc to work.
+static void contextReset(CILISP_CONTEXT *ctx)
+{
+    memset(ctx, 0, sizeof(CILISP_CONTEXT));
+    randomSeed(&ctx->random, RANDOM_DEFAULT_SEED);
+    ctx->generation = 1; // fresh nodes start out at 0, so nothing counts as remembered
+}
+
+void ciLispContextInit(CILISP_CONTEXT *ctx)
+{
+    contextReset(ctx);
+    ctx->metrics = metricsAttach();
+}
+
+void ciLispContextFree(CILISP_CONTEXT *ctx)
+{
+    if (ctx->scanner != NULL)
+        yylex_destroy(ctx->scanner);
+    if (ctx->parser != NULL)
+        yypstate_delete(ctx->parser);
+
+    emitEnd(ctx);
+    astDumpEnd(ctx);
+    astLoadEnd(ctx);
+    sessionEnd(ctx);
+    readClose(&ctx->in);
+    outputFlush(ctx);
+    bufferFree(&ctx->output);
+
+    freeNode(ctx->form);
+    freeNode(ctx->prelude);
+
+    clearInputs(ctx);
+    free(ctx->argStack);
+    metricsDetach(ctx->metrics);
+
+    contextReset(ctx); // counts nothing until it is initialized again
+}
+
+void clearInputs(CILISP_CONTEXT *ctx)
+{
+    INPUT_BINDING *currInput = ctx->inputs;
+    INPUT_BINDING *prevInput;
+    while (currInput != NULL)
+    {
+        prevInput = currInput;
+        currInput = currInput->next;
+
+        free(prevInput->ident);
+        free(prevInput);
+    }
+
+    ctx->inputs = NULL;
+}
+
+void bindInput(CILISP_CONTEXT *ctx, const char *ident, RET_VAL val)
+{
+    INPUT_BINDING *node;
+
+    for (node = ctx->inputs; node != NULL; node = node->next)
+    {
+        if (!strcmp(node->ident, ident))
+        {
+            node->val = val;
+            return;
+        }
+    }
+
+    if ((node = calloc(sizeof(INPUT_BINDING), 1)) == NULL)
+    {
+        ciLispError(ctx, "Memory allocation failed!");
+        return;
+    }
+
+    node->ident = strdup(ident);
+    node->val = val;
+    node->next = ctx->inputs;
+    ctx->inputs = node;
+}
+
+// Array of string values for operations, indexed by OPER_TYPE. Ends with "" for resolveFunc.
 char *funcNames[] = {
-        "neg",
-        "abs",
-        "exp",
-        "sqrt",
-        "add",
-        "sub",
-        "mult",
-        "div",
-        "remainder",
-        "log",
-        "pow",
-        "max",
-        "min",
-        "exp2",
-        "cbrt",
-        "hypot",
-        "read",
-        "rand",
-        "print",
-        "equal",
-        "less",
-        "greater",
+#define OPER(id, name, ...) #name,
+#include "ciLispOperators.def"
+#undef OPER
         ""
 };
 
+const OPER_SPEC operSpecs[] = {
+#define OPER(id, name, arity, result, pure, ...) {arity, result, pure},
+#include "ciLispOperators.def"
+#undef OPER
+};
+
 char *numTypeNames[] = {
         "int",
         "double",
@@ -96,6 +178,17 @@ AST_NODE *createNumberNode(double value, NUM_TYPE type)
     return node;
 }
 
+AST_NODE *createIntNode(long value, NUM_TYPE type)
+{
+    if (type == DOUBLE_TYPE)
+        return createNumberNode((double) value, DOUBLE_TYPE);
+
+    AST_NODE *node = createNumberNode(0, INT_TYPE);
+    node->data.number.value.ival = value;
+
+    return node;
+}
+
 // Called when an f_expr is created (see ciLisp.y).
 // Creates an AST_NODE for a function call.
 // Sets the created AST_NODE's type to function.
@@ -147,20 +240,29 @@ AST_NODE *createSymbolNode(char *ident)
 
 AST_NODE *linkSexprToSexprList(AST_NODE *newNode, AST_NODE *nodeChainHead)
 {
+    // s-expressions that failed to parse (or quit) leave a hole in the list
+    if (newNode == NULL)
+        return nodeChainHead;
+
     newNode->next = nodeChainHead;
     return newNode;
 }
 
 AST_NODE *linkASTtoLetList(SYMBOL_TABLE_NODE *letList, AST_NODE *op)
 {
+    if (op == NULL)
+        return NULL;
+
     op->symbolTable = letList;
+    indexScope(op);
 
     SYMBOL_TABLE_NODE *node = letList;
 
     // Make all symbol table value's parents this s-expression
     while (node != NULL)
     {
-         node->val->parent = op;
+        if (node->val)
+            node->val->parent = op;
         node = node->next;
     }
 
@@ -179,7 +281,7 @@ SYMBOL_TABLE_NODE *createSymbolTableNode(char *type, char *ident, AST_NODE *val)
     // allocate space (or error)
     nodeSize = sizeof(SYMBOL_TABLE_NODE);
     if ((node = calloc(nodeSize, 1)) == NULL)
-        yyerror("Memory allocation failed!");
+        ciLispError(NULL, "Memory allocation failed!");
 
     // copy identifier name
     node->ident = ident;
@@ -204,13 +306,80 @@ AST_NODE *createCondNode(AST_NODE *conditionsExpr, AST_NODE *truthExpr, AST_NODE
 
     AST_NODE *node = newNode(COND_NODE_TYPE);
 
-    // Assign nodes to their respective places.
+    // Assign nodes to their respective places. (any of them can be NULL after a syntax error)
     node->data.condition.condNode = conditionsExpr;
-    conditionsExpr->parent = node;
     node->data.condition.trueNode = truthExpr;
-    truthExpr->parent = node;
     node->data.condition.falseNode = falseExpr;
-    falseExpr->parent = node;
+
+    if (conditionsExpr)
+        conditionsExpr->parent = node;
+    if (truthExpr)
+        truthExpr->parent = node;
+    if (falseExpr)
+        falseExpr->parent = node;
+
+    return node;
+}
+
+// makes node the parent of every s-expression of a body list
+static void parentBody(AST_NODE *node, AST_NODE *body)
+{
+    for (AST_NODE *currNode = body; currNode != NULL; currNode = currNode->next)
+        currNode->parent = node;
+}
+
+AST_NODE *createSequenceNode(AST_NODE *body)
+{
+    AST_NODE *node = newNode(PROGN_NODE_TYPE);
+
+    node->data.sequence.body = body;
+    parentBody(node, body);
+
+    return node;
+}
+
+AST_NODE *createWhileNode(AST_NODE *conditionExpr, AST_NODE *body)
+{
+    AST_NODE *node = newNode(WHILE_NODE_TYPE);
+
+    node->data.loop.condNode = conditionExpr;
+    node->data.loop.body = body;
+
+    if (conditionExpr)
+        conditionExpr->parent = node;
+    parentBody(node, body);
+
+    return node;
+}
+
+AST_NODE *createForNode(char *ident, AST_NODE *startExpr, AST_NODE *endExpr, AST_NODE *body)
+{
+    AST_NODE *node = newNode(FOR_NODE_TYPE);
+
+    // the counter lives in the argTable, where the body finds it the same way it finds lambda arguments
+    node->argTable = createArgTableList(ident, NULL);
+    node->data.loop.startNode = startExpr;
+    node->data.loop.endNode = endExpr;
+    node->data.loop.body = body;
+
+    if (startExpr)
+        startExpr->parent = node;
+    if (endExpr)
+        endExpr->parent = node;
+    parentBody(node, body);
+
+    return node;
+}
+
+AST_NODE *createSetNode(char *ident, AST_NODE *valueExpr)
+{
+    AST_NODE *node = newNode(SET_NODE_TYPE);
+
+    node->data.assignment.ident = ident;
+    node->data.assignment.valueNode = valueExpr;
+
+    if (valueExpr)
+        valueExpr->parent = node;
 
     return node;
 }
@@ -224,7 +393,7 @@ ARG_TABLE_NODE *createArgTableList(char *headName, ARG_TABLE_NODE *list)
     // allocate space (or error)
     nodeSize = sizeof(ARG_TABLE_NODE);
     if ((node = calloc(nodeSize, 1)) == NULL)
-        yyerror("Memory allocation failed!");
+        ciLispError(NULL, "Memory allocation failed!");
 
     // copy identifier name and attach new head to the list
     node->ident = headName;
@@ -242,7 +411,7 @@ SYMBOL_TABLE_NODE *createLambdaSymbolTableNode(char *type, char *ident, ARG_TABL
     // allocate space (or error)
     nodeSize = sizeof(SYMBOL_TABLE_NODE);
     if ((node = calloc(nodeSize, 1)) == NULL)
-        yyerror("Memory allocation failed!");
+        ciLispError(NULL, "Memory allocation failed!");
 
     // same assignments from variable Symbol Table Node
     node->ident = ident;
@@ -252,7 +421,15 @@ SYMBOL_TABLE_NODE *createLambdaSymbolTableNode(char *type, char *ident, ARG_TABL
 
     // change: this is instead a lambda, and its value carries the arguments in its argList
     node->sym_type = LAMBDA_TYPE;
-    val->argTable = argList;
+
+    // a dotimes/for body keeps its counter in its own argTable, the arguments go on a progn around it
+    if (val && val->argTable != NULL)
+        node->val = val = createSequenceNode(val);
+    if (val)
+        val->argTable = argList;
+
+    for (ARG_TABLE_NODE *arg = argList; arg != NULL; arg = arg->next)
+        node->arity++;
 
     return node;
 }
@@ -266,7 +443,7 @@ AST_NODE *newNode(AST_NODE_TYPE type)
 
     nodeSize = sizeof(AST_NODE);
     if ((node = calloc(nodeSize, 1)) == NULL)
-        yyerror("Memory allocation failed!");
+        ciLispError(NULL, "Memory allocation failed!");
 
     node->type = type;
     node->parent = NULL;
@@ -277,6 +454,16 @@ AST_NODE *newNode(AST_NODE_TYPE type)
     return node;
 }
 
+void freeNodeList(AST_NODE *node)
+{
+    while (node != NULL)
+    {
+        AST_NODE *next = node->next;
+        freeNode(node);
+        node = next;
+    }
+}
+
 // Called after execution is done on the base of the tree.
 // (see the program production in ciLisp.y)
 // Recursively frees the whole abstract syntax tree.
@@ -288,8 +475,6 @@ void freeNode(AST_NODE *node)
     if (!node)
         return;
 
-    AST_NODE *currOp;
-
     switch (node->type)
     {
         case NUM_NODE_TYPE:
@@ -297,12 +482,8 @@ void freeNode(AST_NODE *node)
 
         case FUNC_NODE_TYPE:
             // Recursive calls to free child Ops
-            currOp = node->data.function.opList;
-            while (currOp != NULL)
-            {
-                freeNode(currOp);
-                currOp = currOp->next;
-            }
+            freeNodeList(node->data.function.opList);
+            freeNode(node->data.function.inlined);
 
             // Free up identifier string if necessary
             if (node->data.function.oper == CUSTOM_OPER) {
@@ -318,10 +499,33 @@ void freeNode(AST_NODE *node)
             freeNode(node->data.condition.trueNode);
             freeNode(node->data.condition.falseNode);
             break;
+        case PROGN_NODE_TYPE:
+            freeNodeList(node->data.sequence.body);
+            break;
+        case WHILE_NODE_TYPE:
+        case FOR_NODE_TYPE:
+            freeNode(node->data.loop.condNode);
+            freeNode(node->data.loop.startNode);
+            freeNode(node->data.loop.endNode);
+            freeNodeList(node->data.loop.body);
+            break;
+        case SET_NODE_TYPE:
+            free(node->data.assignment.ident);
+            freeNode(node->data.assignment.valueNode);
+            break;
     } // END of switch statement
 
     // free associated symbol table node chain
-    SYMBOL_TABLE_NODE *currNode = node->symbolTable;
+    freeScopeIndex(node);
+    freeSymbolTable(node->symbolTable);
+    freeArgTable(node->argTable);
+
+    free(node);
+}
+
+void freeSymbolTable(SYMBOL_TABLE_NODE *symbolTable)
+{
+    SYMBOL_TABLE_NODE *currNode = symbolTable;
     SYMBOL_TABLE_NODE *prevNode;
     while (currNode !=NULL)
     {
@@ -329,10 +533,14 @@ void freeNode(AST_NODE *node)
         currNode = currNode->next;
 
         free(prevNode->ident);
+        freeNode(prevNode->val);
         free(prevNode);
     }
+}
 
-    ARG_TABLE_NODE *currArg = node->argTable;
+void freeArgTable(ARG_TABLE_NODE *argTable)
+{
+    ARG_TABLE_NODE *currArg = argTable;
     ARG_TABLE_NODE *prevArg;
     while (currArg !=NULL)
     {
@@ -342,19 +550,197 @@ void freeNode(AST_NODE *node)
         free(prevArg->ident);
         free(prevArg);
     }
+}
 
-    free(node);
+/*
+       Budgets
+       evalForm starts the count and eval charges a step per node, comparing against nextCheck only: the
+       limits themselves are looked at when the step limit may be reached or the clock is due. Lambda calls,
+       the only way to recurse, check depth and stack in helperCustomOper.
+     */
+
+static double budgetClock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void budgetExceeded(CILISP_CONTEXT *ctx, BUDGET_KIND kind)
+{
+    char message[ERROR_BUFFER];
+
+    switch (kind)
+    {
+        case BUDGET_STEPS:
+            snprintf(message, ERROR_BUFFER, "budget exceeded: more than %lu steps", ctx->budget.steps);
+            break;
+        case BUDGET_DEPTH:
+            snprintf(message, ERROR_BUFFER, "budget exceeded: lambda calls nested deeper than %lu", ctx->budget.depth);
+            break;
+        case BUDGET_MEMORY:
+            snprintf(message, ERROR_BUFFER, "budget exceeded: more than %zu bytes of stack", ctx->budget.memory);
+            break;
+        default:
+            snprintf(message, ERROR_BUFFER, "budget exceeded: more than %g s", ctx->budget.seconds);
+            break;
+    }
+
+    ctx->exceeded = kind;
+    ctx->nextCheck = 0; // from now on every node returns at once
+    ciLispError(ctx, message);
+}
+
+static void budgetSchedule(CILISP_CONTEXT *ctx)
+{
+    unsigned long next = ULONG_MAX;
+
+    if (ctx->budget.steps > 0)
+        next = ctx->budget.steps + 1;
+    if (ctx->budget.seconds > 0 && ctx->steps + BUDGET_CLOCK_STEPS < next)
+        next = ctx->steps + BUDGET_CLOCK_STEPS;
+
+    ctx->nextCheck = next;
+}
+
+// the slow path of the step count: true when the evaluation is over budget
+static bool budgetCheck(CILISP_CONTEXT *ctx)
+{
+    if (ctx->exceeded != BUDGET_NONE)
+        return true;
+
+    if (ctx->budget.steps > 0 && ctx->steps > ctx->budget.steps)
+        budgetExceeded(ctx, BUDGET_STEPS);
+    else if (ctx->budget.seconds > 0 && budgetClock() > ctx->deadline)
+        budgetExceeded(ctx, BUDGET_TIME);
+    else
+        budgetSchedule(ctx);
+
+    return ctx->exceeded != BUDGET_NONE;
+}
+
+// the stack this evaluation uses so far: the distance of a local to the one in evalForm
+static size_t budgetStack(CILISP_CONTEXT *ctx)
+{
+    char marker;
+    return (ctx->stackBase > &marker) ? (size_t) (ctx->stackBase - &marker) : (size_t) (&marker - ctx->stackBase);
+}
+
+// one more lambda call in progress, false (and the evaluation abandoned) when that is over budget
+static bool budgetEnterCall(CILISP_CONTEXT *ctx)
+{
+    if (ctx->exceeded != BUDGET_NONE)
+        return false;
+
+    if (ctx->budget.depth > 0 && ctx->depth >= ctx->budget.depth)
+        budgetExceeded(ctx, BUDGET_DEPTH);
+    else if (ctx->budget.memory > 0 && budgetStack(ctx) > ctx->budget.memory)
+        budgetExceeded(ctx, BUDGET_MEMORY);
+    else
+        ctx->depth++;
+
+    return ctx->exceeded == BUDGET_NONE;
+}
+
+RET_VAL evalForm(CILISP_CONTEXT *ctx, AST_NODE *root)
+{
+    char stackBase;
+    double started = (ctx->metrics != NULL) ? budgetClock() : 0;
+
+    ctx->generation++;
+    ctx->exceeded = BUDGET_NONE;
+    ctx->steps = 0;
+    ctx->depth = 0;
+    ctx->stackBase = &stackBase;
+    if (ctx->budget.seconds > 0)
+        ctx->deadline = budgetClock() + ctx->budget.seconds;
+    budgetSchedule(ctx);
+
+    RET_VAL result = eval(ctx, root);
+    if (ctx->exceeded != BUDGET_NONE)
+        result = (RET_VAL){DOUBLE_TYPE, NAN};
+
+    ctx->stackBase = NULL;
+    if (ctx->metrics != NULL)
+        metricsEvaluated(ctx->metrics, budgetClock() - started);
+    return result;
+}
+
+long evalStream(CILISP_CONTEXT *ctx, FILE *in, long *failed)
+{
+    long forms = 0;
+
+    // a binary AST file (--dump-ast) is loaded from a mapping of it instead of being parsed
+    bool binary = isAstFile(in);
+
+    *failed = 0;
+    if (binary ? !astLoadBegin(ctx, in) : !ciLispStreamBegin(ctx, in))
+        return -1;
+
+    while (!ctx->quit)
+    {
+        AST_NODE *form = binary ? astLoadNext(ctx) : ciLispStreamNext(ctx);
+
+        if (form == NULL && ctx->errorCount == 0)
+            break; // end of the stream
+
+        // syntax errors are already reported, the stream goes on after them
+        if (ctx->errorCount == 0)
+        {
+            preludeAttach(ctx, form);
+
+            // each static error is reported as it is found, then they are summed up in the output like the REPL does
+            int errors = checkForm(ctx, form, false);
+            if (errors > 0)
+                outputPrintf(ctx, "ERROR: %s\n%d error%s found, the form was not evaluated\n",
+                             ctx->error, errors, errors == 1 ? "" : "s");
+            else if (isEmitting(ctx))
+                emitForm(ctx, form);
+            else if (isDumpingAst(ctx))
+                astDumpForm(ctx, form);
+            else
+            {
+                // a form below a prelude is not optimized: that would walk the prelude again for every form
+                if (ctx->prelude == NULL)
+                    optimizeForm(ctx, form);
+
+                if (!ctx->forkForms)
+                    printRetVal(ctx, evalForm(ctx, form));
+                else if (!evalFormForked(ctx, form))
+                    ctx->errorCount++; // the child reported it
+            }
+        }
+
+        forms++;
+        if (ctx->errorCount > 0)
+            (*failed)++;
+
+        freeNode(form);
+        outputFlush(ctx); // one write per top level form
+        ctx->errorCount = 0;
+        ctx->error[0] = '\0';
+    }
+
+    astLoadEnd(ctx);
+    return forms;
 }
 
 // Evaluates an AST_NODE.
 // returns a RET_VAL storing the the resulting value and type.
 // You'll need to update and expand eval (and the more specific eval functions below)
 // as the project develops.
-RET_VAL eval(AST_NODE *node)
+RET_VAL eval(CILISP_CONTEXT *ctx, AST_NODE *node)
 {
     if (!node)
         return (RET_VAL){DOUBLE_TYPE, NAN};
 
+    // also how an abandoned evaluation unwinds: nextCheck is 0 then
+    if (++ctx->steps >= ctx->nextCheck && budgetCheck(ctx))
+        return (RET_VAL){DOUBLE_TYPE, NAN};
+
+    if (ctx->metrics != NULL)
+        METRIC_ADD(ctx->metrics->nodes[node->type], 1);
+
     RET_VAL result = {DOUBLE_TYPE, NAN}; // see NUM_AST_NODE, because RET_VAL is just an alternative name for it.
 
     // Make calls to other eval functions based on node type.
@@ -362,19 +748,31 @@ RET_VAL eval(AST_NODE *node)
     switch (node->type)
     {
         case FUNC_NODE_TYPE:
-            result = evalFuncNode(node);
+            result = evalFuncNode(ctx, node);
             break;
         case NUM_NODE_TYPE:
-            result = evalNumNode(&node->data.number);
+            result = evalNumNode(ctx, &node->data.number);
             break;
         case SYMBOL_NODE_TYPE:
-            result = evalSymbolNode(node);
+            result = evalSymbolNode(ctx, node);
             break;
         case COND_NODE_TYPE:
-            result = evalCondNode(&node->data.condition);
+            result = evalCondNode(ctx, &node->data.condition);
+            break;
+        case PROGN_NODE_TYPE:
+            result = evalSequenceNode(ctx, &node->data.sequence);
+            break;
+        case WHILE_NODE_TYPE:
+            result = evalWhileNode(ctx, &node->data.loop);
+            break;
+        case FOR_NODE_TYPE:
+            result = evalForNode(ctx, node);
+            break;
+        case SET_NODE_TYPE:
+            result = evalSetNode(ctx, node);
             break;
         default:
-            yyerror("Invalid AST_NODE_TYPE, probably invalid writes somewhere!");
+            ciLispError(ctx, "Invalid AST_NODE_TYPE, probably invalid writes somewhere!");
     }
 
     return result;
@@ -382,7 +780,7 @@ RET_VAL eval(AST_NODE *node)
 
 // returns a pointer to the NUM_AST_NODE (aka RET_VAL) referenced by node.
 // DOES NOT allocate space for a new RET_VAL.
-RET_VAL evalNumNode(NUM_AST_NODE *numNode)
+RET_VAL evalNumNode(CILISP_CONTEXT *ctx, NUM_AST_NODE *numNode)
 {
     if (!numNode)
         return (RET_VAL){DOUBLE_TYPE, NAN};
@@ -402,7 +800,7 @@ RET_VAL evalNumNode(NUM_AST_NODE *numNode)
             result.value.dval = numNode->value.dval;
             break;
         default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
+            ciLispError(ctx, "Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
     }
 
 
@@ -410,1274 +808,674 @@ RET_VAL evalNumNode(NUM_AST_NODE *numNode)
 }
 
 
-RET_VAL evalFuncNode(AST_NODE *node)
-{
-    if (!node)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
+/*
+       Builtin operators
+       The operators of ciLispOperators.def share one evaluator per arity, specialized for each operator
+       with its kernels. They give the same results, errors and INT/DOUBLE rules the per operator helpers did.
+     */
 
-    FUNC_AST_NODE *funcNode = &(node->data.function);
+static bool isTrue(RET_VAL val)
+{
+    return (val.type == INT_TYPE) ? val.value.ival != 0 : val.value.dval != 0;
+}
 
-    RET_VAL result = {DOUBLE_TYPE, NAN};
+// what an operator gives when it has no operands to work on
+static RET_VAL operMissing(OPER_TYPE oper)
+{
+    if (operSpecs[oper].result == PREDICATE_RESULT)
+        return (RET_VAL){INT_TYPE, 0};
 
-    // populate result with the result of running the function on its operands.
-    // SEE: AST_NODE, AST_NODE_TYPE, FUNC_AST_NODE
+    return (RET_VAL){DOUBLE_TYPE, NAN};
+}
 
+static void operArityError(CILISP_CONTEXT *ctx, OPER_TYPE oper, bool tooMany)
+{
+    char message[ERROR_BUFFER];
 
-    switch (funcNode->oper)
-    {
-        case NEG_OPER:
-            result = helperNegOper(funcNode->opList);
-            break;
-        case ABS_OPER:
-            result = helperAbsOper(funcNode->opList);
-            break;
-        case EXP_OPER:
-            result = helperExpOper(funcNode->opList);
-            break;
-        case SQRT_OPER:
-            result = helperSqrtOper(funcNode->opList);
-            break;
-        case ADD_OPER:
-            result = helperAddOper(funcNode->opList);
-            break;
-        case SUB_OPER:
-            result = helperSubOper(funcNode->opList);
-            break;
-        case MULT_OPER:
-            result = helperMultOper(funcNode->opList);
-            break;
-        case DIV_OPER:
-            result = helperDivOper(funcNode->opList);
-            break;
-        case REMAINDER_OPER:
-            result = helperRemainderOper(funcNode->opList);
-            break;
-        case LOG_OPER:
-            result = helperLogOper(funcNode->opList);
-            break;
-        case POW_OPER:
-            result = helperPowOper(funcNode->opList);
-            break;
-        case MAX_OPER:
-            result = helperMaxOper(funcNode->opList);
-            break;
-        case MIN_OPER:
-            result = helperMinOper(funcNode->opList);
-            break;
-        case EXP2_OPER:
-            result = helperExp2Oper(funcNode->opList);
-            break;
-        case CBRT_OPER:
-            result = helperCbrtOper(funcNode->opList);
-            break;
-        case HYPOT_OPER:
-            result = helperHypotOper(funcNode->opList);
-            break;
-        case PRINT_OPER:
-            result = helperPrintOper(funcNode->opList);
-            break;
-        case READ_OPER:
-            result = helperReadOper(node);
-            break;
-        case RAND_OPER:
-            result = helperRandOper(node);
-            break;
-        case EQUAL_OPER:
-            result = helperEqualOper(funcNode->opList);
-            break;
-        case LESS_OPER:
-            result = helperLessOper(funcNode->opList);
-            break;
-        case GREATER_OPER:
-            result = helperGreaterOper(funcNode->opList);
-            break;
-        case CUSTOM_OPER:
-            result = helperCustomOper(node);
-            break;
-        default:
-            printf("How did we get here?");
-            break;
-    }
+    if (tooMany)
+        snprintf(message, ERROR_BUFFER, "Too many parameters for the function \"%s\".\n\t\tExtra parameters will be ignored\n",
+                 funcNames[oper]);
+    else
+        snprintf(message, ERROR_BUFFER, "Too few parameters for the function \"%s\".\n", funcNames[oper]);
 
-    return result;
+    ciLispError(ctx, message);
 }
 
-RET_VAL evalSymbolNode(AST_NODE *symbolNode)
+// a (oper) b with the type rules of the operator's result
+static inline RET_VAL operApply(CILISP_CONTEXT *ctx, OPER_TYPE oper, RET_VAL a, RET_VAL b,
+                                long (*intKernel)(long, long), double (*doubleKernel)(double, double))
 {
-
-    if (!symbolNode)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-
     RET_VAL result = {DOUBLE_TYPE, NAN};
 
-    char *symbol = symbolNode->data.symbol.ident;
-    AST_NODE *currNode = symbolNode;
-    SYMBOL_TABLE_NODE *currSymbol;
-    ARG_TABLE_NODE *currArg;
-
-
-    while (currNode != NULL)
+    if ((a.type != INT_TYPE && a.type != DOUBLE_TYPE) || (b.type != INT_TYPE && b.type != DOUBLE_TYPE))
     {
-        currSymbol = currNode->symbolTable;
-        while (currSymbol != NULL)
-        {
-            if (!strcmp(symbol, currSymbol->ident) && (currSymbol->sym_type == VARIABLE_TYPE))
-            {
-                result = evalSymbolNodeHelper(currSymbol);
-
-                return result;
-            }
-            currSymbol = currSymbol->next;
-        } // END of Symbol Table Search
+        ciLispError(ctx, "Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
+        return result;
+    }
 
-        // Since args are now distinct from symbols, this checks the argTable after checking the symbol table
-        currArg = currNode->argTable;
-        while (currArg != NULL)
+    if (a.type == INT_TYPE && b.type == INT_TYPE && operSpecs[oper].result != DOUBLE_RESULT)
+    {
+        // an int division by zero traps, the double kernels would give inf or nan (the kernels take care of
+        // LONG_MIN / -1, the other int division that traps); 0 to a negative power is 1 / 0 as well
+        if (((oper == DIV_OPER || oper == REMAINDER_OPER) && b.value.ival == 0) ||
+            (oper == POW_OPER && a.value.ival == 0 && b.value.ival < 0))
         {
-            if (!strcmp(symbol, currArg->ident))
-            {
-                result = currArg->argVal;
-
-                return result;
-            }
+            char message[ERROR_BUFFER];
+            snprintf(message, ERROR_BUFFER, "Division by zero in the function \"%s\".\n", funcNames[oper]);
+            ciLispError(ctx, message);
+            return result;
+        }
 
-            currArg = currArg->next;
-        } // END of Arg Table Search
+        result.type = INT_TYPE;
+        result.value.ival = intKernel(a.value.ival, b.value.ival);
+        return result;
+    }
 
+    double x = (a.type == INT_TYPE) ? (double) a.value.ival : a.value.dval;
+    double y = (b.type == INT_TYPE) ? (double) b.value.ival : b.value.dval;
 
-        currNode = currNode->parent;
-    } // END of Search
+    if (operSpecs[oper].result == PREDICATE_RESULT)
+    {
+        result.type = INT_TYPE;
+        result.value.ival = (long) doubleKernel(x, y);
+    }
+    else
+        result.value.dval = doubleKernel(x, y);
 
     return result;
 }
 
-
-RET_VAL evalSymbolNodeHelper(SYMBOL_TABLE_NODE *symbol)
+static inline RET_VAL evalUnaryOper(CILISP_CONTEXT *ctx, OPER_TYPE oper, AST_NODE *op1,
+                                    long (*intKernel)(long, long), double (*doubleKernel)(double, double))
 {
+    if (!op1)
+        return operMissing(oper);
 
-    if (!symbol)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-
-    RET_VAL result = eval(symbol->val);
-
-    // This whole block changes the returned result depending on the casted type of this symbol AST Node
-    switch (symbol->val_type)
-    {
-        case NO_TYPE:
-            return result;
-        case INT_TYPE:
-            switch (result.type)
-            {
-                case INT_TYPE:
-                    break;
-                case DOUBLE_TYPE:
-                    printf("WARNING: precision loss in the assignment for variable \"%s\"\n", symbol->ident);
-                    result.type = INT_TYPE;
-                    result.value.ival = lround(result.value.dval);
-                    break;
-                default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            }
-            break;
-
-        case DOUBLE_TYPE:
-            switch (result.type)
-            {
-                case INT_TYPE:
-                    result.type = DOUBLE_TYPE;
-                    result.value.dval = (double) result.value.ival;
-                    break;
-                case DOUBLE_TYPE:
-                    break;
-                default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            }
-            break;
+    // the kernels of unary operators ignore b
+    RET_VAL val = eval(ctx, op1);
+    RET_VAL result = operApply(ctx, oper, val, val, intKernel, doubleKernel);
 
-        default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-    } // END of type cast adjustments
+    if (op1->next != NULL)
+        operArityError(ctx, oper, true);
 
     return result;
 }
 
-
-RET_VAL evalCondNode(COND_AST_NODE *condAstNode)
+static inline RET_VAL evalBinaryOper(CILISP_CONTEXT *ctx, OPER_TYPE oper, AST_NODE *op1,
+                                     long (*intKernel)(long, long), double (*doubleKernel)(double, double))
 {
-
-    if (!condAstNode)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-
-    RET_VAL result = eval(condAstNode->condNode);
-
-    switch (result.type)
+    if (!op1)
+        return operMissing(oper);
+    else if (!op1->next)
     {
-        case INT_TYPE:
-            if (result.value.ival)
-                result = eval(condAstNode->trueNode);
-            else
-                result = eval(condAstNode->falseNode);
-            break;
-        case DOUBLE_TYPE:
-            if (result.value.dval)
-                result = eval(condAstNode->trueNode);
-            else
-                result = eval(condAstNode->falseNode);
-            break;
-        default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            break;
+        operArityError(ctx, oper, false);
+        return operMissing(oper);
     }
 
-    return result;
-
-}
-
-// prints the type and value of a RET_VAL
-void printRetVal(RET_VAL val)
-{
-    // print the type and value of the value passed in.
-
+    RET_VAL a = eval(ctx, op1);
+    RET_VAL b = eval(ctx, op1->next);
+    RET_VAL result = operApply(ctx, oper, a, b, intKernel, doubleKernel);
 
-    switch (val.type)
-    {
-        case INT_TYPE:
-            printf("Int Type: %ld\n", val.value.ival);
-            break;
-        case DOUBLE_TYPE:
-            printf("Double Type: %lf\n", val.value.dval);
-            break;
-        default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-    }
+    if (op1->next->next != NULL)
+        operArityError(ctx, oper, true);
 
+    return result;
 }
 
-/*
-       evalFuncNode Helper methods
-     */
-
-RET_VAL helperNegOper(AST_NODE *op1)
+static inline RET_VAL evalFoldOper(CILISP_CONTEXT *ctx, OPER_TYPE oper, AST_NODE *op1,
+                                   long (*intKernel)(long, long), double (*doubleKernel)(double, double))
 {
-
     if (!op1)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-
-    RET_VAL result = eval(op1);
-
-
-
-    switch (result.type)
+        return operMissing(oper);
+    else if (!op1->next)
     {
-        case INT_TYPE:
-            result.value.ival = -result.value.ival;
-            break;
-        case DOUBLE_TYPE:
-            result.value.dval = -result.value.dval;
-            break;
-        default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
+        operArityError(ctx, oper, false);
+        return operMissing(oper);
     }
 
-    if (op1->next != NULL)
-    {
-        yyerror("Too many parameters for the function \"neg\".\n\t\tExtra parameters will be ignored\n");
-    }
+    RET_VAL result = eval(ctx, op1);
+
+    for (AST_NODE *currOp = op1->next; currOp != NULL; currOp = currOp->next)
+        result = operApply(ctx, oper, result, eval(ctx, currOp), intKernel, doubleKernel);
 
     return result;
 }
 
-
-RET_VAL helperAbsOper(AST_NODE *op1)
+// (oper a b c...) is (and (oper a b) (oper b c)...): operands after the first failed pair are not evaluated
+static inline RET_VAL evalChainOper(CILISP_CONTEXT *ctx, OPER_TYPE oper, AST_NODE *op1,
+                                    long (*intKernel)(long, long), double (*doubleKernel)(double, double))
 {
-
     if (!op1)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-
-    RET_VAL result = eval(op1);
-
-    switch (result.type)
+        return operMissing(oper);
+    else if (!op1->next)
     {
-        case INT_TYPE:
-            result.value.ival = labs(result.value.ival);
-            break;
-        case DOUBLE_TYPE:
-            result.value.dval = fabs(result.value.dval);
-            break;
-        default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
+        operArityError(ctx, oper, false);
+        return operMissing(oper);
     }
 
+    RET_VAL a = eval(ctx, op1);
+    RET_VAL result = operMissing(oper);
 
-    if (op1->next != NULL)
+    for (AST_NODE *currOp = op1->next; currOp != NULL; currOp = currOp->next)
     {
-        yyerror("Too many parameters for the function \"abs\".\n\t\tExtra parameters will be ignored\n");
+        RET_VAL b = eval(ctx, currOp);
+        result = operApply(ctx, oper, a, b, intKernel, doubleKernel);
+        if (result.type != INT_TYPE || result.value.ival == 0)
+            break;
+        a = b;
     }
 
     return result;
 }
 
-
-RET_VAL helperExpOper(AST_NODE *op1)
+// and/or: the operands are evaluated left to right only while they can still change the result
+static inline RET_VAL evalLazyOper(CILISP_CONTEXT *ctx, OPER_TYPE oper, AST_NODE *op1,
+                                   long (*intKernel)(long, long), double (*doubleKernel)(double, double))
 {
+    (void) doubleKernel;
 
     if (!op1)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
+        return operMissing(oper);
 
-    RET_VAL result = eval(op1);
+    RET_VAL result = {INT_TYPE};
+    result.value.ival = isTrue(eval(ctx, op1));
 
-    switch (result.type)
+    for (AST_NODE *currOp = op1->next; currOp != NULL; currOp = currOp->next)
     {
-        case INT_TYPE:
-            result.type = DOUBLE_TYPE;
-            result.value.dval = exp( (double) result.value.ival);
-            break;
-        case DOUBLE_TYPE:
-            result.value.dval = exp(result.value.dval);
+        if (intKernel(result.value.ival, 0) == intKernel(result.value.ival, 1))
             break;
-        default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-    }
-
-    if (op1->next != NULL)
-    {
-        yyerror("Too many parameters for the function \"exp\".\n\t\tExtra parameters will be ignored\n");
+        result.value.ival = intKernel(result.value.ival, isTrue(eval(ctx, currOp)));
     }
 
     return result;
 }
 
-
-RET_VAL helperSqrtOper(AST_NODE *op1)
+// operators with side effects or state keep their own helpers
+static RET_VAL evalSpecialOper(CILISP_CONTEXT *ctx, AST_NODE *node)
 {
-
-    if (!op1)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-
-    RET_VAL result = eval(op1);
-
-    switch (result.type)
+    switch (node->data.function.oper)
     {
-        case INT_TYPE:
-            result.type = DOUBLE_TYPE;
-            result.value.dval = sqrt( (double) result.value.ival);
-            break;
-        case DOUBLE_TYPE:
-            result.value.dval = sqrt(result.value.dval);
-            break;
+        case READ_OPER:
+            return helperReadOper(ctx, node);
+        case RAND_OPER:
+            return helperRandOper(ctx, node);
+        case PRINT_OPER:
+            return helperPrintOper(ctx, node->data.function.opList);
         default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
+            outputPrintf(ctx, "How did we get here?");
+            return (RET_VAL){DOUBLE_TYPE, NAN};
     }
-
-    if (op1->next != NULL)
-    {
-        yyerror("Too many parameters for the function \"sqrt\".\n\t\tExtra parameters will be ignored\n");
-    }
-
-    return result;
 }
 
+#define UNARY_ARITY_EVAL(id) evalUnaryOper(ctx, id##_OPER, funcNode->opList, id##IntKernel, id##DoubleKernel)
+#define BINARY_ARITY_EVAL(id) evalBinaryOper(ctx, id##_OPER, funcNode->opList, id##IntKernel, id##DoubleKernel)
+#define FOLD_ARITY_EVAL(id) evalFoldOper(ctx, id##_OPER, funcNode->opList, id##IntKernel, id##DoubleKernel)
+#define CHAIN_ARITY_EVAL(id) evalChainOper(ctx, id##_OPER, funcNode->opList, id##IntKernel, id##DoubleKernel)
+#define LAZY_ARITY_EVAL(id) evalLazyOper(ctx, id##_OPER, funcNode->opList, id##IntKernel, id##DoubleKernel)
+#define SPECIAL_ARITY_EVAL(id) evalSpecialOper(ctx, node)
 
-RET_VAL helperAddOper(AST_NODE *op1)
-{
-
-    if (!op1)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-    else if (!op1->next)
-    {
-        yyerror("Too few parameters for the function \"add\".\n");
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-    }
 
-    RET_VAL result = eval(op1);
-    AST_NODE *currOp = op1->next;
-    RET_VAL op2; // the follow up Operator value
+static RET_VAL evalOperator(CILISP_CONTEXT *ctx, AST_NODE *node)
+{
+    FUNC_AST_NODE *funcNode = &(node->data.function);
 
-    while (currOp != NULL)
-    {
-        op2 = eval(currOp);
+    RET_VAL result = {DOUBLE_TYPE, NAN};
 
-        switch (result.type) {
-            case INT_TYPE:
-                switch (op2.type) {
-                    case INT_TYPE:
-                        result.value.ival += op2.value.ival;
-                        break;
-                    case DOUBLE_TYPE:
-                        result.type = DOUBLE_TYPE;
-                        result.value.dval = (double)result.value.ival + op2.value.dval;
-                        break;
-                    default:
-                        yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-                }
-                break;
-            case DOUBLE_TYPE:
-                switch (op2.type) {
-                    case INT_TYPE:
-                        result.value.dval += (double) op2.value.ival;
-                        break;
-                    case DOUBLE_TYPE:
-                        result.value.dval += op2.value.dval;
-                        break;
-                    default:
-                        yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-                }
-                break;
-            default:
-                yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-        } // END of switch
+    // populate result with the result of running the function on its operands.
+    // SEE: AST_NODE, AST_NODE_TYPE, FUNC_AST_NODE
 
-        currOp = currOp->next;
 
-    } // END of while
+    switch (funcNode->oper)
+    {
+#define OPER(id, name, arity, ...) \
+        case id##_OPER: \
+            result = arity##_EVAL(id); \
+            break;
+#include "ciLispOperators.def"
+#undef OPER
+        case CUSTOM_OPER:
+            result = helperCustomOper(ctx, node);
+            break;
+        default:
+            outputPrintf(ctx, "How did we get here?");
+            break;
+    }
 
     return result;
 }
 
-
-RET_VAL helperSubOper(AST_NODE *op1)
+RET_VAL evalFuncNode(CILISP_CONTEXT *ctx, AST_NODE *node)
 {
-
-    if (!op1)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-    else if (!op1->next)
-    {
-        yyerror("Too few parameters for the function \"sub\".\n");
+    if (!node)
         return (RET_VAL){DOUBLE_TYPE, NAN};
-    }
 
-    RET_VAL result = eval(op1);
-    AST_NODE *currOp = op1->next;
-    RET_VAL op2; // the follow up Operator value
+    AST_NODE *common = node->data.function.common;
+    if (common == NULL)
+        return evalOperator(ctx, node);
 
-    while (currOp != NULL)
+    // every copy of a common subexpression takes the value its common node computed in this evaluation
+    FUNC_AST_NODE *commonNode = &common->data.function;
+    if (commonNode->memoGeneration != ctx->generation)
     {
-
-        op2 = eval(currOp);
-
-        switch (result.type) {
-            case INT_TYPE:
-                switch (op2.type) {
-                    case INT_TYPE:
-                        result.value.ival -= op2.value.ival;
-                        break;
-                    case DOUBLE_TYPE:
-                        result.type = DOUBLE_TYPE;
-                        result.value.dval = (double) result.value.ival - op2.value.dval;
-                        break;
-                    default:
-                        yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-                }
-                break;
-            case DOUBLE_TYPE:
-                switch (op2.type) {
-                    case INT_TYPE:
-                        result.value.dval -= (double) op2.value.ival;
-                        break;
-                    case DOUBLE_TYPE:
-                        result.value.dval -= op2.value.dval;
-                        break;
-                    default:
-                        yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-                }
-                break;
-            default:
-                yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-        }
-
-        currOp = currOp->next;
-
+        commonNode->memo = evalOperator(ctx, common);
+        commonNode->memoGeneration = ctx->generation;
     }
 
-    return result;
+    return commonNode->memo;
 }
 
-
-RET_VAL helperMultOper(AST_NODE *op1)
+RET_VAL evalSymbolNode(CILISP_CONTEXT *ctx, AST_NODE *symbolNode)
 {
 
-    if (!op1)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-    else if (!op1->next)
-    {
-        yyerror("Too few parameters for the function \"mult\".\n");
+    if (!symbolNode)
         return (RET_VAL){DOUBLE_TYPE, NAN};
-    }
-
-    RET_VAL result = eval(op1);
-    AST_NODE *currOp = op1->next;
-    RET_VAL op2; // the follow up Operator value
-
-
-    while (currOp != NULL)
-    {
-
-        op2 = eval(currOp);
 
-        switch (result.type) {
-            case INT_TYPE:
-                switch (op2.type) {
-                    case INT_TYPE:
-                        result.value.ival *= op2.value.ival;
-                        break;
-                    case DOUBLE_TYPE:
-                        result.type = DOUBLE_TYPE;
-                        result.value.dval = (double) result.value.ival * op2.value.dval;
-                        break;
-                    default:
-                        yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-                }
-                break;
-            case DOUBLE_TYPE:
-                switch (op2.type) {
-                    case INT_TYPE:
-                        result.value.dval *= (double) op2.value.ival;
-                        break;
-                    case DOUBLE_TYPE:
-                        result.value.dval *= op2.value.dval;
-                        break;
-                    default:
-                        yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-                }
-                break;
-            default:
-                yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-        }
-
-        currOp = currOp->next;
-
-    }
-
-    return result;
-}
+    RET_VAL result = {DOUBLE_TYPE, NAN};
 
+    char *symbol = symbolNode->data.symbol.ident;
+    AST_NODE *currNode = symbolNode;
+    SYMBOL_TABLE_NODE *currSymbol;
+    ARG_TABLE_NODE *currArg;
 
-RET_VAL helperDivOper(AST_NODE *op1)
-{
 
-    if (!op1)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-    else if (!op1->next)
+    while (currNode != NULL)
     {
-        yyerror("Too few parameters for the function \"div\".\n");
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-    }
+        currSymbol = findInScope(currNode, symbol, VARIABLE_TYPE);
+        if (currSymbol != NULL)
+        {
+            result = evalSymbolNodeHelper(ctx, currSymbol);
 
-    RET_VAL result = eval(op1);
-    AST_NODE *currOp = op1->next;
-    RET_VAL op2; // the follow up Operator value
+            return result;
+        } // END of Symbol Table Search
 
+        // Since args are now distinct from symbols, this checks the argTable after checking the symbol table
+        currArg = currNode->argTable;
+        while (currArg != NULL)
+        {
+            if (!strcmp(symbol, currArg->ident))
+            {
+                result = currArg->argVal;
 
-    while (currOp != NULL)
-    {
+                return result;
+            }
 
-        op2 = eval(currOp);
+            currArg = currArg->next;
+        } // END of Arg Table Search
 
-        switch (result.type) {
-            case INT_TYPE:
-                switch (op2.type) {
-                    case INT_TYPE:
-                        result.value.ival /= op2.value.ival;
-                        break;
-                    case DOUBLE_TYPE:
-                        result.type = DOUBLE_TYPE;
-                        result.value.dval = (double) result.value.ival / op2.value.dval;
-                        break;
-                    default:
-                        yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-                }
-                break;
-            case DOUBLE_TYPE:
-                switch (op2.type) {
-                    case INT_TYPE:
-                        result.value.dval /= (double) op2.value.ival;
-                        break;
-                    case DOUBLE_TYPE:
-                        result.value.dval /= op2.value.dval;
-                        break;
-                    default:
-                        yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-                }
-                break;
-            default:
-                yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-        }
 
-        currOp = currOp->next;
+        currNode = currNode->parent;
+    } // END of Search
 
+    // Not defined anywhere in the tree: fall back to the values bound to the context
+    for (INPUT_BINDING *currInput = ctx->inputs; currInput != NULL; currInput = currInput->next)
+    {
+        if (!strcmp(symbol, currInput->ident))
+            return currInput->val;
     }
 
     return result;
 }
 
 
-RET_VAL helperRemainderOper(AST_NODE *op1)
+// The value of a let variable converted to the type it was declared with
+static RET_VAL castToSymbolType(CILISP_CONTEXT *ctx, SYMBOL_TABLE_NODE *symbol, RET_VAL result)
 {
-
-    if (!op1)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-    else if (!op1->next)
-    {
-        yyerror("Too few parameters for the function \"remainder\".\n");
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-    }
-
-
-    RET_VAL result = eval(op1);
-    RET_VAL op2 = eval(op1->next);
-
-    switch (result.type)
+    // This whole block changes the returned result depending on the casted type of this symbol AST Node
+    switch (symbol->val_type)
     {
+        case NO_TYPE:
+            return result;
         case INT_TYPE:
-            switch (op2.type)
+            switch (result.type)
             {
                 case INT_TYPE:
-                    result.value.ival = result.value.ival % op2.value.ival;
                     break;
                 case DOUBLE_TYPE:
-                    result.type = DOUBLE_TYPE;
-                    result.value.dval = fmod((double) result.value.ival, op2.value.dval);
+                    outputPrintf(ctx, "WARNING: precision loss in the assignment for variable \"%s\"\n", symbol->ident);
+                    result.type = INT_TYPE;
+                    result.value.ival = lround(result.value.dval);
                     break;
                 default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
+                    ciLispError(ctx, "Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
             }
             break;
+
         case DOUBLE_TYPE:
-            switch (op2.type)
+            switch (result.type)
             {
                 case INT_TYPE:
-                    result.value.dval = fmod(result.value.dval, (double) op2.value.ival);
+                    result.type = DOUBLE_TYPE;
+                    result.value.dval = (double) result.value.ival;
                     break;
                 case DOUBLE_TYPE:
-                    result.value.dval = fmod(result.value.dval, op2.value.dval);
                     break;
                 default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
+                    ciLispError(ctx, "Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
             }
             break;
-        default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-    }
 
-    if (op1->next->next != NULL)
-    {
-        yyerror("Too many parameters for the function \"remainder\".\n\t\tExtra parameters will be ignored\n");
-    }
+        default:
+            ciLispError(ctx, "Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
+    } // END of type cast adjustments
 
     return result;
 }
 
-
-RET_VAL helperLogOper(AST_NODE *op1)
+RET_VAL evalSymbolNodeHelper(CILISP_CONTEXT *ctx, SYMBOL_TABLE_NODE *symbol)
 {
 
-    if (!op1)
+    if (!symbol)
         return (RET_VAL){DOUBLE_TYPE, NAN};
 
+    // a value given by set during this evaluation replaces the definition (it was cast when it was set)
+    if (symbol->assignedGeneration == ctx->generation)
+        return symbol->assigned;
 
-    RET_VAL result = eval(op1);
-
-    switch (result.type)
-    {
-        case INT_TYPE:
-            result.type = DOUBLE_TYPE;
-            result.value.dval = log( (double) result.value.ival);
-            break;
-        case DOUBLE_TYPE:
-            result.value.dval = log(result.value.dval);
-            break;
-        default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-    }
-
-    if (op1->next != NULL)
-    {
-        yyerror("Too many parameters for the function \"log\".\n\t\tExtra parameters will be ignored\n");
-    }
-
-    return result;
+    return castToSymbolType(ctx, symbol, eval(ctx, symbol->val));
 }
 
 
-RET_VAL helperPowOper(AST_NODE *op1)
+RET_VAL evalCondNode(CILISP_CONTEXT *ctx, COND_AST_NODE *condAstNode)
 {
 
-    if (!op1)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-    else if (!op1->next)
-    {
-        yyerror("Too few parameters for the function \"pow\".\n");
+    if (!condAstNode)
         return (RET_VAL){DOUBLE_TYPE, NAN};
-    }
 
-    RET_VAL result = eval(op1);
-    RET_VAL op2 = eval(op1->next);
+    RET_VAL result = eval(ctx, condAstNode->condNode);
 
     switch (result.type)
     {
         case INT_TYPE:
-            switch (op2.type)
-            {
-                case INT_TYPE:
-                    result.value.ival = lround(pow( (double) result.value.ival, (double) op2.value.ival));
-                    break;
-                case DOUBLE_TYPE:
-                    result.type = DOUBLE_TYPE;
-                    result.value.dval = pow((double) result.value.ival, op2.value.dval);
-                    break;
-                default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            }
+            if (result.value.ival)
+                result = eval(ctx, condAstNode->trueNode);
+            else
+                result = eval(ctx, condAstNode->falseNode);
             break;
         case DOUBLE_TYPE:
-            switch (op2.type)
-            {
-                case INT_TYPE:
-                    result.value.dval = pow(result.value.dval, (double) op2.value.ival);
-                    break;
-                case DOUBLE_TYPE:
-                    result.value.dval = pow( result.value.dval, op2.value.dval );
-                    break;
-                default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            }
+            if (result.value.dval)
+                result = eval(ctx, condAstNode->trueNode);
+            else
+                result = eval(ctx, condAstNode->falseNode);
             break;
         default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-    }
-
-    if (op1->next->next != NULL)
-    {
-        yyerror("Too many parameters for the function \"pow\".\n\t\tExtra parameters will be ignored\n");
+            ciLispError(ctx, "Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
+            break;
     }
 
     return result;
-}
 
+}
 
-RET_VAL helperMaxOper(AST_NODE *op1)
+// evaluates a body list in order and returns the value of the last s-expression
+static RET_VAL evalBody(CILISP_CONTEXT *ctx, AST_NODE *body)
 {
+    RET_VAL result = {DOUBLE_TYPE, NAN};
 
-    if (!op1)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-    else if (!op1->next)
-    {
-        yyerror("Too few parameters for the function \"max\".\n");
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-    }
-
-    RET_VAL result = eval(op1);
-    RET_VAL op2 = eval(op1->next);
-
-    switch (result.type)
-    {
-        case INT_TYPE:
-            switch (op2.type)
-            {
-                case INT_TYPE:
-                    result.value.ival = lround( fmax( (double) result.value.ival, (double) op2.value.ival));
-                    break;
-                case DOUBLE_TYPE:
-                    result.type = DOUBLE_TYPE;
-                    result.value.dval = fmax((double) result.value.ival, op2.value.dval);
-                    break;
-                default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            }
-            break;
-        case DOUBLE_TYPE:
-            switch (op2.type)
-            {
-                case INT_TYPE:
-                    result.value.dval = fmax(result.value.dval, (double) op2.value.ival);
-                    break;
-                case DOUBLE_TYPE:
-                    result.value.dval = fmax( result.value.dval, op2.value.dval );
-                    break;
-                default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            }
-            break;
-        default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-    }
-
-    if (op1->next->next != NULL)
-    {
-        yyerror("Too many parameters for the function \"max\".\n\t\tExtra parameters will be ignored\n");
-    }
+    for (AST_NODE *currNode = body; currNode != NULL; currNode = currNode->next)
+        result = eval(ctx, currNode);
 
     return result;
 }
 
-
-RET_VAL helperMinOper(AST_NODE *op1)
+RET_VAL evalSequenceNode(CILISP_CONTEXT *ctx, SEQUENCE_AST_NODE *sequenceNode)
 {
-
-    if (!op1)
+    if (!sequenceNode)
         return (RET_VAL){DOUBLE_TYPE, NAN};
-    else if (!op1->next)
-    {
-        yyerror("Too few parameters for the function \"min\".\n");
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-    }
-
-    RET_VAL result = eval(op1);
-    RET_VAL op2 = eval(op1->next);
 
-    switch (op1->type)
-    {
-        case INT_TYPE:
-            switch (op2.type)
-            {
-                case INT_TYPE:
-                    result.value.ival = lround( fmin( (double) result.value.ival, (double) op2.value.ival));
-                    break;
-                case DOUBLE_TYPE:
-                    result.type = DOUBLE_TYPE;
-                    result.value.dval = fmin((double) result.value.ival, op2.value.dval);
-                    break;
-                default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            }
-            break;
-        case DOUBLE_TYPE:
-            switch (op2.type)
-            {
-                case INT_TYPE:
-                    result.value.dval = fmin(result.value.dval, (double) op2.value.ival);
-                    break;
-                case DOUBLE_TYPE:
-                    result.value.dval = fmin( result.value.dval, op2.value.dval );
-                    break;
-                default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            }
-            break;
-        default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-    }
+    return evalBody(ctx, sequenceNode->body);
+}
 
-    if (op1->next->next != NULL)
-    {
-        yyerror("Too many parameters for the function \"min\".\n\t\tExtra parameters will be ignored\n");
-    }
+RET_VAL evalWhileNode(CILISP_CONTEXT *ctx, LOOP_AST_NODE *loopNode)
+{
+    RET_VAL result = {DOUBLE_TYPE, NAN};
+
+    if (!loopNode)
+        return result;
+
+    // an error in the condition or the body ends the loop
+    int errors = ctx->errorCount;
+    while (isTrue(eval(ctx, loopNode->condNode)) && ctx->errorCount == errors)
+        result = evalBody(ctx, loopNode->body);
 
     return result;
 }
 
-
-RET_VAL helperExp2Oper(AST_NODE *op1)
+RET_VAL evalForNode(CILISP_CONTEXT *ctx, AST_NODE *node)
 {
+    RET_VAL result = {DOUBLE_TYPE, NAN};
+    LOOP_AST_NODE *loopNode = &node->data.loop;
+    ARG_TABLE_NODE *counter = node->argTable;
 
-    if (!op1)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-
-    RET_VAL result = eval(op1);
+    // the bounds are evaluated once, before the first iteration
+    RET_VAL start = (loopNode->startNode != NULL) ? eval(ctx, loopNode->startNode) : (RET_VAL){INT_TYPE, 0};
+    RET_VAL end = eval(ctx, loopNode->endNode);
+    int errors = ctx->errorCount;
 
-    switch (result.type)
+    // the counter is an int when both bounds are, and counts up by one
+    if (start.type == INT_TYPE && end.type == INT_TYPE)
     {
-        case INT_TYPE:
-            result.type = DOUBLE_TYPE;
-            result.value.dval = exp2( (double) result.value.ival);
-            break;
-        case DOUBLE_TYPE:
-            result.value.dval = exp2(result.value.dval);
-            break;
-        default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
+        counter->argVal.type = INT_TYPE;
+        for (long i = start.value.ival; i < end.value.ival && ctx->errorCount == errors; i++)
+        {
+            counter->argVal.value.ival = i;
+            result = evalBody(ctx, loopNode->body);
+        }
     }
-
-    if (op1->next != NULL)
+    else
     {
-        yyerror("Too many parameters for the function \"exp2\".\n\t\tExtra parameters will be ignored\n");
+        double first = (start.type == INT_TYPE) ? (double) start.value.ival : start.value.dval;
+        double last = (end.type == INT_TYPE) ? (double) end.value.ival : end.value.dval;
+
+        counter->argVal.type = DOUBLE_TYPE;
+        for (double d = first; d < last && ctx->errorCount == errors; d += 1)
+        {
+            counter->argVal.value.dval = d;
+            result = evalBody(ctx, loopNode->body);
+        }
     }
 
     return result;
 }
 
-
-RET_VAL helperCbrtOper(AST_NODE *op1)
+RET_VAL evalSetNode(CILISP_CONTEXT *ctx, AST_NODE *node)
 {
+    char *ident = node->data.assignment.ident;
+    RET_VAL result = eval(ctx, node->data.assignment.valueNode);
 
-    if (!op1)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-
-    RET_VAL result = eval(op1);
-
-    switch (op1->type)
+    // same search as evalSymbolNode: let variables, then arguments, from the closest scope out
+    for (AST_NODE *currNode = node; currNode != NULL; currNode = currNode->parent)
     {
-        case INT_TYPE:
-            result.type = DOUBLE_TYPE;
-            result.value.dval = cbrt( (double) result.value.ival);
-            break;
-        case DOUBLE_TYPE:
-            result.value.dval = cbrt(result.value.dval);
-            break;
-        default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-    }
+        SYMBOL_TABLE_NODE *symbol = findInScope(currNode, ident, VARIABLE_TYPE);
+        if (symbol != NULL)
+        {
+            symbol->assigned = castToSymbolType(ctx, symbol, result);
+            symbol->assignedGeneration = ctx->generation;
+            return symbol->assigned;
+        }
 
-    if (op1->next != NULL)
-    {
-        yyerror("Too many parameters for the function \"cbrt\".\n\t\tExtra parameters will be ignored\n");
+        for (ARG_TABLE_NODE *currArg = currNode->argTable; currArg != NULL; currArg = currArg->next)
+        {
+            if (!strcmp(ident, currArg->ident))
+            {
+                currArg->argVal = result;
+                return result;
+            }
+        }
     }
 
+    char message[ERROR_BUFFER];
+    snprintf(message, ERROR_BUFFER, "set: \"%s\" is not a let variable or an argument", ident);
+    ciLispError(ctx, message);
     return result;
 }
 
-
-RET_VAL helperHypotOper(AST_NODE *op1)
+// prints the type and value of a RET_VAL
+void printRetVal(CILISP_CONTEXT *ctx, RET_VAL val)
 {
+    // print the type and value of the value passed in.
 
-    if (!op1)
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-    else if (!op1->next)
-    {
-        yyerror("Too few parameters for the function \"hypot\".\n");
-        return (RET_VAL){DOUBLE_TYPE, NAN};
-    }
-
-    RET_VAL result = eval(op1);
-    RET_VAL op2 = eval(op1->next);
 
-    switch (result.type)
+    switch (val.type)
     {
         case INT_TYPE:
-            switch (op2.type)
-            {
-                case INT_TYPE:
-                    result.type = DOUBLE_TYPE;
-                    result.value.dval = hypot( (double) result.value.ival, (double) op2.value.ival);
-                    break;
-                case DOUBLE_TYPE:
-                    result.type = DOUBLE_TYPE;
-                    result.value.dval = hypot( (double) result.value.ival, op2.value.dval);
-                    break;
-                default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            }
+            outputWrite(ctx, "Int Type: ", 10);
+            if (ctx->out != NULL)
+                bufferLong(&ctx->output, val.value.ival);
+            outputWrite(ctx, "\n", 1);
             break;
         case DOUBLE_TYPE:
-            switch (op2.type)
-            {
-                case INT_TYPE:
-                    result.value.dval = hypot( result.value.dval, (double) op2.value.ival);
-                    break;
-                case DOUBLE_TYPE:
-                    result.value.dval = hypot( result.value.dval, op2.value.dval );
-                    break;
-                default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            }
+            outputPrintf(ctx, "Double Type: %lf\n", val.value.dval);
             break;
         default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-    }
-
-    if (op1->next->next != NULL)
-    {
-        yyerror("Too many parameters for the function \"hypot\".\n\t\tExtra parameters will be ignored\n");
+            ciLispError(ctx, "Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
     }
 
-    return result;
 }
 
-RET_VAL helperPrintOper(AST_NODE *op1)
+/*
+       evalFuncNode Helper methods
+     */
+
+RET_VAL helperPrintOper(CILISP_CONTEXT *ctx, AST_NODE *op1)
 {
     // Most recent helper function yes I put it at the bottom.
 
     if (!op1)
     {
-        printf("Warning: This operation did not retrieve a number\n");
+        outputPrintf(ctx, "Warning: This operation did not retrieve a number\n");
         return (RET_VAL) {DOUBLE_TYPE, NAN};
     }
 
     RET_VAL result = {DOUBLE_TYPE, NAN};
 
+    // the line is put together first: print calls among the operands get their output in ahead of it
     AST_NODE *currOp = op1;
-    char buffer[CHAR_BUFFER];
-    int index = 0;
+    OUTPUT_BUFFER line = {NULL, 0, 0};
+    bufferWrite(&line, "print:", 6);
 
     while (currOp != NULL)
     {
-        result = eval(currOp);
+        result = eval(ctx, currOp);
 
         switch (result.type) {
             case INT_TYPE:
-                index += snprintf(buffer + index, CHAR_BUFFER - index, " %ld,", result.value.ival);
+                bufferWrite(&line, " ", 1);
+                bufferLong(&line, result.value.ival);
+                bufferWrite(&line, ",", 1);
                 break;
             case DOUBLE_TYPE:
-                index += snprintf(buffer + index, CHAR_BUFFER - index, " %.2lf,", result.value.dval);
+                bufferPrintf(&line, " %.2lf,", result.value.dval);
                 break;
             default:
-                yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!\n");
+                ciLispError(ctx, "Invalid NUM_NODE_TYPE, probably invalid writes somewhere!\n");
         }
 
         currOp = currOp->next;
 
     }
 
-    printf("print:");
-    puts(buffer);
+    bufferWrite(&line, "\n", 1);
+    outputBuffer(ctx, &line);
+    bufferFree(&line);
 
     if (op1->next != NULL) {
-        printf("WARNING: only the last item in this list is returned.\n");
+        outputPrintf(ctx, "WARNING: only the last item in this list is returned.\n");
     }
 
     return result;
 }
 
 
-RET_VAL helperReadOper(AST_NODE *root)
+RET_VAL helperReadOper(CILISP_CONTEXT *ctx, AST_NODE *root)
 {
     RET_VAL result = {DOUBLE_TYPE, NAN};
 
-    // read from user and store to result
-    char numString[CHAR_BUFFER];
-    printf("read := ");
-    scanf("%s", numString);
-    getchar();
-
-    bool isDouble = false;
-
-    // read the input and verify that it is a number
-    for (int i = 0; numString[i] != '\0'; ++i) {
-        switch (numString[i])
-        {
-            case '0'...'9':
-                break;
-            case '.':
-                if (!isDouble)
-                {
-                    isDouble = true;
-                    break;
-                }
-                else
-                {
-                    // the flag for double was already set. Error out.
-                    yyerror("Extra decimal was entered.\n");
-                }
-            case '-':
-                if (i == 0)
-                {
-                    break;
-                }
-            default:
-                yyerror("Invalid input for a number entered\n");
-                root->type = NUM_NODE_TYPE;
-                root->data.number = result;
-                return result;
-        }
-    }
-
-    // store the value entered from the user to the result
-    if (isDouble)
-    {
-        result.value.dval = strtod(numString, NULL);
-    }
-    else
-    {
-        result.type = INT_TYPE;
-        result.value.ival = strtol(numString, NULL, 10);
-    }
-
-    // Change the function node to a number node
+    // the value that was read is kept for the rest of this evaluation
     // this is to ensure that the number is the same the next time it is called by the program.
-    root->type = NUM_NODE_TYPE;
-    root->data.number = result;
+    if (root->data.function.memoGeneration == ctx->generation)
+        return root->data.function.memo;
 
-    return result;
-}
-
-RET_VAL helperRandOper(AST_NODE *root)
-{
-    RET_VAL result = {DOUBLE_TYPE, {(double) rand() / RAND_MAX}};
-
-    // Change the function node to a number node
-    // this is to ensure that the number is the same the next time it is called by the program.
-    root->type = NUM_NODE_TYPE;
-    root->data.number = result;
-
-    return result;
-}
-
-RET_VAL helperEqualOper(AST_NODE *op1)
-{
+    root->data.function.memoGeneration = ctx->generation;
+    root->data.function.memo = result;
 
-    if (!op1)
-        return (RET_VAL){INT_TYPE, 0};
-    else if (!op1->next)
+    if (!ctx->quiet)
     {
-        yyerror("Too few parameters for the function \"equal\".\n");
-        return (RET_VAL){INT_TYPE, 0};
+        outputPrintf(ctx, "read := ");
+        outputFlush(ctx);
     }
 
-    RET_VAL result = eval(op1);
-    RET_VAL op2 = eval(op1->next);
-
-    switch (result.type)
+    switch (readNumber(&ctx->in, &result))
     {
-        case INT_TYPE:
-            switch (op2.type)
-            {
-                case INT_TYPE:
-                    result.value.ival = (result.value.ival == op2.value.ival) ? 1 : 0;
-                    break;
-                case DOUBLE_TYPE:
-                    result.value.ival = (fabs( (double) result.value.ival - op2.value.dval) < BUFFER_DOUBLE) ? 1 : 0;
-                    break;
-                default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            }
-            break;
-        case DOUBLE_TYPE:
-            switch (op2.type)
-            {
-                case INT_TYPE:
-                    result.type = INT_TYPE;
-                    result.value.ival = (fabs(  result.value.dval - (double) op2.value.ival) < BUFFER_DOUBLE) ? 1 : 0;
-                    break;
-                case DOUBLE_TYPE:
-                    result.type = INT_TYPE;
-                    result.value.ival = (fabs( result.value.dval - op2.value.dval) < BUFFER_DOUBLE) ? 1 : 0;                    break;
-                default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            }
+        case READ_OK:
             break;
-        default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
+        case READ_END:
+            // a condition of its own, so hosts can tell running out of numbers apart from bad ones
+            ctx->endOfInput = true;
+            ciLispError(ctx, "End of input for read\n");
+            return result;
+        case READ_INVALID:
+            ciLispError(ctx, "Invalid input for a number entered\n");
+            return result;
     }
 
-    if (op1->next->next != NULL)
-    {
-        yyerror("Too many parameters for the function \"equal\".\n\t\tExtra parameters will be ignored\n");
-    }
+    root->data.function.memo = result;
 
     return result;
-
 }
 
-RET_VAL helperLessOper(AST_NODE *op1)
+RET_VAL helperRandOper(CILISP_CONTEXT *ctx, AST_NODE *root)
 {
+    // each context draws from its own generator state
+    if (ctx->freshRand)
+        return (RET_VAL) {DOUBLE_TYPE, {randomDouble(&ctx->random)}};
 
-    if (!op1)
-        return (RET_VAL){INT_TYPE, 0};
-    else if (!op1->next)
-    {
-        yyerror("Too few parameters for the function \"less\".\n");
-        return (RET_VAL){INT_TYPE, 0};
-    }
-
-    RET_VAL result = eval(op1);
-    RET_VAL op2 = eval(op1->next);
+    // same value for the rest of this evaluation, like read
+    if (root->data.function.memoGeneration == ctx->generation)
+        return root->data.function.memo;
 
-    switch (result.type)
-    {
-        case INT_TYPE:
-            switch (op2.type)
-            {
-                case INT_TYPE:
-                    result.value.ival = (result.value.ival < op2.value.ival);
-                    break;
-                case DOUBLE_TYPE:
-                    result.value.ival = ( (double) result.value.ival < op2.value.dval);
-                    break;
-                default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            }
-            break;
-        case DOUBLE_TYPE:
-            switch (op2.type)
-            {
-                case INT_TYPE:
-                    result.type = INT_TYPE;
-                    result.value.ival = ( result.value.dval < (double) op2.value.ival);
-                    break;
-                case DOUBLE_TYPE:
-                    result.type = INT_TYPE;
-                    result.value.ival = (result.value.dval < op2.value.dval);
-                    break;
-                default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            }
-            break;
-        default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-    }
+    RET_VAL result = {DOUBLE_TYPE, {randomDouble(&ctx->random)}};
 
-    if (op1->next->next != NULL)
-    {
-        yyerror("Too many parameters for the function \"less\".\n\t\tExtra parameters will be ignored\n");
-    }
+    root->data.function.memoGeneration = ctx->generation;
+    root->data.function.memo = result;
 
     return result;
 }
 
-RET_VAL helperGreaterOper(AST_NODE *op1)
-{
 
-    if (!op1)
-        return (RET_VAL){INT_TYPE, 0};
-    else if (!op1->next)
-    {
-        yyerror("Too few parameters for the function \"greater\".\n");
-        return (RET_VAL){INT_TYPE, 0};
-    }
 
-    RET_VAL result = eval(op1);
-    RET_VAL op2 = eval(op1->next);
 
-    switch (result.type)
-    {
-        case INT_TYPE:
-            switch (op2.type)
-            {
-                case INT_TYPE:
-                    result.value.ival = (result.value.ival > op2.value.ival);
-                    break;
-                case DOUBLE_TYPE:
-                    result.value.ival = ( (double) result.value.ival > op2.value.dval);
-                    break;
-                default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            }
-            break;
-        case DOUBLE_TYPE:
-            switch (op2.type)
-            {
-                case INT_TYPE:
-                    result.type = INT_TYPE;
-                    result.value.ival = ( result.value.dval > (double) op2.value.ival);
-                    break;
-                case DOUBLE_TYPE:
-                    result.type = INT_TYPE;
-                    result.value.ival = (result.value.dval > op2.value.dval);
-                    break;
-                default:
-                    yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-            }
-            break;
-        default:
-            yyerror("Invalid NUM_NODE_TYPE, probably invalid writes somewhere!");
-    }
+// TODO newest helper function: helper for Lambda Functions
 
-    if (op1->next->next != NULL)
-    {
-        yyerror("Too many parameters for the function \"greater\".\n\t\tExtra parameters will be ignored\n");
-    }
+// A call optimizeForm inlined: the parameters go straight into the arguments of the call's own copy of the
+// lambda body, without the lookup and the stack nodes. They are all evaluated before any argument is written,
+// as in bindArguments(); the inliner only takes calls with one parameter per argument.
+static RET_VAL evalInlinedCall(CILISP_CONTEXT *ctx, AST_NODE *root)
+{
+    AST_NODE *body = root->data.function.inlined;
+    RET_VAL values[INLINE_MAX_ARGS];
+    AST_NODE *currOp = root->data.function.opList;
+    ARG_TABLE_NODE *currArg;
+    int count = 0;
 
-    return result;
-}
+    for (currArg = body->argTable; currArg != NULL && currOp != NULL; currArg = currArg->next, currOp = currOp->next)
+        values[count++] = eval(ctx, currOp);
 
-// TODO newest helper function: helper for Lambda Functions
+    count = 0;
+    for (currArg = body->argTable; currArg != NULL; currArg = currArg->next)
+        currArg->argVal = values[count++];
 
-RET_VAL helperCustomOper(AST_NODE *root)
+    return eval(ctx, body);
+}
+
+RET_VAL helperCustomOper(CILISP_CONTEXT *ctx, AST_NODE *root)
 {
 
     if (!root)
         return (RET_VAL){DOUBLE_TYPE, NAN};
 
+    if (root->data.function.inlined != NULL)
+        return evalInlinedCall(ctx, root);
+
     RET_VAL result = {DOUBLE_TYPE, NAN};
 
     SYMBOL_TABLE_NODE *lambdaSeeker;
@@ -1687,26 +1485,30 @@ RET_VAL helperCustomOper(AST_NODE *root)
     // Step 1: find the Symbol Table Node for the given lambda and its respective function (same as eval Symbol AST)
     while (lambdaFunctionSeeker != NULL)
     {
-        lambdaSeeker = lambdaFunctionSeeker->symbolTable;
-        while (lambdaSeeker != NULL)
+        lambdaSeeker = findInScope(lambdaFunctionSeeker, lambdaName, LAMBDA_TYPE);
+
+        // when lambda Symbol table node is found
+        // Step 2: Evaluate all necessary parameters for the function
+        if (lambdaSeeker != NULL)
         {
-            // when lambda Symbol table node is found
-            // Step 2: Evaluate all necessary parameters for the function
-            if (!strcmp(lambdaSeeker->ident, lambdaName) && (lambdaSeeker->sym_type == LAMBDA_TYPE))
+            // recursion only goes through here, so this is where depth and stack are kept in check
+            if (!budgetEnterCall(ctx))
+                return (RET_VAL){DOUBLE_TYPE, NAN};
+            if (ctx->metrics != NULL)
+                METRIC_ADD(ctx->metrics->lambdaCalls, 1);
+
+            if (!bindArguments(ctx, lambdaSeeker, root->data.function.opList))
             {
-                lambdaFunctionSeeker = lambdaSeeker->val;
-                STACK_NODE *argValues = createStackNodes(lambdaFunctionSeeker, root->data.function.opList);
-                if (argValues == NULL)
-                    return (RET_VAL){DOUBLE_TYPE, NAN};
-                
-                attachStackNodes(lambdaFunctionSeeker->argTable, argValues);
-
-                // Step 3: evaluate lambda's function
-                result = eval(lambdaFunctionSeeker);
-                return result;
+                ctx->depth--;
+                return (RET_VAL){DOUBLE_TYPE, NAN};
             }
-            lambdaSeeker = lambdaSeeker->next;
-        } // END of Symbol Table traversal
+            lambdaFunctionSeeker = lambdaSeeker->val;
+
+            // Step 3: evaluate lambda's function
+            result = eval(ctx, lambdaFunctionSeeker);
+            ctx->depth--;
+            return result;
+        } // END of Symbol Table search
 
         lambdaFunctionSeeker = lambdaFunctionSeeker->parent;
     } // END of AST node traversal
@@ -1714,92 +1516,72 @@ RET_VAL helperCustomOper(AST_NODE *root)
     return result;
 }
 
-STACK_NODE *createStackNodes(AST_NODE *lambdaFunc, AST_NODE *paramList)
+static bool growArgStack(CILISP_CONTEXT *ctx, size_t needed)
 {
-    if (paramList == NULL) {
-        yyerror("No parameters entered for lambda function\n");
-        return NULL;
-    }
+    size_t size = ctx->argStackSize ? ctx->argStackSize : ARG_STACK_INITIAL;
+    while (size < needed)
+        size *= 2;
 
-    if (lambdaFunc == NULL) {
-        yyerror("lambda function contains no parameters. Invalid writes somewhere\n");
-        return NULL;
+    RET_VAL *stack = realloc(ctx->argStack, size * sizeof(RET_VAL));
+    if (stack == NULL)
+    {
+        ciLispError(ctx, "Memory allocation failed!");
+        return false;
     }
 
-    STACK_NODE *head;
-    size_t nodeSize;
-
-    // allocate space (or error)
-    nodeSize = sizeof(STACK_NODE);
-    if ((head = calloc(nodeSize, 1)) == NULL)
-        yyerror("Memory allocation failed!");
+    ctx->argStack = stack;
+    ctx->argStackSize = size;
+    if (ctx->metrics != NULL)
+        METRIC_ADD(ctx->metrics->argumentAllocations, 1);
+    return true;
+}
 
-    // evaluate the first node
-    head->val = eval(paramList);
+bool bindArguments(CILISP_CONTEXT *ctx, SYMBOL_TABLE_NODE *lambda, AST_NODE *paramList)
+{
+    AST_NODE *lambdaFunc = lambda->val;
 
+    if (paramList == NULL) {
+        ciLispError(ctx, "No parameters entered for lambda function\n");
+        return false;
+    }
 
-    // evaluate one parameter per lambda argument and create a stack node for it
-    ARG_TABLE_NODE *currArg = lambdaFunc->argTable->next;
-    AST_NODE * currOp = paramList->next;
+    if (lambdaFunc == NULL) {
+        ciLispError(ctx, "lambda function contains no parameters. Invalid writes somewhere\n");
+        return false;
+    }
 
-    STACK_NODE *tail = head;
+    // this call's slots, on top of those of the calls whose parameters are still being evaluated
+    size_t base = ctx->argStackTop;
+    if (base + lambda->arity > ctx->argStackSize && !growArgStack(ctx, base + lambda->arity))
+        return false;
+    ctx->argStackTop = base + lambda->arity;
 
-    while ((currArg != NULL) && (currOp != NULL))
+    // evaluate one parameter per lambda argument; a parameter that calls a lambda may move the stack
+    size_t count = 0;
+    AST_NODE *currOp = paramList;
+    for (; count < lambda->arity && currOp != NULL; count++, currOp = currOp->next)
     {
-
-        if ((tail->next = calloc(nodeSize, 1)) == NULL)
-            yyerror("Memory allocation failed!");
-
-        tail = tail->next;
-        tail->next = NULL;
-        tail->val = eval(currOp);
-
-        currArg = currArg->next;
-        currOp = currOp->next;
+        RET_VAL val = eval(ctx, currOp);
+        ctx->argStack[base + count] = val;
     }
 
-
     // If there are too few or too many arguments, print an error
-    if ((currArg == NULL) && (currOp != NULL))
+    if (currOp != NULL)
     {
-        yyerror("Too many parameters for lambda function.\n\t\tExtra parameters will be ignored\n");
+        ciLispError(ctx, "Too many parameters for lambda function.\n\t\tExtra parameters will be ignored\n");
     }
-    else if (currArg != NULL)
+    else if (count < lambda->arity)
     {
-        yyerror("Too few parameters for lambda function.\t\tMissing parameters will be defaulted to 1\n");
-        while (currArg != NULL)
-        {
-
-            if ((tail->next = calloc(nodeSize, 1)) == NULL)
-                yyerror("Memory allocation failed!");
-
-            tail = tail->next;
-            tail->next = NULL;
-            tail->val = (RET_VAL) {INT_TYPE, 1};
-
-            currArg = currArg->next;
-        }
+        ciLispError(ctx, "Too few parameters for lambda function.\t\tMissing parameters will be defaulted to 1\n");
+        for (; count < lambda->arity; count++)
+            ctx->argStack[base + count] = (RET_VAL){INT_TYPE, {.ival = 1}};
     }
 
-    return head;
-}
-
-void attachStackNodes(ARG_TABLE_NODE *lambdaArgs, STACK_NODE *paramVals)
-{
-    // assign retrieved values to their respective args
-    ARG_TABLE_NODE *currArg = lambdaArgs;
-    STACK_NODE *currStackNode = paramVals;
-    STACK_NODE *prevStackNode;
-
-    while ((currArg != NULL))
-    {
-        prevStackNode = currStackNode;
-
-        currArg->argVal = currStackNode->val;
+    // assign the values to their respective args
+    count = 0;
+    for (ARG_TABLE_NODE *currArg = lambdaFunc->argTable; currArg != NULL; currArg = currArg->next)
+        currArg->argVal = ctx->argStack[base + count++];
 
-        // move to next and free the stack node
-        currArg = currArg->next;
-        currStackNode = currStackNode->next;
-        free(prevStackNode);
-    }
+    ctx->argStackTop = base;
+    return true;
 }
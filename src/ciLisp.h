@@ -2,6 +2,7 @@
 #define __cilisp_h_
 #define BUFFER_DOUBLE 0.000001
 #define CHAR_BUFFER 128
+#define ERROR_BUFFER 256
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,45 +10,86 @@
 #include <string.h>
 #include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stdatomic.h>
 
 #include "ciLispParser.h"
 
-int yyparse(void);
+int yylex(YYSTYPE *lvalp, yyscan_t scanner);
 
-int yylex(void);
+int yylex_destroy(yyscan_t scanner);
 
-void yyerror(char *);
+void yyerror(yyscan_t scanner, CILISP_CONTEXT *ctx, const char *s);
 
-// Enum of all operators.
-// must be in sync with funcs in resolveFunc()
+// How a builtin operator takes its operands and types its result (see ciLispOperators.def)
+typedef enum {
+    UNARY_ARITY,
+    BINARY_ARITY,
+    FOLD_ARITY,
+    CHAIN_ARITY,
+    LAZY_ARITY,
+    SPECIAL_ARITY
+} OPER_ARITY;
+
+typedef enum {
+    SAME_RESULT,
+    DOUBLE_RESULT,
+    PREDICATE_RESULT
+} OPER_RESULT;
+
+// Enum of all operators, in the order of ciLispOperators.def
 typedef enum oper {
-    NEG_OPER, // 0
-    ABS_OPER,
-    EXP_OPER,
-    SQRT_OPER,
-    ADD_OPER,
-    SUB_OPER,
-    MULT_OPER,
-    DIV_OPER,
-    REMAINDER_OPER,
-    LOG_OPER,
-    POW_OPER,
-    MAX_OPER,
-    MIN_OPER,
-    EXP2_OPER,
-    CBRT_OPER,
-    HYPOT_OPER,
-    READ_OPER,
-    RAND_OPER,
-    PRINT_OPER,
-    EQUAL_OPER,
-    LESS_OPER,
-    GREATER_OPER,
+#define OPER(id, ...) id##_OPER,
+#include "ciLispOperators.def"
+#undef OPER
+    OPER_COUNT,
     CUSTOM_OPER =255
 } OPER_TYPE;
 
+typedef struct {
+    OPER_ARITY arity;
+    OPER_RESULT result;
+    bool pure;
+} OPER_SPEC;
+
 OPER_TYPE resolveFunc(char *);
 
+// names and specifications of the operators, indexed by OPER_TYPE
+extern char *funcNames[];
+extern const OPER_SPEC operSpecs[];
+
+// Integer pow: a to the power b by squaring, exact where pow() would round through a double. Saturates at
+// LONG_MAX (LONG_MIN for a negative result) on overflow; a negative b truncates 1 / a^-b like int div does.
+// 0 to a negative power is a division by zero, reported before the kernel is called (see operApply).
+// The --emit-c runtime has a copy of it.
+static inline long powInt(long a, long b)
+{
+    long result = 1;
+    bool negative = a < 0 && (b & 1);
+
+    if (b < 0)
+        return (a == 1 || a == -1) ? (negative ? -1 : 1) : 0;
+
+    for (;;)
+    {
+        if ((b & 1) && __builtin_mul_overflow(result, a, &result))
+            return negative ? LONG_MIN : LONG_MAX;
+        if ((b >>= 1) == 0)
+            return result;
+        if (__builtin_mul_overflow(a, a, &a))
+            return negative ? LONG_MIN : LONG_MAX;
+    }
+}
+
+// The kernels of the operators: <id>IntKernel(long, long) and <id>DoubleKernel(double, double) for each
+// line of ciLispOperators.def, inlined into the evaluators in ciLisp.c and the batch loops in ciLispBatch.c
+#define OPER(id, name, arity, result, pure, intKernel, doubleKernel) \
+    static inline long id##IntKernel(long a, long b) { return (intKernel); } \
+    static inline double id##DoubleKernel(double a, double b) { return (doubleKernel); }
+#include "ciLispOperators.def"
+#undef OPER
+
 // Types of Abstract Syntax Tree nodes.
 // Initially, there are only numbers and functions.
 // You will expand this enum as you build the project.
@@ -55,9 +97,15 @@ typedef enum {
     NUM_NODE_TYPE,
     FUNC_NODE_TYPE,
     SYMBOL_NODE_TYPE,
-    COND_NODE_TYPE
+    COND_NODE_TYPE,
+    PROGN_NODE_TYPE,
+    WHILE_NODE_TYPE,
+    FOR_NODE_TYPE,
+    SET_NODE_TYPE
 } AST_NODE_TYPE;
 
+#define AST_NODE_TYPES (SET_NODE_TYPE + 1)
+
 // Types of numeric values
 typedef enum {
     INT_TYPE,
@@ -94,6 +142,11 @@ typedef struct {
     OPER_TYPE oper;
     char* ident; // only needed for custom functions
     struct ast_node *opList;
+    // read and rand keep their value for the rest of one evaluation (see evalForm), so does a common subexpression
+    RET_VAL memo;
+    unsigned long memoGeneration;
+    struct ast_node *common; // the node that evaluates this subtree and its copies, set by optimizeForm
+    struct ast_node *inlined; // this call's own copy of the lambda body, set by optimizeForm
 } FUNC_AST_NODE;
 
 // Symbol table node chain for storing values of variables to a knowledge base
@@ -107,6 +160,10 @@ typedef struct symbol_table_node {
     char *ident;
     struct ast_node *val;
     struct symbol_table_node *next;
+    // value given by set, only for the evaluation it was set in (see evalForm)
+    RET_VAL assigned;
+    unsigned long assignedGeneration;
+    size_t arity; // arguments of a lambda, counted once by createLambdaSymbolTableNode
 } SYMBOL_TABLE_NODE;
 
 // Symbol Abstract Syntax Tree Node. Node to store a defined variable.
@@ -124,17 +181,47 @@ typedef struct {
     struct ast_node *falseNode; // to eval if cond is zero
 } COND_AST_NODE;
 
+// Sequence Abstract Syntax Tree Node (progn/begin). The s-expressions of body are evaluated in order
+// and the value of the last one is returned.
+typedef struct {
+    struct ast_node *body;
+} SEQUENCE_AST_NODE;
+
+// Loop Abstract Syntax Tree Node (while, dotimes and for). body is evaluated once per iteration, in place,
+// and the loop returns the value of the last iteration (nan when there was none).
+// The counter of dotimes/for is the one entry of the node's argTable, so the body sees it like a lambda argument.
+typedef struct {
+    struct ast_node *condNode;  // while: checked before every iteration
+    struct ast_node *startNode; // for: first value of the counter (dotimes counts from 0)
+    struct ast_node *endNode;   // dotimes/for: the counter stops before reaching it
+    struct ast_node *body;
+} LOOP_AST_NODE;
+
+// Assignment Abstract Syntax Tree Node (set ident s_expr): gives a new value to the closest let variable or
+// lambda/loop argument called ident and returns it
+typedef struct {
+    char *ident;
+    struct ast_node *valueNode;
+} SET_AST_NODE;
+
+// hash index of a large symbol table (see ciLispScope.c)
+typedef struct symbol_index SYMBOL_INDEX;
+
 // Generic Abstract Syntax Tree node. Stores the type of node,
 // and reference to the corresponding specific node (initially a number or function call).
 typedef struct ast_node {
     AST_NODE_TYPE type;
     SYMBOL_TABLE_NODE *symbolTable;
+    SYMBOL_INDEX *symbolIndex; // only for symbol tables of SCOPE_INDEX_THRESHOLD or more definitions
     struct arg_table_node *argTable;
     struct ast_node *parent;
     union {
         NUM_AST_NODE number;
         FUNC_AST_NODE function;
         COND_AST_NODE condition;
+        SEQUENCE_AST_NODE sequence;
+        LOOP_AST_NODE loop;
+        SET_AST_NODE assignment;
         SYMBOL_AST_NODE symbol;
     } data;
     struct ast_node *next;
@@ -144,13 +231,6 @@ typedef struct ast_node {
 //  a convenience function that allocates memory for AST nodes
 AST_NODE *newNode(AST_NODE_TYPE type);
 
-// TODO new:
-//  Stack Node: a link list that stores the result of processing each argument passed to a custom function
-typedef struct stack_node {
-    RET_VAL val;
-    struct stack_node *next;
-} STACK_NODE;
-
 // TODO new:
 //  Argument Node: the arguments taken in by the user defined function
 typedef struct arg_table_node {
@@ -161,6 +241,9 @@ typedef struct arg_table_node {
 
 AST_NODE *createNumberNode(double value, NUM_TYPE type);
 
+// Same for an INT token, which keeps every digit of the literal
+AST_NODE *createIntNode(long value, NUM_TYPE type);
+
 AST_NODE *createFunctionNode(char *funcName, AST_NODE *op1);
 
 // Creates symbol type AST node
@@ -177,9 +260,31 @@ SYMBOL_TABLE_NODE *createSymbolTableNode(char *type, char *ident, AST_NODE *val)
 // links Symbol Table Node Chain
 SYMBOL_TABLE_NODE *linkLetSection(SYMBOL_TABLE_NODE *head, SYMBOL_TABLE_NODE *newVal);
 
+// Symbol tables with at least this many definitions are also indexed by a hash table
+#ifndef SCOPE_INDEX_THRESHOLD
+#define SCOPE_INDEX_THRESHOLD 16
+#endif
+
+// Hash of length bytes of text for the interpreter's hash tables (symbol indexes, the REPL session, the AST
+// writer, the server cache): its low bits are fit to pick a slot
+uint64_t hashText(const char *text, size_t length);
+
+// (Re)builds the index of node->symbolTable; to be called whenever the table is replaced
+void indexScope(AST_NODE *node);
+void freeScopeIndex(AST_NODE *node);
+
+// The first definition of ident with the given type in the symbol table of node (not its parents), or NULL
+SYMBOL_TABLE_NODE *findInScope(AST_NODE *node, const char *ident, SYMBOL_TYPE type);
+
 // Creates condition type AST node
 AST_NODE *createCondNode(AST_NODE *conditionsExpr, AST_NODE *truthExpr, AST_NODE *falseExpr);
 
+// Creates the progn, while, dotimes/for (startExpr is NULL for dotimes) and set AST nodes
+AST_NODE *createSequenceNode(AST_NODE *body);
+AST_NODE *createWhileNode(AST_NODE *conditionExpr, AST_NODE *body);
+AST_NODE *createForNode(char *ident, AST_NODE *startExpr, AST_NODE *endExpr, AST_NODE *body);
+AST_NODE *createSetNode(char *ident, AST_NODE *valueExpr);
+
 // TODO new section:
 //  1) create createArgTableList function that creates a list of args - done
 //  2) create createLambdaSymbolTableNode that creates a user defined function as a Symbol Table Node - done
@@ -193,60 +298,433 @@ ARG_TABLE_NODE *createArgTableList(char *headName, ARG_TABLE_NODE *list);
 SYMBOL_TABLE_NODE *createLambdaSymbolTableNode(char *type, char *ident, ARG_TABLE_NODE *argList, AST_NODE *val);
 
 void freeNode(AST_NODE *node);
+// frees every s-expression of a list linked through next
+void freeNodeList(AST_NODE *node);
+void freeSymbolTable(SYMBOL_TABLE_NODE *symbolTable);
+void freeArgTable(ARG_TABLE_NODE *argTable);
 
-RET_VAL eval(AST_NODE *node);
-RET_VAL evalNumNode(NUM_AST_NODE *numNode);
-RET_VAL evalFuncNode(AST_NODE *node);
+// Named numeric value for a symbol that no let section defines (bound through the library API, see ciLispApi.h)
+typedef struct input_binding {
+    char *ident;
+    RET_VAL val;
+    struct input_binding *next;
+} INPUT_BINDING;
 
-// TODO definitely needs to be updated - done
-RET_VAL evalSymbolNode(AST_NODE *symbolNode);
+typedef struct emitter EMITTER;
+typedef struct session SESSION;
+typedef struct ast_writer AST_WRITER;
+typedef struct ast_reader AST_READER;
 
-// A helper for addressing typecasting for symbols
-RET_VAL evalSymbolNodeHelper(SYMBOL_TABLE_NODE *symbol);
+// Growable output buffer (ciLispOutput.c)
+#define OUTPUT_LIMIT (1 << 20) // a context's output is flushed early once it holds this much
 
-RET_VAL evalCondNode(COND_AST_NODE *condAstNode);
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} OUTPUT_BUFFER;
+
+void bufferWrite(OUTPUT_BUFFER *buffer, const void *data, size_t length);
+void bufferVprintf(OUTPUT_BUFFER *buffer, const char *format, va_list args);
+void bufferPrintf(OUTPUT_BUFFER *buffer, const char *format, ...);
+void bufferLong(OUTPUT_BUFFER *buffer, long value);
+// shortest text that reads back as the same double
+void bufferDouble(OUTPUT_BUFFER *buffer, double value);
+void bufferFree(OUTPUT_BUFFER *buffer);
+
+// Where read takes its values from (ciLispInput.c): a stream (file, pipe, the terminal...)
+// or an array of values handed over by the host
+#define READ_BUFFER 65536 // stdio buffer for files opened by readFromFile
+#define READ_TOKEN 64 // longest number read accepts
 
-void printRetVal(RET_VAL val);
+typedef struct {
+    FILE *stream;
+    bool ownsStream; // opened by readFromFile, closed by readClose
+    char *buffer;
+    const RET_VAL *values;
+    size_t valueCount;
+    size_t nextValue;
+} READ_SOURCE;
 
-// evalFuncNode helper methods
+typedef enum {
+    READ_OK,
+    READ_END, // nothing (left) to read
+    READ_INVALID // the next token is not a number, it is skipped
+} READ_STATUS;
+
+// Each of these replaces the previous source. A NULL stream leaves read without input.
+void readFromStream(READ_SOURCE *source, FILE *stream);
+bool readFromFile(READ_SOURCE *source, const char *path);
+void readFromValues(READ_SOURCE *source, const RET_VAL *values, size_t count);
+void readClose(READ_SOURCE *source);
+READ_STATUS readNumber(READ_SOURCE *source, RET_VAL *val);
+
+// Whether the length characters of text are a number read accepts: an optional leading '-', digits and at
+// most one '.', with at least one digit. The definition is a macro so the --emit-c runtime is compiled from the
+// same text (see emitEnd); ciLispInput.c expands it with an empty storage class.
+#define READ_CHECK_FUNCTION(storage) \
+    storage bool readCheck(const char *text, size_t length) \
+    { \
+        bool digits = false; \
+        bool point = false; \
+        for (size_t i = 0; i < length; i++) \
+        { \
+            if (text[i] >= '0' && text[i] <= '9') \
+                digits = true; \
+            else if (text[i] == '.' && !point) \
+                point = true; \
+            else if (text[i] != '-' || i != 0) \
+                return false; \
+        } \
+        return digits; \
+    }
+bool readCheck(const char *text, size_t length);
+
+// The value of a number literal (digits, at most one '.', an optional sign), as strtod/strtol would give it
+RET_VAL parseDecimal(const char *text, size_t length);
+
+// Random number generator behind rand (ciLispRandom.c)
+#define RANDOM_DEFAULT_SEED 1 // the same sequence every run unless a seed is given
 
-RET_VAL helperNegOper(AST_NODE *op1);
-RET_VAL helperAbsOper(AST_NODE *op1);
-RET_VAL helperExpOper(AST_NODE *op1);
-RET_VAL helperSqrtOper(AST_NODE *op1);
-RET_VAL helperAddOper(AST_NODE *op1);
-RET_VAL helperSubOper(AST_NODE *op1);
-RET_VAL helperMultOper(AST_NODE *op1);
-RET_VAL helperDivOper(AST_NODE *op1);
-RET_VAL helperRemainderOper(AST_NODE *op1);
-RET_VAL helperLogOper(AST_NODE *op1);
-RET_VAL helperPowOper(AST_NODE *op1);
-RET_VAL helperMaxOper(AST_NODE *op1);
-RET_VAL helperMinOper(AST_NODE *op1);
+typedef struct {
+    uint64_t s[4];
+} RANDOM_STATE;
+
+void randomSeed(RANDOM_STATE *state, uint64_t seed);
+uint64_t randomNext(RANDOM_STATE *state);
+// uniform in [0, 1)
+double randomDouble(RANDOM_STATE *state);
+void randomFill(RANDOM_STATE *state, double *values, size_t count);
+
+// The definitions of the functions above but randomFill, as a macro so the --emit-c runtime draws the same values
+// from the same text (see emitEnd). helper is the storage class of the rotation, storage the one of the rest.
+#define RANDOM_FUNCTIONS(helper, storage) \
+    helper uint64_t randomRotate(uint64_t x, int k) \
+    { \
+        return (x << k) | (x >> (64 - k)); \
+    } \
+    storage void randomSeed(RANDOM_STATE *state, uint64_t seed) \
+    { \
+        for (int i = 0; i < 4; i++) \
+        { \
+            uint64_t z = (seed += 0x9e3779b97f4a7c15ULL); \
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL; \
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL; \
+            state->s[i] = z ^ (z >> 31); \
+        } \
+    } \
+    storage uint64_t randomNext(RANDOM_STATE *state) \
+    { \
+        uint64_t *s = state->s; \
+        uint64_t result = randomRotate(s[1] * 5, 7) * 9; \
+        uint64_t t = s[1] << 17; \
+        s[2] ^= s[0]; \
+        s[3] ^= s[1]; \
+        s[1] ^= s[2]; \
+        s[0] ^= s[3]; \
+        s[2] ^= t; \
+        s[3] = randomRotate(s[3], 45); \
+        return result; \
+    } \
+    storage double randomDouble(RANDOM_STATE *state) \
+    { \
+        return (double) (randomNext(state) >> 11) * 0x1.0p-53; \
+    }
+
+// Limits of one evaluation (evalForm), 0 for none. An evaluation that goes over one is abandoned: every node
+// left returns at once, loops stop, the error names the limit and ctx->exceeded tells the host which it was.
+typedef enum {
+    BUDGET_NONE,
+    BUDGET_STEPS,
+    BUDGET_DEPTH,
+    BUDGET_MEMORY,
+    BUDGET_TIME
+} BUDGET_KIND;
 
-RET_VAL helperExp2Oper(AST_NODE *op1);
-RET_VAL helperCbrtOper(AST_NODE *op1);
-RET_VAL helperHypotOper(AST_NODE *op1);
+typedef struct {
+    unsigned long steps; // nodes evaluated
+    unsigned long depth; // lambda calls in progress (inlined calls are not recursive and do not count)
+    size_t memory; // bytes of C stack below evalForm, where deep recursion grows; the few allocations of an
+                   // evaluation (argument values) are freed before the call they are for
+    double seconds; // wall clock
+} BUDGET;
+
+#define BUDGET_CLOCK_STEPS 4096 // the time limit is looked at every so many steps
+
+// Instrumentation (ciLispMetrics.c). A context counts into a METRICS block of its own, written only by the thread
+// evaluating in it; readers sum the blocks of all contexts, live and freed, when the counters are written out
+// in the Prometheus text format. Counting is off (ctx->metrics is NULL) unless metricsEnable was called before
+// the context was made.
+#define METRICS_LATENCY_BUCKETS 8 // histogram of evaluation times, upper bounds 1 us, 10 us... 10 s
+#define METRICS_INTERVAL 5 // seconds between two writes of the metrics file
+
+typedef _Atomic unsigned long METRIC;
+
+// only the owning thread adds, so a relaxed load and store (plain moves) are enough for readers to see whole values
+#define METRIC_ADD(counter, n) atomic_store_explicit(&(counter), \
+        atomic_load_explicit(&(counter), memory_order_relaxed) + (n), memory_order_relaxed)
+
+typedef struct metrics {
+    METRIC forms; // evalForm calls
+    METRIC nodes[AST_NODE_TYPES]; // eval calls per node type
+    METRIC lambdaCalls; // not inlined
+    METRIC argumentAllocations; // growths of the argument value stack (see bindArguments)
+    METRIC parseErrors; // yyerror calls
+    METRIC cacheHits; // compiled expressions of the server
+    METRIC cacheMisses;
+    METRIC latency[METRICS_LATENCY_BUCKETS + 1]; // evaluations per bucket (not cumulative), the last one is +Inf
+    METRIC latencyNanoseconds; // sum of the evaluation times
+    struct metrics *prev;
+    struct metrics *next;
+} METRICS;
+
+// Makes every context created from now on count. With a path, a thread writes the counters to it every
+// METRICS_INTERVAL seconds and once more at exit (to a temporary file renamed over it, so a reader never sees
+// half of one). Only the first path given is written. Returns false when the file cannot be written, and then
+// neither starts the writer nor turns counting on.
+bool metricsEnable(const char *path);
+// The block of a new context, NULL while counting is off. A detached block's counts stay in the totals.
+METRICS *metricsAttach(void);
+void metricsDetach(METRICS *metrics);
+// One evalForm that took seconds
+void metricsEvaluated(METRICS *metrics, double seconds);
+void metricsWrite(FILE *out);
+
+// Interpreter context. Everything one parser/evaluator instance needs lives here,
+// so several of them can exist side by side (REPL, library handles, one per thread...).
+// A tree belongs to the context that parsed it and is only touched by that context's evaluations.
+struct cilisp_context {
+    yyscan_t scanner; // created by the first ciLispParse
+    AST_NODE *form; // set by the program rule
+    SYMBOL_TABLE_NODE *definition; // set by the program rule for a single let element
+    int startToken; // handed to the parser before the source, selects what is parsed
+    yypstate *parser; // push parser of a stream (ciLispStreamBegin)
+    bool streaming; // newlines do not end forms
+    bool quit;
+
+    // errors are counted and the first one is kept instead of only being printed
+    int errorCount;
+    char error[ERROR_BUFFER];
+    FILE *errorStream; // NULL keeps errors quiet
+    bool trace; // lex/yacc debug printouts to stderr
+
+    INPUT_BINDING *inputs;
+
+    FILE *out; // results, print and warnings. NULL keeps them quiet
+    OUTPUT_BUFFER output; // what goes to out on the next outputFlush
+    READ_SOURCE in; // where read takes its values from. Without a source read is an error
+    bool quiet; // no "read := " prompt
+    bool endOfInput; // read ran out of input (cleared by the host)
+    RANDOM_STATE random;
+    bool freshRand; // rand draws a new value every time it is reached instead of once per evaluation
+    unsigned long generation; // bumped by every evalForm
+    EMITTER *emitter; // set while translating to C (--emit-c)
+    AST_WRITER *astWriter; // set while writing binary trees (--dump-ast)
+    AST_READER *astReader; // binary AST file evalStream is loading forms from
+    SESSION *session; // parse cache of the REPL (sessionParse)
+    AST_NODE *prelude; // environment every form is evaluated in (preludeLoad)
+    bool preludeReads; // read is called somewhere in the prelude, so forms can not be forked
+    bool forkForms; // the REPL and evalStream evaluate each form in a child process (evalFormForked)
+
+    BUDGET budget; // limits of every evaluation
+    BUDGET_KIND exceeded; // the limit the last evaluation ran into
+    unsigned long steps; // of the current evaluation
+    unsigned long nextCheck; // steps at which eval looks at the budget next, 0 once it is exceeded
+    unsigned long depth;
+    char *stackBase;
+    double deadline;
+
+    METRICS *metrics; // NULL when not counting
+
+    // values of lambda parameters while a call evaluates them (bindArguments). Calls nest, each one takes the
+    // lambda's arity of slots on top and gives them back before the body is evaluated; the stack only grows.
+    RET_VAL *argStack;
+    size_t argStackTop;
+    size_t argStackSize;
+};
+
+// Debug printouts of the scanner and parser
+#define TRACE(ctx, ...) do { if ((ctx)->trace) fprintf(stderr, __VA_ARGS__); } while (0)
+
+void ciLispContextInit(CILISP_CONTEXT *ctx);
+void ciLispContextFree(CILISP_CONTEXT *ctx);
+
+// Reports an error (or a warning) in ctx. A NULL ctx prints straight to stderr.
+void ciLispError(CILISP_CONTEXT *ctx, const char *s);
+
+// Parses one s-expression (defined in ciLisp.l, it drives the reentrant scanner).
+// Returns the tree, or NULL for syntax errors, empty lines and quit.
+AST_NODE *ciLispParse(CILISP_CONTEXT *ctx, const char *source);
+
+// Parses a single let element, "(name s_expr)" or "(name lambda (args) s_expr)" with an optional type.
+// Returns NULL for syntax errors.
+SYMBOL_TABLE_NODE *ciLispParseDefinition(CILISP_CONTEXT *ctx, const char *source);
+
+// Streams: any number of forms, spanning any number of lines, read from in as they come.
+// ciLispStreamNext returns the next form as soon as its last token is read, or NULL at the end of the stream
+// and after a syntax error (errorCount is not 0 then, and the next call carries on after the error).
+// The forms belong to the caller.
+bool ciLispStreamBegin(CILISP_CONTEXT *ctx, FILE *in);
+AST_NODE *ciLispStreamNext(CILISP_CONTEXT *ctx);
+// The scanner's input of a stream (ciLispInput.c): up to size bytes of in, 0 at its end. A read error is
+// reported and ends the stream (ctx->quit).
+size_t streamInput(CILISP_CONTEXT *ctx, FILE *in, char *buffer, size_t size);
+
+// Sets (or replaces) the value of a free symbol in ctx
+void bindInput(CILISP_CONTEXT *ctx, const char *ident, RET_VAL val);
+// Forgets every value bound with bindInput
+void clearInputs(CILISP_CONTEXT *ctx);
+
+// Buffered writes to ctx->out. Nothing reaches out before outputFlush (or OUTPUT_LIMIT)
+void outputPrintf(CILISP_CONTEXT *ctx, const char *format, ...);
+void outputWrite(CILISP_CONTEXT *ctx, const void *data, size_t length);
+void outputBuffer(CILISP_CONTEXT *ctx, OUTPUT_BUFFER *buffer);
+void outputFlush(CILISP_CONTEXT *ctx);
+
+// Evaluates a top level s-expression within ctx->budget. read and rand are drawn again on every call.
+RET_VAL evalForm(CILISP_CONTEXT *ctx, AST_NODE *root);
+
+// Evaluates (or translates, when emitting) every form of in as soon as it is complete and frees it, checking it
+// first like the REPL does. Returns the number of forms, failed gets the number of them with errors; -1 when
+// the stream could not be set up.
+long evalStream(CILISP_CONTEXT *ctx, FILE *in, long *failed);
+
+// Prelude environment (ciLispPrelude.c). preludeLoad parses "(let (name s_expr)...)" once and keeps it in ctx;
+// preludeAttach makes a form see it, as if the form was the body of that let.
+bool preludeLoad(CILISP_CONTEXT *ctx, const char *letSection);
+void preludeAttach(CILISP_CONTEXT *ctx, AST_NODE *form);
+
+// Evaluates form and prints its value in a forked child process, so nothing it does stays behind.
+// Returns false when the child had errors or was killed, or when the form (or the prelude) calls read.
+bool evalFormForked(CILISP_CONTEXT *ctx, AST_NODE *form);
+
+// Runs every file of paths (directories stand for the regular files in them) with evalStream on threadCount
+// threads (0: one per core), each file in a fresh context seeded with seed and given budget. Outputs are written
+// to out in file order, a summary to report. Returns the number of files that failed, -1 when there was nothing
+// to run. (ciLispJobs.c)
+int runJobs(int threadCount, char **paths, int pathCount, uint64_t seed, bool freshRand, const BUDGET *budget,
+            FILE *out, FILE *report);
+
+// Evaluation server (ciLispServer.c): answers length-prefixed requests on the Unix domain socket path, with one
+// epoll loop for the connections and workerCount threads (0: one per core), each with an interpreter context of
+// its own, budget and the prelude when one is given. Runs until SIGINT or SIGTERM, then writes a summary to report.
+// Returns -1 when it could not start.
+#define SERVER_MAX_FRAME (1 << 20) // longest request, a longer one closes the connection
+#define SERVER_MAX_PENDING 1024 // a connection is not read from while this many of its requests are unanswered
+                                // (or OUTPUT_LIMIT of responses are not written)
+#define SERVER_CACHE 64 // compiled expressions each worker keeps
+
+int runServer(const char *path, int workerCount, const char *prelude, uint64_t seed, bool freshRand,
+              const BUDGET *budget, FILE *report);
+
+RET_VAL eval(CILISP_CONTEXT *ctx, AST_NODE *node);
+RET_VAL evalNumNode(CILISP_CONTEXT *ctx, NUM_AST_NODE *numNode);
+RET_VAL evalFuncNode(CILISP_CONTEXT *ctx, AST_NODE *node);
+
+// TODO definitely needs to be updated - done
+RET_VAL evalSymbolNode(CILISP_CONTEXT *ctx, AST_NODE *symbolNode);
 
-RET_VAL helperPrintOper(AST_NODE *op1);
+// A helper for addressing typecasting for symbols
+RET_VAL evalSymbolNodeHelper(CILISP_CONTEXT *ctx, SYMBOL_TABLE_NODE *symbol);
 
+RET_VAL evalCondNode(CILISP_CONTEXT *ctx, COND_AST_NODE *condAstNode);
 
-// functions of part 6
+RET_VAL evalSequenceNode(CILISP_CONTEXT *ctx, SEQUENCE_AST_NODE *sequenceNode);
 
-RET_VAL helperReadOper(AST_NODE *root);
-RET_VAL helperRandOper(AST_NODE *root);
-RET_VAL helperEqualOper(AST_NODE *op1);
-RET_VAL helperLessOper(AST_NODE *op1);
-RET_VAL helperGreaterOper(AST_NODE *op1);
+RET_VAL evalWhileNode(CILISP_CONTEXT *ctx, LOOP_AST_NODE *loopNode);
 
-// TODO task 7/8 Custom Oper helper
-RET_VAL helperCustomOper(AST_NODE *root);
+RET_VAL evalForNode(CILISP_CONTEXT *ctx, AST_NODE *node);
+
+RET_VAL evalSetNode(CILISP_CONTEXT *ctx, AST_NODE *node);
 
-// This evaluates the necessary amount of parameters for a custom function
-// and passes them back to helperCustomOper
-STACK_NODE *createStackNodes(AST_NODE *lambdaFunc, AST_NODE *paramList);
+void printRetVal(CILISP_CONTEXT *ctx, RET_VAL val);
 
-// Attaches the stack nodes RET_VALs to the lambda's arguments and frees the stack nodes
-void attachStackNodes(ARG_TABLE_NODE *lambdaArgs, STACK_NODE *paramVals);
+// evalFuncNode helper methods
+// (the operators of ciLispOperators.def are evaluated by generated code, only the special ones have helpers)
+
+RET_VAL helperPrintOper(CILISP_CONTEXT *ctx, AST_NODE *op1);
+RET_VAL helperReadOper(CILISP_CONTEXT *ctx, AST_NODE *root);
+RET_VAL helperRandOper(CILISP_CONTEXT *ctx, AST_NODE *root);
+
+// TODO task 7/8 Custom Oper helper
+RET_VAL helperCustomOper(CILISP_CONTEXT *ctx, AST_NODE *root);
+
+// Evaluates the parameters of a call to lambda into ctx->argStack, then writes them into the lambda's arguments:
+// every parameter is evaluated before any argument is overwritten. No allocation once the stack is deep enough
+// (ARG_STACK_INITIAL slots to start with). Returns false when the call cannot be made.
+#define ARG_STACK_INITIAL 256
+bool bindArguments(CILISP_CONTEXT *ctx, SYMBOL_TABLE_NODE *lambda, AST_NODE *paramList);
+
+// Static checks (ciLispCheck.c): builtin and lambda arity, undefined functions, unbound symbols and set
+// targets, reported all at once with ciLispError. Precision loss of typed let variables is only a warning.
+// freeSymbols accepts symbols defined nowhere as inputs bound later (library, --batch); the REPL has none.
+// Returns the number of errors. A tree with errors is not evaluated.
+int checkForm(CILISP_CONTEXT *ctx, AST_NODE *root, bool freeSymbols);
+
+// The type node evaluates to when that is known without evaluating it, NO_TYPE otherwise
+NUM_TYPE inferType(AST_NODE *node);
+
+// Optimizations of a checked tree (ciLispOptimize.c), to be run again whenever the tree changed.
+// Calls of small lambdas that are not recursive get a copy of the body (FUNC inlined), then identical pure
+// builtin subtrees that read the same bindings are evaluated once per evaluation (FUNC common).
+void optimizeForm(CILISP_CONTEXT *ctx, AST_NODE *root);
+
+// Limits of inlining: the size of a lambda body in nodes, its arguments, and the nodes copied for one form
+#ifndef INLINE_MAX_NODES
+#define INLINE_MAX_NODES 32
+#endif
+#define INLINE_MAX_ARGS 8
+#define INLINE_BUDGET 65536
+
+// C backend (cilisp --emit-c): translates each top level s-expression instead of evaluating it
+// and writes a standalone C translation unit once the input ends
+bool isEmitting(CILISP_CONTEXT *ctx);
+void emitBegin(CILISP_CONTEXT *ctx, FILE *out);
+void emitForm(CILISP_CONTEXT *ctx, AST_NODE *root);
+void emitEnd(CILISP_CONTEXT *ctx);
+
+// Binary AST files (cilisp --dump-ast, ciLispAst.c): every form of a program as its tree, with interned symbols.
+// astDumpForm writes each form instead of evaluating it, astDumpEnd finishes the file. evalStream recognizes
+// such a file by AST_MAGIC and loads its forms from a memory mapping (astLoadNext) instead of parsing text.
+#define AST_MAGIC "ciLispA"
+#define AST_VERSION 1
+#define AST_MAX_DEPTH 10000 // nesting a file may have, as deep as the parser stack goes
+#define AST_RELEASE (16 << 20) // bytes of the mapping that are read before they are given back
+
+bool isDumpingAst(CILISP_CONTEXT *ctx);
+void astDumpBegin(CILISP_CONTEXT *ctx, FILE *out);
+void astDumpForm(CILISP_CONTEXT *ctx, AST_NODE *root);
+void astDumpEnd(CILISP_CONTEXT *ctx);
+
+// isAstFile looks at the first bytes of a regular file nothing was read from yet, without moving its position;
+// streams without a descriptor are never taken for one. astLoadBegin maps it, false when it cannot.
+// astLoadNext returns the next form, or NULL at the end of the file and for a malformed one (errorCount is not 0
+// then, and the file is not read any further).
+bool isAstFile(FILE *in);
+bool astLoadBegin(CILISP_CONTEXT *ctx, FILE *in);
+AST_NODE *astLoadNext(CILISP_CONTEXT *ctx);
+void astLoadEnd(CILISP_CONTEXT *ctx);
+
+// Incremental parsing for the REPL (ciLispSession.c).
+// A top level form of the shape ((let elem...) body) is cut into its let elements and body, and each part
+// whose text was already seen in the previous such form is taken over from that form's tree instead of
+// being lexed and parsed again. The returned tree belongs to the session: do not free it, it stays valid
+// until the next sessionParse.
+AST_NODE *sessionParse(CILISP_CONTEXT *ctx, const char *source);
+void sessionEnd(CILISP_CONTEXT *ctx);
+
+// Batch evaluation (cilisp --batch): one expression over many rows of named inputs.
+// Rows go through BATCH_CHUNK at a time, and pure builtin subtrees are computed over whole columns.
+#define BATCH_CHUNK 1024
+
+// Evaluates root once per row; row i binds names[c] to columns[c][i]. Same results as evalForm on each row.
+void evalBatch(CILISP_CONTEXT *ctx, AST_NODE *root, int columnCount, char **names, RET_VAL **columns,
+               size_t rowCount, RET_VAL *results);
+
+// Stream a table through root and write one result per row to ctx->out (text, or native doubles when binary).
+// A CSV table starts with a header row naming its columns. Binary columns are files of native doubles.
+// Return the number of rows, or -1 for malformed input.
+long evalBatchCsv(CILISP_CONTEXT *ctx, AST_NODE *root, FILE *csv, bool binary);
+long evalBatchColumns(CILISP_CONTEXT *ctx, AST_NODE *root, int columnCount, char **names, FILE **files, bool binary);
 
 #endif
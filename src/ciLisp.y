@@ -1,8 +1,20 @@
+%code requires {
+    // the scanner is reentrant and every parse happens inside an interpreter context (see ciLisp.h)
+    typedef void *yyscan_t;
+    typedef struct cilisp_context CILISP_CONTEXT;
+}
+
 %{
     #include "ciLisp.h"
 %}
 
+%define api.pure full
+%define api.push-pull both // pull for strings (ciLispParse), push for streams (ciLispStreamNext)
+%param {yyscan_t scanner}
+%parse-param {CILISP_CONTEXT *ctx}
+
 %union {
+    long ival;
     double dval;
     char *sval;
     struct ast_node *astNode;
@@ -11,143 +23,193 @@
 }
 
 %token <sval> FUNC SYMBOL TYPE
-%token <dval> INT DOUBLE
+%token <ival> INT
+%token <dval> DOUBLE
 %token LPAREN RPAREN LET COND LAMBDA EOL QUIT
+%token PROGN WHILE DOTIMES FOR SET
+%token START_LET_ELEM // never scanned from the source, see ciLispParseDefinition
+%token START_STREAM // same, see ciLispStreamBegin
 
 %type <astNode> s_expr f_expr number s_expr_list
 %type <symNode> let_elem let_section let_list
 %type <argNode> arg_list
 
+// what a syntax error throws away: partial trees, let sections and argument lists, and identifiers
+%destructor { freeNodeList($$); } <astNode>
+%destructor { freeSymbolTable($$); } <symNode>
+%destructor { freeArgTable($$); } <argNode>
+%destructor { free($$); } <sval>
+
 
 %%
 
 program:
-    s_expr EOL {
-        fprintf(stderr, "yacc: program ::= s_expr EOL\n");
-        if ($1) {
-            printRetVal(eval($1));
-            freeNode($1);
-        }
+    s_expr end_of_form {
+        TRACE(ctx, "yacc: program ::= s_expr end_of_form\n");
+        // the caller of ciLispParse decides what happens to the tree (eval, emit, keep it for the library...)
+        // a tree is already there when error recovery ends up here a second time
+        freeNode(ctx->form);
+        ctx->form = $1;
+    }
+    | START_LET_ELEM let_elem end_of_form {
+        TRACE(ctx, "yacc: program ::= START_LET_ELEM let_elem end_of_form\n");
+        freeSymbolTable(ctx->definition);
+        ctx->definition = $2;
+    }
+    | START_STREAM stream;
+
+// any number of forms over any number of lines. Left recursive, so the parser stack does not grow with the
+// input, and each form is handed out (ctx->form) as soon as its last token is pushed
+stream:
+    %empty
+    | stream s_expr {
+        TRACE(ctx, "yacc: stream ::= stream s_expr\n");
+        ctx->form = $2;
     };
 
+end_of_form:
+    EOL
+    | %empty; // strings handed to the library do not need a trailing newline
+
 s_expr:
     number {
-        fprintf(stderr, "yacc: s_expr ::= number\n");
+        TRACE(ctx, "yacc: s_expr ::= number\n");
         $$ = $1;
     }
     | SYMBOL {
-    	fprintf(stderr, "yacc: s_expr ::= SYMBOL\n");
+    	TRACE(ctx, "yacc: s_expr ::= SYMBOL\n");
 	$$ = createSymbolNode($1);
     }
     | f_expr {
-	fprintf(stderr, "yacc: s_expr ::= f_expr\n");
+	TRACE(ctx, "yacc: s_expr ::= f_expr\n");
         $$ = $1;
     }
     | QUIT {
-        fprintf(stderr, "yacc: s_expr ::= QUIT\n");
-        exit(EXIT_SUCCESS);
+        TRACE(ctx, "yacc: s_expr ::= QUIT\n");
+        ctx->quit = true;
+        $$ = NULL;
     }
     | error {
-        fprintf(stderr, "yacc: s_expr ::= error\n");
-        yyerror("unexpected token");
+        TRACE(ctx, "yacc: s_expr ::= error\n");
+        yyerror(scanner, ctx, "unexpected token");
         $$ = NULL;
     }
     | LPAREN let_section s_expr RPAREN {
-    	fprintf(stderr, "yacc: s_expr ::= LPAREN let_section s_expr RPAREN\n");
+    	TRACE(ctx, "yacc: s_expr ::= LPAREN let_section s_expr RPAREN\n");
     	$$ = linkASTtoLetList($2, $3);
     }
     | LPAREN COND s_expr s_expr s_expr RPAREN {
-    	fprintf(stderr, "yacc: s_expr ::= LPAREN COND s_expr s_expr s_expr RPAREN\n");
+    	TRACE(ctx, "yacc: s_expr ::= LPAREN COND s_expr s_expr s_expr RPAREN\n");
     	$$ = createCondNode ($3, $4, $5);
     }
+    | LPAREN PROGN s_expr_list RPAREN {
+        TRACE(ctx, "yacc: s_expr ::= LPAREN PROGN s_expr_list RPAREN\n");
+        $$ = createSequenceNode($3);
+    }
+    | LPAREN WHILE s_expr s_expr_list RPAREN {
+        TRACE(ctx, "yacc: s_expr ::= LPAREN WHILE s_expr s_expr_list RPAREN\n");
+        $$ = createWhileNode($3, $4);
+    }
+    | LPAREN DOTIMES LPAREN SYMBOL s_expr RPAREN s_expr_list RPAREN {
+        TRACE(ctx, "yacc: s_expr ::= LPAREN DOTIMES LPAREN SYMBOL s_expr RPAREN s_expr_list RPAREN\n");
+        $$ = createForNode($4, NULL, $5, $7);
+    }
+    | LPAREN FOR LPAREN SYMBOL s_expr s_expr RPAREN s_expr_list RPAREN {
+        TRACE(ctx, "yacc: s_expr ::= LPAREN FOR LPAREN SYMBOL s_expr s_expr RPAREN s_expr_list RPAREN\n");
+        $$ = createForNode($4, $5, $6, $8);
+    }
+    | LPAREN SET SYMBOL s_expr RPAREN {
+        TRACE(ctx, "yacc: s_expr ::= LPAREN SET SYMBOL s_expr RPAREN\n");
+        $$ = createSetNode($3, $4);
+    }
     | LPAREN s_expr RPAREN {
-	fprintf(stderr, "yacc: s_expr ::= LPAREN s_expr RPAREN\n");
+	TRACE(ctx, "yacc: s_expr ::= LPAREN s_expr RPAREN\n");
         $$ = $2;
     };
 
 s_expr_list:
     s_expr s_expr_list {
-    	fprintf(stderr, "yacc: s_expr_list ::= s_expr s_expr_list\n");
+    	TRACE(ctx, "yacc: s_expr_list ::= s_expr s_expr_list\n");
     	$$ = linkSexprToSexprList($1, $2);
     }
     | s_expr {
-        fprintf(stderr, "yacc: s_expr_list ::= s_expr\n");
+        TRACE(ctx, "yacc: s_expr_list ::= s_expr\n");
 	$$ = $1;
     }
 
 number:
     INT {
-        fprintf(stderr, "yacc: number ::= INT\n");
-        $$ = createNumberNode($1, INT_TYPE);
+        TRACE(ctx, "yacc: number ::= INT\n");
+        $$ = createIntNode($1, INT_TYPE);
     }
     | DOUBLE {
-        fprintf(stderr, "yacc: number ::= DOUBLE\n");
+        TRACE(ctx, "yacc: number ::= DOUBLE\n");
         $$ = createNumberNode($1, DOUBLE_TYPE);
     };
     | TYPE INT {
-        fprintf(stderr, "yacc: number ::= INT\n");
-        $$ = createNumberNode($2, resolveNum($1));
+        TRACE(ctx, "yacc: number ::= INT\n");
+        $$ = createIntNode($2, resolveNum($1));
     }
     | TYPE DOUBLE {
-        fprintf(stderr, "yacc: number ::= DOUBLE\n");
+        TRACE(ctx, "yacc: number ::= DOUBLE\n");
         $$ = createNumberNode($2, resolveNum($1));
     };
 
 let_section:
     LPAREN let_list RPAREN {
-    	fprintf(stderr, "yacc: let_section ::= LPAREN let_list RPAREN\n");
+    	TRACE(ctx, "yacc: let_section ::= LPAREN let_list RPAREN\n");
     	$$ = $2;
     };
 
 let_list:
     LET let_elem {
-      	fprintf(stderr, "yacc: let_list ::= LET let_elem\n");
+      	TRACE(ctx, "yacc: let_list ::= LET let_elem\n");
     	$$ = $2;
     }
     | let_list let_elem {
-    	fprintf(stderr, "yacc: let_list ::= let_list let_elem\n");
+    	TRACE(ctx, "yacc: let_list ::= let_list let_elem\n");
     	$$ = linkLetSection($1, $2);
     }
 
 let_elem:
     LPAREN SYMBOL s_expr RPAREN {
-        fprintf(stderr, "yacc: let_elem ::= LPAREN SYMBOL s_expr RPAREN\n");
+        TRACE(ctx, "yacc: let_elem ::= LPAREN SYMBOL s_expr RPAREN\n");
         $$ = createSymbolTableNode("", $2, $3);
     }
     | LPAREN TYPE SYMBOL s_expr RPAREN {
-        fprintf(stderr, "yacc: let_elem ::= LPAREN TYPE SYMBOL s_expr RPAREN\n");
+        TRACE(ctx, "yacc: let_elem ::= LPAREN TYPE SYMBOL s_expr RPAREN\n");
         $$ = createSymbolTableNode($2, $3, $4);
     }
     | LPAREN SYMBOL LAMBDA LPAREN arg_list RPAREN s_expr RPAREN {
-        fprintf(stderr, "yacc: let_elem ::= LPAREN SYMBOL LAMBDA LPAREN arg_list RPAREN s_expr RPAREN\n");
+        TRACE(ctx, "yacc: let_elem ::= LPAREN SYMBOL LAMBDA LPAREN arg_list RPAREN s_expr RPAREN\n");
         $$ = createLambdaSymbolTableNode("", $2, $5, $7);
     }
     | LPAREN TYPE SYMBOL LAMBDA LPAREN arg_list RPAREN s_expr RPAREN {
-        fprintf(stderr, "yacc: let_elem ::= LPAREN TYPE SYMBOL LAMBDA LPAREN arg_list RPAREN s_expr RPAREN\n");
+        TRACE(ctx, "yacc: let_elem ::= LPAREN TYPE SYMBOL LAMBDA LPAREN arg_list RPAREN s_expr RPAREN\n");
         $$ = createLambdaSymbolTableNode($2, $3, $6, $8);
     };
 
 arg_list:
     SYMBOL arg_list {
-    	fprintf(stderr, "yacc: arg_list ::= SYMBOL arg_list\n");
+    	TRACE(ctx, "yacc: arg_list ::= SYMBOL arg_list\n");
 	$$ = createArgTableList($1, $2);
     }
     | SYMBOL {
-    	fprintf(stderr, "yacc: arg_list ::= SYMBOL\n");
+    	TRACE(ctx, "yacc: arg_list ::= SYMBOL\n");
 	$$ = createArgTableList($1, NULL);
     }
 
 f_expr:
     LPAREN FUNC s_expr_list RPAREN {
-        fprintf(stderr, "yacc: s_expr ::= LPAREN FUNC s_expr RPAREN\n");
+        TRACE(ctx, "yacc: s_expr ::= LPAREN FUNC s_expr RPAREN\n");
         $$ = createFunctionNode($2, $3);
     }
     | LPAREN FUNC RPAREN {
-    	fprintf(stderr, "yacc: s_expr ::= LPAREN FUNC RPAREN\n");
+    	TRACE(ctx, "yacc: s_expr ::= LPAREN FUNC RPAREN\n");
     	$$ = createFunctionNode($2, NULL);
     }
     | LPAREN SYMBOL s_expr_list RPAREN {
-            fprintf(stderr, "yacc: s_expr ::= LPAREN SYMBOL s_expr_list RPAREN\n");
+            TRACE(ctx, "yacc: s_expr ::= LPAREN SYMBOL s_expr_list RPAREN\n");
             $$ = createFunctionNode($2, $3);
     }
 %%
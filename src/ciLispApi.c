@@ -0,0 +1,159 @@
+#include "ciLispApi.h"
+
+struct cilisp_program {
+    CILISP_CONTEXT context;
+    AST_NODE *root;
+};
+
+CILISP_PROGRAM *cilispCompile(const char *source, char *errorBuffer, size_t errorBufferSize)
+{
+    CILISP_PROGRAM *program;
+
+    if ((program = calloc(sizeof(CILISP_PROGRAM), 1)) == NULL)
+    {
+        if (errorBuffer != NULL && errorBufferSize > 0)
+            snprintf(errorBuffer, errorBufferSize, "Memory allocation failed!");
+        return NULL;
+    }
+
+    ciLispContextInit(&program->context);
+    program->context.quiet = true;
+    program->root = ciLispParse(&program->context, source);
+
+    // free symbols are the program's inputs, bound after compiling
+    if (program->root != NULL && program->context.errorCount == 0 && checkForm(&program->context, program->root, true) == 0)
+        optimizeForm(&program->context, program->root);
+
+    // error recovery in the parser can still hand back a (partial) tree, which is not worth evaluating
+    if (program->root == NULL || program->context.errorCount > 0)
+    {
+        if (errorBuffer != NULL && errorBufferSize > 0)
+            snprintf(errorBuffer, errorBufferSize, "%s",
+                     program->context.errorCount > 0 ? program->context.error : "no s-expression to compile");
+        cilispFree(program);
+        return NULL;
+    }
+
+    return program;
+}
+
+void cilispBind(CILISP_PROGRAM *program, const char *ident, RET_VAL val)
+{
+    bindInput(&program->context, ident, val);
+}
+
+void cilispBindInt(CILISP_PROGRAM *program, const char *ident, long val)
+{
+    RET_VAL value = {INT_TYPE};
+    value.value.ival = val;
+    bindInput(&program->context, ident, value);
+}
+
+void cilispBindDouble(CILISP_PROGRAM *program, const char *ident, double val)
+{
+    RET_VAL value = {DOUBLE_TYPE};
+    value.value.dval = val;
+    bindInput(&program->context, ident, value);
+}
+
+int cilispEval(CILISP_PROGRAM *program, RET_VAL *result)
+{
+    program->context.errorCount = 0;
+    program->context.error[0] = '\0';
+    program->context.endOfInput = false;
+
+    RET_VAL val = evalForm(&program->context, program->root);
+    outputFlush(&program->context);
+    if (result != NULL)
+        *result = val;
+
+    return program->context.errorCount;
+}
+
+int cilispEvalBatch(CILISP_PROGRAM *program, int columnCount, char **names, RET_VAL **columns,
+                    size_t rowCount, RET_VAL *results)
+{
+    program->context.errorCount = 0;
+    program->context.error[0] = '\0';
+    program->context.endOfInput = false;
+
+    evalBatch(&program->context, program->root, columnCount, names, columns, rowCount, results);
+    outputFlush(&program->context);
+
+    return program->context.errorCount;
+}
+
+void cilispSetOutput(CILISP_PROGRAM *program, FILE *out)
+{
+    program->context.out = out;
+}
+
+void cilispSetInput(CILISP_PROGRAM *program, FILE *in)
+{
+    readFromStream(&program->context.in, in);
+}
+
+int cilispSetInputFile(CILISP_PROGRAM *program, const char *path)
+{
+    return readFromFile(&program->context.in, path) ? 0 : -1;
+}
+
+void cilispSetInputValues(CILISP_PROGRAM *program, const RET_VAL *values, size_t count)
+{
+    readFromValues(&program->context.in, values, count);
+}
+
+bool cilispEndOfInput(CILISP_PROGRAM *program)
+{
+    return program->context.endOfInput;
+}
+
+void cilispSeed(CILISP_PROGRAM *program, uint64_t seed)
+{
+    randomSeed(&program->context.random, seed);
+}
+
+void cilispRandomFill(CILISP_PROGRAM *program, double *values, size_t count)
+{
+    randomFill(&program->context.random, values, count);
+}
+
+void cilispSetFreshRand(CILISP_PROGRAM *program, bool fresh)
+{
+    program->context.freshRand = fresh;
+}
+
+void cilispSetBudget(CILISP_PROGRAM *program, const BUDGET *budget)
+{
+    program->context.budget = *budget;
+}
+
+BUDGET_KIND cilispBudgetExceeded(CILISP_PROGRAM *program)
+{
+    return program->context.exceeded;
+}
+
+void cilispMetricsEnable(void)
+{
+    metricsEnable(NULL);
+}
+
+void cilispMetricsWrite(FILE *out)
+{
+    metricsWrite(out);
+}
+
+const char *cilispError(CILISP_PROGRAM *program)
+{
+    return program->context.error;
+}
+
+void cilispFree(CILISP_PROGRAM *program)
+{
+    if (program == NULL)
+        return;
+
+    freeNode(program->root);
+    ciLispContextFree(&program->context);
+    free(program);
+}
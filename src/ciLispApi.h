@@ -0,0 +1,69 @@
+#ifndef __cilisp_api_h_
+#define __cilisp_api_h_
+
+#include "ciLisp.h"
+
+// Embedding API (libcilisp).
+// A source string is compiled once into a program handle. Free symbols (symbols no let section defines)
+// are bound by name, and the program can then be evaluated as often as needed without reparsing.
+// Every handle owns its own interpreter context, so any number of them can exist at the same time
+// and different handles can be used from different threads. A single handle is not meant to be shared between threads.
+// Nothing is printed: errors are kept in the handle and returned.
+
+typedef struct cilisp_program CILISP_PROGRAM;
+
+// Returns NULL on a syntax error. The first error message is copied to errorBuffer when one is given.
+CILISP_PROGRAM *cilispCompile(const char *source, char *errorBuffer, size_t errorBufferSize);
+
+// Sets (or replaces) the value of a free symbol
+void cilispBind(CILISP_PROGRAM *program, const char *ident, RET_VAL val);
+void cilispBindInt(CILISP_PROGRAM *program, const char *ident, long val);
+void cilispBindDouble(CILISP_PROGRAM *program, const char *ident, double val);
+
+// Where print (and warnings) write to and where read takes its values from. Both default to NULL:
+// nothing is printed and read reports an error. read never prompts in a program handle.
+void cilispSetOutput(CILISP_PROGRAM *program, FILE *out);
+void cilispSetInput(CILISP_PROGRAM *program, FILE *in);
+
+// read from a file (opened and buffered by the handle, -1 if it cannot be opened),
+// or from an array of values that must outlive the handle's evaluations
+int cilispSetInputFile(CILISP_PROGRAM *program, const char *path);
+void cilispSetInputValues(CILISP_PROGRAM *program, const RET_VAL *values, size_t count);
+
+// True when read ran out of input during the last cilispEval/cilispEvalBatch
+// (the error is reported as well, this tells it apart from an invalid number)
+bool cilispEndOfInput(CILISP_PROGRAM *program);
+
+// Evaluates the program into result.
+// Returns 0, or the number of errors reported during the evaluation (the first is in cilispError).
+int cilispEval(CILISP_PROGRAM *program, RET_VAL *result);
+
+// Evaluates the program once per row: row i binds names[c] to columns[c][i] and its value goes to results[i].
+// Pure builtin subtrees are computed over whole columns at a time (see evalBatch).
+// Returns 0, or the number of errors reported during the evaluations.
+int cilispEvalBatch(CILISP_PROGRAM *program, int columnCount, char **names, RET_VAL **columns,
+                    size_t rowCount, RET_VAL *results);
+
+// rand: restart the handle's generator from seed, fill values with count uniform doubles in [0, 1) drawn
+// from it, and choose whether rand draws a new value every time it is reached (fresh) or keeps one value
+// per evaluation (the default)
+void cilispSeed(CILISP_PROGRAM *program, uint64_t seed);
+void cilispRandomFill(CILISP_PROGRAM *program, double *values, size_t count);
+void cilispSetFreshRand(CILISP_PROGRAM *program, bool fresh);
+
+// Limits of every evaluation of the program (see BUDGET in ciLisp.h, 0 for none), and the one the last
+// cilispEval ran into (BUDGET_NONE if it did not), for hosts running untrusted programs
+void cilispSetBudget(CILISP_PROGRAM *program, const BUDGET *budget);
+BUDGET_KIND cilispBudgetExceeded(CILISP_PROGRAM *program);
+
+// Instrumentation: every handle compiled after cilispMetricsEnable counts evaluations, nodes, lambda calls...
+// cilispMetricsWrite writes the sums over all of them, freed ones included, in the Prometheus text format.
+void cilispMetricsEnable(void);
+void cilispMetricsWrite(FILE *out);
+
+// First error reported by the last cilispCompile/cilispEval, "" if there was none
+const char *cilispError(CILISP_PROGRAM *program);
+
+void cilispFree(CILISP_PROGRAM *program);
+
+#endif
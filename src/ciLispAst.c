@@ -0,0 +1,742 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ciLisp.h"
+
+// Binary AST files (cilisp --dump-ast).
+// A generated program does not need to go through the scanner and the parser on every run: the tree of each
+// form is written once, and loading it back walks a read-only mapping of the file, one varint and one node
+// allocation at a time. Forms are loaded one by one like --stream reads them, and the mapping is given back
+// every AST_RELEASE bytes, so a program of any size runs in flat memory.
+//
+//      file        AST_MAGIC, AST_VERSION (one byte), then the forms one after the other
+//      node        a tag byte: the AST_NODE_TYPE in the low 4 bits (AST_TAG_NONE: no node), AST_TAG_LET when
+//                  a let section comes first, AST_TAG_DOUBLE for a double number; then the node:
+//          number      int: zigzag varint, double: 8 bytes of IEEE 754, little endian
+//          function    symbol (operator or lambda name), count, the operands
+//          symbol      symbol
+//          cond        3 nodes
+//          progn       count, the body
+//          while       node, count, the body
+//          for         symbol (the counter), start node (none for dotimes), end node, count, the body
+//          set         symbol, node
+//      let         count, then per definition in symbol table order: a flags byte (1 for a lambda, plus twice
+//                  its NUM_TYPE), symbol, for a lambda a count and its argument symbols, and the value node
+//      symbol      varint i: the i-th symbol of the file. i is the number of symbols so far for a new one, its
+//                  length and its characters follow, with a 0 after them
+//      count       varint (LEB128, 7 bits per byte, low bits first)
+
+#define AST_TAG_TYPE 0x0f
+#define AST_TAG_NONE 0x0f
+#define AST_TAG_LET 0x10
+#define AST_TAG_DOUBLE 0x20
+
+// an identifier written before and its index
+typedef struct {
+    char *ident;
+    uint64_t index;
+} AST_INTERNED;
+
+struct ast_writer {
+    FILE *out;
+    AST_INTERNED *interned; // open addressing by identifier, at most half full
+    size_t mask;
+    uint64_t symbolCount;
+};
+
+// an identifier of the file, pointing into the mapping, and the operator it names
+typedef struct {
+    const char *ident;
+    OPER_TYPE oper;
+} AST_SYMBOL;
+
+struct ast_reader {
+    const unsigned char *map;
+    size_t size;
+    size_t position;
+    size_t released; // the mapping below this was given back
+    AST_SYMBOL *symbols;
+    size_t symbolCount;
+    size_t symbolCapacity;
+    int depth;
+    bool failed;
+};
+
+static uint64_t internHash(const char *ident)
+{
+    return hashText(ident, strlen(ident));
+}
+
+/*
+       Writer
+     */
+
+static void writeVarint(FILE *out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        putc((int) (value & 0x7f) | 0x80, out);
+        value >>= 7;
+    }
+    putc((int) value, out);
+}
+
+static bool internGrow(AST_WRITER *w)
+{
+    size_t size = (w->mask + 1) * 2;
+    AST_INTERNED *interned = calloc(size, sizeof(AST_INTERNED));
+
+    if (interned == NULL)
+        return false;
+
+    for (size_t i = 0; i <= w->mask; i++)
+    {
+        if (w->interned[i].ident == NULL)
+            continue;
+        size_t slot = internHash(w->interned[i].ident) & (size - 1);
+        while (interned[slot].ident != NULL)
+            slot = (slot + 1) & (size - 1);
+        interned[slot] = w->interned[i];
+    }
+
+    free(w->interned);
+    w->interned = interned;
+    w->mask = size - 1;
+    return true;
+}
+
+static void writeSymbol(AST_WRITER *w, const char *ident)
+{
+    size_t slot = internHash(ident) & w->mask;
+
+    for (; w->interned[slot].ident != NULL; slot = (slot + 1) & w->mask)
+    {
+        if (strcmp(w->interned[slot].ident, ident) == 0)
+        {
+            writeVarint(w->out, w->interned[slot].index);
+            return;
+        }
+    }
+
+    size_t length = strlen(ident);
+    writeVarint(w->out, w->symbolCount);
+    writeVarint(w->out, length);
+    fwrite(ident, 1, length + 1, w->out);
+
+    // the reader numbers every new symbol, found again or not: without the copy the identifier is only written
+    // out in full again the next time, as another new symbol
+    w->interned[slot].ident = strdup(ident);
+    w->interned[slot].index = w->symbolCount++;
+    if (w->interned[slot].ident != NULL && w->symbolCount * 2 > w->mask && !internGrow(w))
+    {
+        free(w->interned[slot].ident); // keeps free slots for the lookups to stop at
+        w->interned[slot].ident = NULL;
+    }
+}
+
+static uint64_t listLength(AST_NODE *list)
+{
+    uint64_t length = 0;
+
+    for (; list != NULL; list = list->next)
+        length++;
+
+    return length;
+}
+
+static void writeNode(AST_WRITER *w, AST_NODE *node);
+
+static void writeList(AST_WRITER *w, AST_NODE *list)
+{
+    writeVarint(w->out, listLength(list));
+    for (; list != NULL; list = list->next)
+        writeNode(w, list);
+}
+
+static void writeLet(AST_WRITER *w, SYMBOL_TABLE_NODE *letList)
+{
+    uint64_t count = 0;
+
+    for (SYMBOL_TABLE_NODE *symbol = letList; symbol != NULL; symbol = symbol->next)
+        count++;
+    writeVarint(w->out, count);
+
+    for (SYMBOL_TABLE_NODE *symbol = letList; symbol != NULL; symbol = symbol->next)
+    {
+        bool lambda = symbol->sym_type == LAMBDA_TYPE;
+        putc((lambda ? 1 : 0) | symbol->val_type << 1, w->out);
+        writeSymbol(w, symbol->ident);
+
+        // the arguments are the argTable of the body, which is not written with the body
+        if (lambda)
+        {
+            ARG_TABLE_NODE *args = (symbol->val != NULL) ? symbol->val->argTable : NULL;
+            uint64_t argCount = 0;
+            for (ARG_TABLE_NODE *arg = args; arg != NULL; arg = arg->next)
+                argCount++;
+            writeVarint(w->out, argCount);
+            for (ARG_TABLE_NODE *arg = args; arg != NULL; arg = arg->next)
+                writeSymbol(w, arg->ident);
+        }
+
+        writeNode(w, symbol->val);
+    }
+}
+
+static void writeNode(AST_WRITER *w, AST_NODE *node)
+{
+    if (node == NULL)
+    {
+        putc(AST_TAG_NONE, w->out);
+        return;
+    }
+
+    int tag = node->type;
+    if (node->symbolTable != NULL)
+        tag |= AST_TAG_LET;
+    if (node->type == NUM_NODE_TYPE && node->data.number.type == DOUBLE_TYPE)
+        tag |= AST_TAG_DOUBLE;
+    putc(tag, w->out);
+
+    if (node->symbolTable != NULL)
+        writeLet(w, node->symbolTable);
+
+    switch (node->type)
+    {
+        case NUM_NODE_TYPE:
+            if (node->data.number.type == DOUBLE_TYPE)
+            {
+                uint64_t bits;
+                memcpy(&bits, &node->data.number.value.dval, sizeof(bits));
+                for (int i = 0; i < 8; i++)
+                    putc((int) (bits >> (8 * i)) & 0xff, w->out);
+            }
+            else
+            {
+                uint64_t value = (uint64_t) node->data.number.value.ival;
+                writeVarint(w->out, (value << 1) ^ (0 - (value >> 63)));
+            }
+            break;
+        case FUNC_NODE_TYPE:
+            writeSymbol(w, (node->data.function.oper == CUSTOM_OPER) ?
+                           node->data.function.ident : funcNames[node->data.function.oper]);
+            writeList(w, node->data.function.opList);
+            break;
+        case SYMBOL_NODE_TYPE:
+            writeSymbol(w, node->data.symbol.ident);
+            break;
+        case COND_NODE_TYPE:
+            writeNode(w, node->data.condition.condNode);
+            writeNode(w, node->data.condition.trueNode);
+            writeNode(w, node->data.condition.falseNode);
+            break;
+        case PROGN_NODE_TYPE:
+            writeList(w, node->data.sequence.body);
+            break;
+        case WHILE_NODE_TYPE:
+            writeNode(w, node->data.loop.condNode);
+            writeList(w, node->data.loop.body);
+            break;
+        case FOR_NODE_TYPE:
+            writeSymbol(w, node->argTable->ident);
+            writeNode(w, node->data.loop.startNode);
+            writeNode(w, node->data.loop.endNode);
+            writeList(w, node->data.loop.body);
+            break;
+        case SET_NODE_TYPE:
+            writeSymbol(w, node->data.assignment.ident);
+            writeNode(w, node->data.assignment.valueNode);
+            break;
+    }
+}
+
+bool isDumpingAst(CILISP_CONTEXT *ctx)
+{
+    return ctx->astWriter != NULL;
+}
+
+void astDumpBegin(CILISP_CONTEXT *ctx, FILE *out)
+{
+    AST_WRITER *w;
+
+    if ((w = calloc(1, sizeof(AST_WRITER))) == NULL || (w->interned = calloc(64, sizeof(AST_INTERNED))) == NULL)
+    {
+        free(w);
+        ciLispError(ctx, "Memory allocation failed!");
+        return;
+    }
+
+    w->out = out;
+    w->mask = 63;
+    fwrite(AST_MAGIC, 1, strlen(AST_MAGIC), out);
+    putc(AST_VERSION, out);
+    ctx->astWriter = w;
+}
+
+void astDumpForm(CILISP_CONTEXT *ctx, AST_NODE *root)
+{
+    if (ctx->astWriter == NULL || root == NULL)
+        return;
+
+    writeNode(ctx->astWriter, root);
+}
+
+// Finishes the file and frees the writer. Safe to call when nothing is being dumped.
+void astDumpEnd(CILISP_CONTEXT *ctx)
+{
+    AST_WRITER *w = ctx->astWriter;
+
+    if (w == NULL)
+        return;
+
+    if (fflush(w->out) != 0 || ferror(w->out))
+        ciLispError(ctx, "--dump-ast: the file could not be written");
+    if (w->out != stdout)
+        fclose(w->out);
+
+    for (size_t i = 0; i <= w->mask; i++)
+        free(w->interned[i].ident);
+    free(w->interned);
+    free(w);
+    ctx->astWriter = NULL;
+}
+
+/*
+       Reader
+       Every read checks the bounds of the mapping and every count is only trusted as far as there are bytes
+       for it: a truncated or corrupt file makes astLoadNext fail, it never reads outside the file.
+     */
+
+static bool loadByte(AST_READER *r, unsigned char *byte)
+{
+    if (r->position == r->size)
+    {
+        r->failed = true;
+        return false;
+    }
+
+    *byte = r->map[r->position++];
+    return true;
+}
+
+static bool loadVarint(AST_READER *r, uint64_t *value)
+{
+    unsigned char byte;
+
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (!loadByte(r, &byte))
+            return false;
+        *value |= (uint64_t) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+
+    r->failed = true; // longer than 10 bytes
+    return false;
+}
+
+// ident is NULL when the file is malformed
+static AST_SYMBOL loadSymbol(AST_READER *r)
+{
+    AST_SYMBOL symbol = {NULL, CUSTOM_OPER};
+    uint64_t index;
+    uint64_t length;
+
+    if (!loadVarint(r, &index))
+        return symbol;
+    if (index < r->symbolCount)
+        return r->symbols[index];
+
+    // a new one: the identifier is used where it is in the mapping, so it must end with its 0
+    if (index != r->symbolCount || !loadVarint(r, &length) || length >= r->size - r->position ||
+        r->map[r->position + length] != '\0' || memchr(r->map + r->position, '\0', length) != NULL)
+    {
+        r->failed = true;
+        return symbol;
+    }
+
+    if (r->symbolCount == r->symbolCapacity)
+    {
+        size_t capacity = r->symbolCapacity ? r->symbolCapacity * 2 : 64;
+        AST_SYMBOL *symbols = realloc(r->symbols, capacity * sizeof(AST_SYMBOL));
+        if (symbols == NULL)
+        {
+            r->failed = true;
+            return symbol;
+        }
+        r->symbols = symbols;
+        r->symbolCapacity = capacity;
+    }
+
+    symbol.ident = (const char *) r->map + r->position;
+    symbol.oper = resolveFunc((char *) symbol.ident);
+    r->symbols[r->symbolCount++] = symbol;
+    r->position += length + 1;
+    return symbol;
+}
+
+// a copy of a symbol's identifier for a node, which owns it
+static char *loadIdent(AST_READER *r, AST_SYMBOL symbol)
+{
+    char *ident = strdup(symbol.ident);
+
+    if (ident == NULL)
+        r->failed = true;
+    return ident;
+}
+
+static AST_NODE *loadNode(AST_READER *r);
+
+// count nodes linked through next, none of them missing
+static AST_NODE *loadList(AST_READER *r)
+{
+    uint64_t count;
+    AST_NODE *head = NULL;
+    AST_NODE **tail = &head;
+
+    if (!loadVarint(r, &count))
+        return NULL;
+
+    for (uint64_t i = 0; i < count && !r->failed; i++)
+    {
+        AST_NODE *node = loadNode(r);
+        if (node == NULL)
+            r->failed = true;
+        else
+        {
+            *tail = node;
+            tail = &node->next;
+        }
+    }
+
+    if (r->failed)
+    {
+        freeNodeList(head);
+        return NULL;
+    }
+    return head;
+}
+
+static ARG_TABLE_NODE *loadArguments(AST_READER *r)
+{
+    uint64_t count;
+    ARG_TABLE_NODE *head = NULL;
+    ARG_TABLE_NODE **tail = &head;
+
+    if (!loadVarint(r, &count))
+        return NULL;
+
+    for (uint64_t i = 0; i < count && !r->failed; i++)
+    {
+        AST_SYMBOL symbol = loadSymbol(r);
+        char *ident = (symbol.ident != NULL) ? loadIdent(r, symbol) : NULL;
+        if (ident != NULL)
+        {
+            *tail = createArgTableList(ident, NULL);
+            tail = &(*tail)->next;
+        }
+    }
+
+    if (r->failed)
+    {
+        freeArgTable(head);
+        return NULL;
+    }
+    return head;
+}
+
+static SYMBOL_TABLE_NODE *loadLet(AST_READER *r)
+{
+    uint64_t count;
+    SYMBOL_TABLE_NODE *head = NULL;
+    SYMBOL_TABLE_NODE **tail = &head;
+
+    if (!loadVarint(r, &count))
+        return NULL;
+
+    for (uint64_t i = 0; i < count && !r->failed; i++)
+    {
+        unsigned char flags;
+        if (!loadByte(r, &flags) || flags > (1 | NO_TYPE << 1))
+        {
+            r->failed = true;
+            break;
+        }
+
+        bool lambda = flags & 1;
+        AST_SYMBOL symbol = loadSymbol(r);
+        ARG_TABLE_NODE *args = (lambda && !r->failed) ? loadArguments(r) : NULL;
+        AST_NODE *val = r->failed ? NULL : loadNode(r);
+        char *ident = r->failed ? NULL : loadIdent(r, symbol);
+
+        if (r->failed || (lambda && val == NULL)) // the arguments of a lambda are kept by its body
+        {
+            r->failed = true;
+            free(ident);
+            freeArgTable(args);
+            freeNode(val);
+            break;
+        }
+
+        SYMBOL_TABLE_NODE *definition = lambda ? createLambdaSymbolTableNode("", ident, args, val) :
+                                        createSymbolTableNode("", ident, val);
+        definition->val_type = flags >> 1;
+        *tail = definition;
+        tail = &definition->next;
+    }
+
+    if (r->failed)
+    {
+        freeSymbolTable(head);
+        return NULL;
+    }
+    return head;
+}
+
+static AST_NODE *loadFunction(AST_READER *r)
+{
+    AST_SYMBOL symbol = loadSymbol(r);
+    char *ident = (symbol.ident != NULL && symbol.oper == CUSTOM_OPER) ? loadIdent(r, symbol) : NULL;
+    AST_NODE *opList = r->failed ? NULL : loadList(r);
+
+    if (r->failed)
+    {
+        free(ident);
+        return NULL;
+    }
+
+    // createFunctionNode without looking the name up again: the symbol knows its operator
+    AST_NODE *node = newNode(FUNC_NODE_TYPE);
+    node->data.function.oper = symbol.oper;
+    node->data.function.ident = ident;
+    node->data.function.opList = opList;
+    for (AST_NODE *op = opList; op != NULL; op = op->next)
+        op->parent = node;
+
+    return node;
+}
+
+static AST_NODE *loadNumber(AST_READER *r, unsigned char tag)
+{
+    uint64_t bits = 0;
+
+    if (tag & AST_TAG_DOUBLE)
+    {
+        if (r->size - r->position < 8)
+        {
+            r->failed = true;
+            return NULL;
+        }
+        for (int i = 0; i < 8; i++)
+            bits |= (uint64_t) r->map[r->position++] << (8 * i);
+
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return createNumberNode(value, DOUBLE_TYPE);
+    }
+
+    if (!loadVarint(r, &bits))
+        return NULL;
+    return createIntNode((long) ((bits >> 1) ^ (0 - (bits & 1))), INT_TYPE);
+}
+
+// the parts of a node, every one read (and freed again) even after one failed
+static AST_NODE *loadPayload(AST_READER *r, unsigned char tag)
+{
+    AST_NODE *first;
+    AST_NODE *second;
+    AST_NODE *third;
+    AST_NODE *list;
+    AST_SYMBOL symbol;
+    char *ident;
+
+    switch (tag & AST_TAG_TYPE)
+    {
+        case NUM_NODE_TYPE:
+            return loadNumber(r, tag);
+        case FUNC_NODE_TYPE:
+            return loadFunction(r);
+        case SYMBOL_NODE_TYPE:
+            symbol = loadSymbol(r);
+            ident = (symbol.ident != NULL) ? loadIdent(r, symbol) : NULL;
+            return (ident != NULL) ? createSymbolNode(ident) : NULL;
+        case COND_NODE_TYPE:
+            first = loadNode(r);
+            second = r->failed ? NULL : loadNode(r);
+            third = r->failed ? NULL : loadNode(r);
+            if (!r->failed)
+                return createCondNode(first, second, third);
+            freeNode(first);
+            freeNode(second);
+            freeNode(third);
+            return NULL;
+        case PROGN_NODE_TYPE:
+            list = loadList(r);
+            return r->failed ? NULL : createSequenceNode(list);
+        case WHILE_NODE_TYPE:
+            first = loadNode(r);
+            list = r->failed ? NULL : loadList(r);
+            if (!r->failed)
+                return createWhileNode(first, list);
+            freeNode(first);
+            return NULL;
+        case FOR_NODE_TYPE:
+            symbol = loadSymbol(r);
+            first = r->failed ? NULL : loadNode(r);
+            second = r->failed ? NULL : loadNode(r);
+            list = r->failed ? NULL : loadList(r);
+            ident = r->failed ? NULL : loadIdent(r, symbol);
+            if (!r->failed)
+                return createForNode(ident, first, second, list);
+            freeNode(first);
+            freeNode(second);
+            return NULL;
+        case SET_NODE_TYPE:
+            symbol = loadSymbol(r);
+            first = r->failed ? NULL : loadNode(r);
+            ident = r->failed ? NULL : loadIdent(r, symbol);
+            if (!r->failed)
+                return createSetNode(ident, first);
+            freeNode(first);
+            return NULL;
+        default:
+            r->failed = true;
+            return NULL;
+    }
+}
+
+// NULL for AST_TAG_NONE, and when r->failed
+static AST_NODE *loadNode(AST_READER *r)
+{
+    unsigned char tag;
+
+    if (!loadByte(r, &tag) || tag == AST_TAG_NONE)
+        return NULL;
+
+    if ((tag & ~(AST_TAG_TYPE | AST_TAG_LET | AST_TAG_DOUBLE)) != 0 ||
+        ((tag & AST_TAG_DOUBLE) && (tag & AST_TAG_TYPE) != NUM_NODE_TYPE) || r->depth >= AST_MAX_DEPTH)
+    {
+        r->failed = true;
+        return NULL;
+    }
+
+    r->depth++;
+    SYMBOL_TABLE_NODE *letList = (tag & AST_TAG_LET) ? loadLet(r) : NULL;
+    AST_NODE *node = r->failed ? NULL : loadPayload(r, tag);
+    r->depth--;
+
+    if (r->failed)
+    {
+        freeSymbolTable(letList);
+        freeNode(node);
+        return NULL;
+    }
+
+    if (letList != NULL)
+        linkASTtoLetList(letList, node);
+    return node;
+}
+
+bool isAstFile(FILE *in)
+{
+    struct stat status;
+    char magic[sizeof(AST_MAGIC) - 1];
+
+    // mapped from its start, so nothing of it may have been read through the stream yet
+    return fileno(in) >= 0 && ftell(in) == 0 && fstat(fileno(in), &status) == 0 && S_ISREG(status.st_mode) &&
+           pread(fileno(in), magic, sizeof(magic), 0) == (ssize_t) sizeof(magic) &&
+           memcmp(magic, AST_MAGIC, sizeof(magic)) == 0;
+}
+
+bool astLoadBegin(CILISP_CONTEXT *ctx, FILE *in)
+{
+    struct stat status;
+    size_t header = strlen(AST_MAGIC) + 1;
+
+    astLoadEnd(ctx);
+    if (fstat(fileno(in), &status) != 0 || (size_t) status.st_size < header)
+    {
+        ciLispError(ctx, "Not a binary AST file.");
+        return false;
+    }
+
+    void *map = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fileno(in), 0);
+    if (map == MAP_FAILED)
+    {
+        ciLispError(ctx, "The binary AST file could not be mapped.");
+        return false;
+    }
+
+    const unsigned char *bytes = map;
+    if (bytes[header - 1] != AST_VERSION)
+    {
+        char message[ERROR_BUFFER];
+        snprintf(message, ERROR_BUFFER, "Binary AST file version %d, this interpreter reads version %d.",
+                 bytes[header - 1], AST_VERSION);
+        ciLispError(ctx, message);
+        munmap(map, status.st_size);
+        return false;
+    }
+
+    AST_READER *r = calloc(1, sizeof(AST_READER));
+    if (r == NULL)
+    {
+        ciLispError(ctx, "Memory allocation failed!");
+        munmap(map, status.st_size);
+        return false;
+    }
+
+    madvise(map, status.st_size, MADV_SEQUENTIAL);
+    r->map = bytes;
+    r->size = status.st_size;
+    r->position = header;
+    ctx->astReader = r;
+    return true;
+}
+
+AST_NODE *astLoadNext(CILISP_CONTEXT *ctx)
+{
+    AST_READER *r = ctx->astReader;
+
+    if (r == NULL || r->failed || r->position == r->size)
+        return NULL;
+
+    AST_NODE *form = loadNode(r);
+    if (form == NULL) // a form that is no node is as malformed as a truncated one
+    {
+        char message[ERROR_BUFFER];
+        snprintf(message, ERROR_BUFFER, "Malformed binary AST file at byte %zu.", r->position);
+        r->failed = true;
+        if (ctx->metrics != NULL)
+            METRIC_ADD(ctx->metrics->parseErrors, 1);
+        ciLispError(ctx, message);
+        return NULL;
+    }
+
+    // pages that were read are dropped, symbols pointing into them fault them in again from the file
+    if (r->position - r->released >= AST_RELEASE)
+    {
+        size_t page = (size_t) sysconf(_SC_PAGESIZE);
+        size_t end = r->position / page * page;
+        madvise((void *) (r->map + r->released), end - r->released, MADV_DONTNEED);
+        r->released = end;
+    }
+
+    return form;
+}
+
+// Unmaps the file and frees the reader. Safe to call when nothing is being loaded.
+void astLoadEnd(CILISP_CONTEXT *ctx)
+{
+    AST_READER *r = ctx->astReader;
+
+    if (r == NULL)
+        return;
+
+    munmap((void *) r->map, r->size);
+    free(r->symbols);
+    free(r);
+    ctx->astReader = NULL;
+}
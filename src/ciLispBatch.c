@@ -0,0 +1,784 @@
+#include "ciLisp.h"
+
+// Batch evaluation: one expression evaluated over many rows of inputs.
+// Rows are processed BATCH_CHUNK at a time. Within a chunk the tree is walked once and every builtin runs
+// over a whole column of values (a BATCH_VECTOR) instead of one RET_VAL at a time.
+// Only chunks where every value of a column has the same NUM_TYPE can be vectorized this way, since the
+// INT/DOUBLE rules of the helpers are applied per column. Anything else (lambda calls, read, print,
+// mixed types, int division by zero...) makes the chunk fall back to eval() row by row, so the results are
+// always the same as evaluating each row on its own.
+
+typedef struct {
+    NUM_TYPE type; // of every value in the vector
+    union {
+        long ival[BATCH_CHUNK];
+        double dval[BATCH_CHUNK];
+    } data;
+} BATCH_VECTOR;
+
+// rand nodes keep one value per row, however often they are reached (see helperRandOper), unless freshRand is set
+typedef struct batch_memo {
+    AST_NODE *node;
+    BATCH_VECTOR *vector;
+    struct batch_memo *next;
+} BATCH_MEMO;
+
+typedef struct {
+    CILISP_CONTEXT *ctx;
+    int columnCount;
+    char **names;
+    RET_VAL **columns; // already offset to the first row of the chunk
+    size_t rowCount;
+    BATCH_MEMO *memos;
+} BATCH;
+
+static BATCH_VECTOR *batchVector(NUM_TYPE type)
+{
+    BATCH_VECTOR *vector;
+
+    if ((vector = malloc(sizeof(BATCH_VECTOR))) == NULL)
+        return NULL;
+
+    vector->type = type;
+    return vector;
+}
+
+static BATCH_VECTOR *batchBroadcast(BATCH *batch, RET_VAL val)
+{
+    BATCH_VECTOR *vector = batchVector(val.type);
+
+    if (vector == NULL)
+        return NULL;
+
+    for (size_t i = 0; i < batch->rowCount; i++)
+    {
+        if (val.type == INT_TYPE)
+            vector->data.ival[i] = val.value.ival;
+        else
+            vector->data.dval[i] = val.value.dval;
+    }
+
+    return vector;
+}
+
+static BATCH_VECTOR *batchCopy(BATCH *batch, BATCH_VECTOR *source)
+{
+    BATCH_VECTOR *vector = batchVector(source->type);
+
+    if (vector != NULL)
+        memcpy(&vector->data, &source->data, batch->rowCount * sizeof(double));
+
+    return vector;
+}
+
+static void batchToDouble(BATCH *batch, BATCH_VECTOR *vector)
+{
+    if (vector->type == DOUBLE_TYPE)
+        return;
+
+    for (size_t i = 0; i < batch->rowCount; i++)
+        vector->data.dval[i] = (double) vector->data.ival[i];
+
+    vector->type = DOUBLE_TYPE;
+}
+
+// An input column is only usable as a vector when all of its values in this chunk have one type.
+static BATCH_VECTOR *batchColumn(BATCH *batch, RET_VAL *column)
+{
+    NUM_TYPE type = column[0].type;
+
+    for (size_t i = 1; i < batch->rowCount; i++)
+    {
+        if (column[i].type != type)
+            return NULL;
+    }
+
+    BATCH_VECTOR *vector = batchVector(type);
+    if (vector == NULL)
+        return NULL;
+
+    for (size_t i = 0; i < batch->rowCount; i++)
+    {
+        if (type == INT_TYPE)
+            vector->data.ival[i] = column[i].value.ival;
+        else
+            vector->data.dval[i] = column[i].value.dval;
+    }
+
+    return vector;
+}
+
+static BATCH_VECTOR *batchEval(BATCH *batch, AST_NODE *node);
+
+// Same search as evalSymbolNode(); columns take the place of the context's bound inputs.
+static BATCH_VECTOR *batchSymbol(BATCH *batch, AST_NODE *symbolNode)
+{
+    char *symbol = symbolNode->data.symbol.ident;
+
+    for (AST_NODE *currNode = symbolNode; currNode != NULL; currNode = currNode->parent)
+    {
+        SYMBOL_TABLE_NODE *currSymbol = findInScope(currNode, symbol, VARIABLE_TYPE);
+        if (currSymbol != NULL)
+        {
+            BATCH_VECTOR *vector = batchEval(batch, currSymbol->val);
+            if (vector == NULL)
+                return NULL;
+
+            // type casts of evalSymbolNodeHelper (the precision loss warning needs the row by row path)
+            if (currSymbol->val_type == INT_TYPE && vector->type == DOUBLE_TYPE)
+            {
+                free(vector);
+                return NULL;
+            }
+            if (currSymbol->val_type == DOUBLE_TYPE)
+                batchToDouble(batch, vector);
+
+            return vector;
+        }
+
+        // lambda arguments only exist inside a call
+        for (ARG_TABLE_NODE *currArg = currNode->argTable; currArg != NULL; currArg = currArg->next)
+        {
+            if (!strcmp(symbol, currArg->ident))
+                return NULL;
+        }
+    }
+
+    for (int i = 0; i < batch->columnCount; i++)
+    {
+        if (!strcmp(symbol, batch->names[i]))
+            return batchColumn(batch, batch->columns[i]);
+    }
+
+    for (INPUT_BINDING *currInput = batch->ctx->inputs; currInput != NULL; currInput = currInput->next)
+    {
+        if (!strcmp(symbol, currInput->ident))
+            return batchBroadcast(batch, currInput->val);
+    }
+
+    return batchBroadcast(batch, (RET_VAL) {DOUBLE_TYPE, NAN});
+}
+
+static BATCH_VECTOR *batchRand(BATCH *batch, AST_NODE *node)
+{
+    BATCH_MEMO *memo;
+
+    if (batch->ctx->freshRand)
+    {
+        BATCH_VECTOR *vector = batchVector(DOUBLE_TYPE);
+        if (vector != NULL)
+            randomFill(&batch->ctx->random, vector->data.dval, batch->rowCount);
+        return vector;
+    }
+
+    for (memo = batch->memos; memo != NULL; memo = memo->next)
+    {
+        if (memo->node == node)
+            return batchCopy(batch, memo->vector);
+    }
+
+    if ((memo = calloc(sizeof(BATCH_MEMO), 1)) == NULL || (memo->vector = batchVector(DOUBLE_TYPE)) == NULL)
+    {
+        free(memo);
+        return NULL;
+    }
+
+    randomFill(&batch->ctx->random, memo->vector->data.dval, batch->rowCount);
+
+    memo->node = node;
+    memo->next = batch->memos;
+    batch->memos = memo;
+
+    return batchCopy(batch, memo->vector);
+}
+
+static void batchUnary(BATCH *batch, OPER_TYPE oper, BATCH_VECTOR *a)
+{
+    size_t n = batch->rowCount;
+
+    if (a->type == INT_TYPE && operSpecs[oper].result != DOUBLE_RESULT)
+    {
+        long *x = a->data.ival;
+
+        switch (oper)
+        {
+#define OPER(id, ...) \
+            case id##_OPER: \
+                for (size_t i = 0; i < n; i++) x[i] = id##IntKernel(x[i], 0); \
+                return;
+#include "ciLispOperators.def"
+#undef OPER
+            default:
+                return;
+        }
+    }
+
+    batchToDouble(batch, a);
+    double *x = a->data.dval;
+
+    if (operSpecs[oper].result == PREDICATE_RESULT)
+    {
+        long *r = a->data.ival;
+
+        switch (oper)
+        {
+#define OPER(id, ...) \
+            case id##_OPER: \
+                for (size_t i = 0; i < n; i++) r[i] = (long) id##DoubleKernel(x[i], 0); \
+                break;
+#include "ciLispOperators.def"
+#undef OPER
+            default:
+                break;
+        }
+
+        a->type = INT_TYPE;
+        return;
+    }
+
+    switch (oper)
+    {
+#define OPER(id, ...) \
+        case id##_OPER: \
+            for (size_t i = 0; i < n; i++) x[i] = id##DoubleKernel(x[i], 0); \
+            break;
+#include "ciLispOperators.def"
+#undef OPER
+        default:
+            break;
+    }
+}
+
+// a = a (oper) b, following the INT/DOUBLE rules of the operator. Returns false for int division by zero
+// (0 to a negative power included).
+static bool batchBinary(BATCH *batch, OPER_TYPE oper, BATCH_VECTOR *a, BATCH_VECTOR *b)
+{
+    size_t n = batch->rowCount;
+
+    if (a->type == INT_TYPE && b->type == INT_TYPE && operSpecs[oper].result != DOUBLE_RESULT)
+    {
+        long *x = a->data.ival;
+        long *y = b->data.ival;
+
+        // zero only: the kernels give LONG_MIN / -1 and LONG_MIN % -1 without trapping
+        if (oper == DIV_OPER || oper == REMAINDER_OPER)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                if (y[i] == 0)
+                    return false;
+            }
+        }
+        else if (oper == POW_OPER)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                if (x[i] == 0 && y[i] < 0)
+                    return false;
+            }
+        }
+
+        switch (oper)
+        {
+#define OPER(id, ...) \
+            case id##_OPER: \
+                for (size_t i = 0; i < n; i++) x[i] = id##IntKernel(x[i], y[i]); \
+                return true;
+#include "ciLispOperators.def"
+#undef OPER
+            default:
+                return true;
+        }
+    }
+
+    batchToDouble(batch, a);
+    batchToDouble(batch, b);
+    double *x = a->data.dval;
+    double *y = b->data.dval;
+
+    if (operSpecs[oper].result == PREDICATE_RESULT)
+    {
+        // comparisons give ints; the long results overwrite the doubles they were computed from in place
+        long *r = a->data.ival;
+
+        switch (oper)
+        {
+#define OPER(id, ...) \
+            case id##_OPER: \
+                for (size_t i = 0; i < n; i++) r[i] = (long) id##DoubleKernel(x[i], y[i]); \
+                break;
+#include "ciLispOperators.def"
+#undef OPER
+            default:
+                break;
+        }
+
+        a->type = INT_TYPE;
+        return true;
+    }
+
+    switch (oper)
+    {
+#define OPER(id, ...) \
+        case id##_OPER: \
+            for (size_t i = 0; i < n; i++) x[i] = id##DoubleKernel(x[i], y[i]); \
+            break;
+#include "ciLispOperators.def"
+#undef OPER
+        default:
+            break;
+    }
+
+    return true;
+}
+
+// Every pair is compared over the whole chunk. That gives the same 0 or 1 as stopping at the first pair that
+// fails, since vectorized operands have no side effects.
+static BATCH_VECTOR *batchChain(BATCH *batch, FUNC_AST_NODE *funcNode)
+{
+    BATCH_VECTOR *result = NULL;
+    BATCH_VECTOR *a = batchEval(batch, funcNode->opList);
+
+    for (AST_NODE *currOp = funcNode->opList->next; a != NULL && currOp != NULL; currOp = currOp->next)
+    {
+        BATCH_VECTOR *b = batchEval(batch, currOp);
+        // b is the left operand of the next pair, batchBinary() may convert it
+        BATCH_VECTOR *next = (b != NULL) ? batchCopy(batch, b) : NULL;
+
+        if (next == NULL || !batchBinary(batch, funcNode->oper, a, b))
+        {
+            free(a);
+            free(b);
+            free(next);
+            free(result);
+            return NULL;
+        }
+        free(b);
+
+        if (result == NULL)
+            result = a;
+        else
+        {
+            for (size_t i = 0; i < batch->rowCount; i++)
+                result->data.ival[i] &= a->data.ival[i];
+            free(a);
+        }
+        a = next;
+    }
+
+    free(a);
+    return result;
+}
+
+// and/or over whole chunks: all operands are evaluated for every row, for the same reason as in batchChain()
+static BATCH_VECTOR *batchLazy(BATCH *batch, FUNC_AST_NODE *funcNode)
+{
+    BATCH_VECTOR *result = NULL;
+
+    for (AST_NODE *currOp = funcNode->opList; currOp != NULL; currOp = currOp->next)
+    {
+        BATCH_VECTOR *a = batchEval(batch, currOp);
+        if (a == NULL)
+        {
+            free(result);
+            return NULL;
+        }
+
+        // truth values, written over the operand in place
+        for (size_t i = 0; i < batch->rowCount; i++)
+            a->data.ival[i] = (a->type == INT_TYPE) ? a->data.ival[i] != 0 : a->data.dval[i] != 0;
+        a->type = INT_TYPE;
+
+        if (result == NULL)
+        {
+            result = a;
+            continue;
+        }
+
+        long *x = result->data.ival;
+        long *y = a->data.ival;
+        size_t n = batch->rowCount;
+
+        switch (funcNode->oper)
+        {
+#define OPER(id, ...) \
+            case id##_OPER: \
+                for (size_t i = 0; i < n; i++) x[i] = id##IntKernel(x[i], y[i]); \
+                break;
+#include "ciLispOperators.def"
+#undef OPER
+            default:
+                break;
+        }
+        free(a);
+    }
+
+    return result;
+}
+
+static BATCH_VECTOR *batchFunc(BATCH *batch, AST_NODE *node)
+{
+    FUNC_AST_NODE *funcNode = &node->data.function;
+    int count = 0;
+
+    for (AST_NODE *currOp = funcNode->opList; currOp != NULL; currOp = currOp->next)
+        count++;
+
+    if (funcNode->oper == RAND_OPER)
+        return batchRand(batch, node);
+
+    // side effects have to happen row by row, in order
+    if (funcNode->oper == CUSTOM_OPER || operSpecs[funcNode->oper].arity == SPECIAL_ARITY || !operSpecs[funcNode->oper].pure)
+        return NULL;
+
+    // arity problems are reported by the row by row path
+    switch (operSpecs[funcNode->oper].arity)
+    {
+        case UNARY_ARITY:
+        {
+            if (count != 1)
+                return NULL;
+
+            BATCH_VECTOR *a = batchEval(batch, funcNode->opList);
+            if (a != NULL)
+                batchUnary(batch, funcNode->oper, a);
+            return a;
+        }
+
+        case CHAIN_ARITY:
+            return (count < 2) ? NULL : batchChain(batch, funcNode);
+
+        case LAZY_ARITY:
+            return (count < 1) ? NULL : batchLazy(batch, funcNode);
+
+        default:
+        {
+            if (count < 2 || (operSpecs[funcNode->oper].arity == BINARY_ARITY && count != 2))
+                return NULL;
+
+            BATCH_VECTOR *a = batchEval(batch, funcNode->opList);
+            for (AST_NODE *currOp = funcNode->opList->next; a != NULL && currOp != NULL; currOp = currOp->next)
+            {
+                BATCH_VECTOR *b = batchEval(batch, currOp);
+                if (b == NULL || !batchBinary(batch, funcNode->oper, a, b))
+                {
+                    free(a);
+                    a = NULL;
+                }
+                free(b);
+            }
+            return a;
+        }
+    }
+}
+
+// Both branches are evaluated over the whole chunk and merged by the condition.
+// This is only safe because every vectorized node is free of side effects.
+static BATCH_VECTOR *batchCond(BATCH *batch, COND_AST_NODE *condAstNode)
+{
+    BATCH_VECTOR *cond = batchEval(batch, condAstNode->condNode);
+    BATCH_VECTOR *truth = NULL;
+    BATCH_VECTOR *falsity = NULL;
+    size_t trueCount = 0;
+
+    if (cond == NULL)
+        return NULL;
+
+    for (size_t i = 0; i < batch->rowCount; i++)
+    {
+        bool isTrue = (cond->type == INT_TYPE) ? cond->data.ival[i] != 0 : cond->data.dval[i] != 0;
+        cond->data.ival[i] = isTrue; // reuse the condition as a mask
+        trueCount += isTrue;
+    }
+
+    if (trueCount > 0)
+        truth = batchEval(batch, condAstNode->trueNode);
+    if (trueCount < batch->rowCount)
+        falsity = batchEval(batch, condAstNode->falseNode);
+
+    BATCH_VECTOR *result = NULL;
+
+    if (trueCount == batch->rowCount)
+    {
+        result = truth;
+        truth = NULL;
+    }
+    else if (trueCount == 0)
+    {
+        result = falsity;
+        falsity = NULL;
+    }
+    else if (truth != NULL && falsity != NULL && truth->type == falsity->type)
+    {
+        // rows of one chunk would end up with different types otherwise
+        for (size_t i = 0; i < batch->rowCount; i++)
+        {
+            if (cond->data.ival[i])
+                falsity->data.ival[i] = truth->data.ival[i]; // copies the bits, works for both types
+        }
+        result = falsity;
+        falsity = NULL;
+    }
+
+    free(cond);
+    free(truth);
+    free(falsity);
+    return result;
+}
+
+// Returns NULL when the node cannot be evaluated column-wise; the caller then falls back to eval().
+static BATCH_VECTOR *batchEval(BATCH *batch, AST_NODE *node)
+{
+    if (node == NULL)
+        return NULL;
+
+    switch (node->type)
+    {
+        case NUM_NODE_TYPE:
+            return batchBroadcast(batch, node->data.number);
+        case SYMBOL_NODE_TYPE:
+            return batchSymbol(batch, node);
+        case FUNC_NODE_TYPE:
+            return batchFunc(batch, node);
+        case COND_NODE_TYPE:
+            return batchCond(batch, &node->data.condition);
+        default:
+            return NULL;
+    }
+}
+
+static void batchChunk(BATCH *batch, AST_NODE *root, RET_VAL *results)
+{
+    BATCH_VECTOR *vector = batchEval(batch, root);
+
+    while (batch->memos != NULL)
+    {
+        BATCH_MEMO *memo = batch->memos;
+        batch->memos = memo->next;
+        free(memo->vector);
+        free(memo);
+    }
+
+    if (vector != NULL)
+    {
+        for (size_t i = 0; i < batch->rowCount; i++)
+        {
+            results[i].type = vector->type;
+            if (vector->type == INT_TYPE)
+                results[i].value.ival = vector->data.ival[i];
+            else
+                results[i].value.dval = vector->data.dval[i];
+        }
+
+        free(vector);
+        return;
+    }
+
+    // row by row: the columns become the context's bound inputs for each evaluation
+    for (size_t i = 0; i < batch->rowCount; i++)
+    {
+        for (int c = 0; c < batch->columnCount; c++)
+            bindInput(batch->ctx, batch->names[c], batch->columns[c][i]);
+
+        results[i] = evalForm(batch->ctx, root);
+    }
+}
+
+void evalBatch(CILISP_CONTEXT *ctx, AST_NODE *root, int columnCount, char **names, RET_VAL **columns,
+               size_t rowCount, RET_VAL *results)
+{
+    RET_VAL *chunkColumns[columnCount > 0 ? columnCount : 1];
+    BATCH batch = {ctx, columnCount, names, chunkColumns, 0, NULL};
+
+    for (size_t first = 0; first < rowCount; first += BATCH_CHUNK)
+    {
+        batch.rowCount = (rowCount - first < BATCH_CHUNK) ? rowCount - first : BATCH_CHUNK;
+        for (int c = 0; c < columnCount; c++)
+            chunkColumns[c] = columns[c] + first;
+
+        batchChunk(&batch, root, results + first);
+    }
+}
+
+static void batchWrite(CILISP_CONTEXT *ctx, RET_VAL *results, size_t rowCount, bool binary)
+{
+    if (ctx->out == NULL)
+        return;
+
+    for (size_t i = 0; i < rowCount; i++)
+    {
+        if (binary)
+        {
+            double value = (results[i].type == INT_TYPE) ? (double) results[i].value.ival : results[i].value.dval;
+            bufferWrite(&ctx->output, &value, sizeof(double));
+            continue;
+        }
+
+        if (results[i].type == INT_TYPE)
+            bufferLong(&ctx->output, results[i].value.ival);
+        else
+            bufferDouble(&ctx->output, results[i].value.dval);
+        bufferWrite(&ctx->output, "\n", 1);
+    }
+
+    // one write per chunk
+    outputFlush(ctx);
+}
+
+// A CSV cell takes the type a number literal would get: doubles have a '.' (or an exponent, nan, inf)
+static RET_VAL batchParseCell(char *cell)
+{
+    char *end;
+
+    while (*cell == ' ' || *cell == '\t')
+        cell++;
+
+    if (strpbrk(cell, ".eEnN") != NULL)
+        return (RET_VAL) {DOUBLE_TYPE, {strtod(cell, &end)}};
+
+    RET_VAL val = {INT_TYPE};
+    val.value.ival = strtol(cell, &end, 10);
+    if (end == cell)
+        return (RET_VAL) {DOUBLE_TYPE, NAN}; // empty or not a number
+    return val;
+}
+
+static RET_VAL **batchColumns(int columnCount)
+{
+    RET_VAL **columns = calloc(sizeof(RET_VAL *), columnCount > 0 ? columnCount : 1);
+
+    for (int c = 0; columns != NULL && c < columnCount; c++)
+    {
+        if ((columns[c] = malloc(BATCH_CHUNK * sizeof(RET_VAL))) == NULL)
+        {
+            ciLispError(NULL, "Memory allocation failed!");
+            exit(1);
+        }
+    }
+
+    return columns;
+}
+
+static void batchFreeColumns(RET_VAL **columns, int columnCount)
+{
+    for (int c = 0; c < columnCount; c++)
+        free(columns[c]);
+    free(columns);
+}
+
+long evalBatchCsv(CILISP_CONTEXT *ctx, AST_NODE *root, FILE *csv, bool binary)
+{
+    char *line = NULL;
+    size_t lineSize = 0;
+    char **names = NULL;
+    int columnCount = 0;
+    long rowCount = 0;
+
+    if (getline(&line, &lineSize, csv) == -1)
+    {
+        free(line);
+        ciLispError(ctx, "Batch input has no header row");
+        return -1;
+    }
+
+    for (char *save, *name = strtok_r(line, ",\r\n", &save); name != NULL; name = strtok_r(NULL, ",\r\n", &save))
+    {
+        while (*name == ' ' || *name == '\t')
+            name++;
+        name[strcspn(name, " \t")] = '\0';
+
+        names = realloc(names, (columnCount + 1) * sizeof(char *));
+        names[columnCount++] = strdup(name);
+    }
+
+    RET_VAL **columns = batchColumns(columnCount);
+    RET_VAL results[BATCH_CHUNK];
+    size_t filled = 0;
+
+    while (rowCount >= 0 && getline(&line, &lineSize, csv) != -1)
+    {
+        if (strspn(line, " \t\r\n") == strlen(line))
+            continue; // blank line
+
+        int c = 0;
+        for (char *save, *cell = strtok_r(line, ",\r\n", &save); cell != NULL; cell = strtok_r(NULL, ",\r\n", &save))
+        {
+            if (c < columnCount)
+                columns[c][filled] = batchParseCell(cell);
+            c++;
+        }
+
+        if (c != columnCount)
+        {
+            char message[ERROR_BUFFER];
+            snprintf(message, ERROR_BUFFER, "Batch row %ld has %d values, the header names %d", rowCount + 1, c, columnCount);
+            ciLispError(ctx, message);
+            rowCount = -1;
+            break;
+        }
+
+        rowCount++;
+        if (++filled == BATCH_CHUNK)
+        {
+            evalBatch(ctx, root, columnCount, names, columns, filled, results);
+            batchWrite(ctx, results, filled, binary);
+            filled = 0;
+        }
+    }
+
+    if (rowCount >= 0 && filled > 0)
+    {
+        evalBatch(ctx, root, columnCount, names, columns, filled, results);
+        batchWrite(ctx, results, filled, binary);
+    }
+
+    batchFreeColumns(columns, columnCount);
+    for (int c = 0; c < columnCount; c++)
+        free(names[c]);
+    free(names);
+    free(line);
+
+    return rowCount;
+}
+
+long evalBatchColumns(CILISP_CONTEXT *ctx, AST_NODE *root, int columnCount, char **names, FILE **files, bool binary)
+{
+    RET_VAL **columns = batchColumns(columnCount);
+    RET_VAL results[BATCH_CHUNK];
+    double values[BATCH_CHUNK];
+    long rowCount = 0;
+
+    for (;;)
+    {
+        size_t filled = BATCH_CHUNK;
+
+        for (int c = 0; c < columnCount; c++)
+        {
+            size_t count = fread(values, sizeof(double), BATCH_CHUNK, files[c]);
+            if (c > 0 && count != filled)
+            {
+                ciLispError(ctx, "Batch columns have different lengths");
+                batchFreeColumns(columns, columnCount);
+                return -1;
+            }
+
+            filled = count;
+            for (size_t i = 0; i < count; i++)
+                columns[c][i] = (RET_VAL) {DOUBLE_TYPE, {values[i]}};
+        }
+
+        // without any column there is nothing to run over
+        if (columnCount == 0 || filled == 0)
+            break;
+
+        evalBatch(ctx, root, columnCount, names, columns, filled, results);
+        batchWrite(ctx, results, filled, binary);
+        rowCount += filled;
+
+        if (filled < BATCH_CHUNK)
+            break;
+    }
+
+    batchFreeColumns(columns, columnCount);
+    return rowCount;
+}
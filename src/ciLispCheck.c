@@ -0,0 +1,279 @@
+#include "ciLisp.h"
+
+// Static checks of a parsed tree, run once before it is evaluated or translated.
+// The evaluator only finds arity problems and undefined names when it gets to them, after all the work in
+// front of them is done (and then carries on with defaults: nan, or 1 for a missing lambda parameter).
+// checkForm walks the whole tree instead and reports every problem it finds with ciLispError, so one run
+// lists all of them. Symbols are resolved the same way evalSymbolNode() and helperCustomOper() do.
+
+typedef struct {
+    CILISP_CONTEXT *ctx;
+    bool freeSymbols; // unresolved symbols are inputs bound later
+    int errors;
+} CHECK;
+
+static void checkError(CHECK *check, const char *format, ...)
+{
+    char message[ERROR_BUFFER];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(message, ERROR_BUFFER, format, args);
+    va_end(args);
+
+    ciLispError(check->ctx, message);
+    check->errors++;
+}
+
+// the let variable or argument ident stands for at node, as evalSymbolNode() would find it
+static bool checkResolveVariable(AST_NODE *node, const char *ident, SYMBOL_TABLE_NODE **variable)
+{
+    *variable = NULL;
+
+    for (; node != NULL; node = node->parent)
+    {
+        if ((*variable = findInScope(node, ident, VARIABLE_TYPE)) != NULL)
+            return true;
+
+        for (ARG_TABLE_NODE *currArg = node->argTable; currArg != NULL; currArg = currArg->next)
+        {
+            if (!strcmp(ident, currArg->ident))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+static bool checkIsInput(CHECK *check, const char *ident)
+{
+    for (INPUT_BINDING *currInput = check->ctx->inputs; currInput != NULL; currInput = currInput->next)
+    {
+        if (!strcmp(ident, currInput->ident))
+            return true;
+    }
+
+    return check->freeSymbols;
+}
+
+NUM_TYPE inferType(AST_NODE *node)
+{
+    if (node == NULL)
+        return NO_TYPE;
+
+    switch (node->type)
+    {
+        case NUM_NODE_TYPE:
+            return node->data.number.type;
+
+        case SYMBOL_NODE_TYPE:
+        {
+            SYMBOL_TABLE_NODE *variable;
+            if (checkResolveVariable(node, node->data.symbol.ident, &variable) && variable != NULL)
+                return variable->val_type;
+            return NO_TYPE;
+        }
+
+        case FUNC_NODE_TYPE:
+        {
+            OPER_TYPE oper = node->data.function.oper;
+
+            if (oper == CUSTOM_OPER)
+                return NO_TYPE;
+
+            switch (operSpecs[oper].result)
+            {
+                case DOUBLE_RESULT:
+                    return DOUBLE_TYPE;
+                case PREDICATE_RESULT:
+                    return INT_TYPE;
+                case SAME_RESULT:
+                    break;
+            }
+
+            if (operSpecs[oper].arity == SPECIAL_ARITY || node->data.function.opList == NULL)
+                return NO_TYPE;
+
+            // int only when every operand is
+            NUM_TYPE type = INT_TYPE;
+            for (AST_NODE *currOp = node->data.function.opList; currOp != NULL; currOp = currOp->next)
+            {
+                NUM_TYPE opType = inferType(currOp);
+                if (opType == DOUBLE_TYPE)
+                    return DOUBLE_TYPE;
+                if (opType == NO_TYPE)
+                    type = NO_TYPE;
+            }
+            return type;
+        }
+
+        case COND_NODE_TYPE:
+        {
+            NUM_TYPE type = inferType(node->data.condition.trueNode);
+            return (type == inferType(node->data.condition.falseNode)) ? type : NO_TYPE;
+        }
+
+        default:
+            return NO_TYPE;
+    }
+}
+
+// the value of an int variable is rounded every time it is evaluated, worth a warning but not an error
+static void checkCast(CHECK *check, NUM_TYPE declared, const char *ident, AST_NODE *value)
+{
+    if (declared == INT_TYPE && inferType(value) == DOUBLE_TYPE)
+        outputPrintf(check->ctx, "WARNING: \"%s\" is declared int but is given a double, it will be rounded\n", ident);
+}
+
+static void checkNode(CHECK *check, AST_NODE *node);
+
+static void checkList(CHECK *check, AST_NODE *list)
+{
+    for (AST_NODE *currNode = list; currNode != NULL; currNode = currNode->next)
+        checkNode(check, currNode);
+}
+
+static void checkBuiltin(CHECK *check, FUNC_AST_NODE *funcNode)
+{
+    char *name = funcNames[funcNode->oper];
+    int count = 0;
+
+    for (AST_NODE *currOp = funcNode->opList; currOp != NULL; currOp = currOp->next)
+        count++;
+
+    int least = 1;
+    int most = -1; // no limit
+    switch (operSpecs[funcNode->oper].arity)
+    {
+        case UNARY_ARITY:
+            most = 1;
+            break;
+        case BINARY_ARITY:
+            least = most = 2;
+            break;
+        case FOLD_ARITY:
+        case CHAIN_ARITY:
+            least = 2;
+            break;
+        case LAZY_ARITY:
+            break;
+        case SPECIAL_ARITY:
+            // print shows its operands, read and rand take none
+            if (funcNode->oper != PRINT_OPER)
+                least = most = 0;
+            break;
+    }
+
+    if (count < least)
+        checkError(check, "Too few parameters for the function \"%s\": %d given, %s%d expected.",
+                   name, count, most == least ? "" : "at least ", least);
+    else if (most >= 0 && count > most)
+        checkError(check, "Too many parameters for the function \"%s\": %d given, %s%d expected.",
+                   name, count, most == least ? "" : "at most ", most);
+}
+
+static void checkCustom(CHECK *check, AST_NODE *node)
+{
+    char *ident = node->data.function.ident;
+    SYMBOL_TABLE_NODE *lambda = NULL;
+
+    for (AST_NODE *currNode = node; currNode != NULL && lambda == NULL; currNode = currNode->parent)
+        lambda = findInScope(currNode, ident, LAMBDA_TYPE);
+
+    if (lambda == NULL)
+    {
+        checkError(check, "Undefined function \"%s\".", ident);
+        return;
+    }
+
+    int expected = 0;
+    int count = 0;
+
+    for (ARG_TABLE_NODE *currArg = lambda->val->argTable; currArg != NULL; currArg = currArg->next)
+        expected++;
+    for (AST_NODE *currOp = node->data.function.opList; currOp != NULL; currOp = currOp->next)
+        count++;
+
+    if (count == 0)
+        checkError(check, "No parameters entered for lambda function \"%s\".", ident);
+    else if (count < expected)
+        checkError(check, "Too few parameters for lambda function \"%s\": %d given, %d expected.", ident, count, expected);
+    else if (count > expected)
+        checkError(check, "Too many parameters for lambda function \"%s\": %d given, %d expected.", ident, count, expected);
+}
+
+static void checkNode(CHECK *check, AST_NODE *node)
+{
+    if (node == NULL)
+        return;
+
+    // definitions of a let block, lambda bodies included, whether they are used or not
+    for (SYMBOL_TABLE_NODE *symbol = node->symbolTable; symbol != NULL; symbol = symbol->next)
+    {
+        checkNode(check, symbol->val);
+        if (symbol->sym_type == VARIABLE_TYPE)
+            checkCast(check, symbol->val_type, symbol->ident, symbol->val);
+    }
+
+    switch (node->type)
+    {
+        case NUM_NODE_TYPE:
+            break;
+
+        case SYMBOL_NODE_TYPE:
+        {
+            SYMBOL_TABLE_NODE *variable;
+            char *ident = node->data.symbol.ident;
+            if (!checkResolveVariable(node, ident, &variable) && !checkIsInput(check, ident))
+                checkError(check, "Unbound symbol \"%s\".", ident);
+            break;
+        }
+
+        case FUNC_NODE_TYPE:
+            if (node->data.function.oper == CUSTOM_OPER)
+                checkCustom(check, node);
+            else
+                checkBuiltin(check, &node->data.function);
+            checkList(check, node->data.function.opList);
+            break;
+
+        case COND_NODE_TYPE:
+            checkNode(check, node->data.condition.condNode);
+            checkNode(check, node->data.condition.trueNode);
+            checkNode(check, node->data.condition.falseNode);
+            break;
+
+        case PROGN_NODE_TYPE:
+            checkList(check, node->data.sequence.body);
+            break;
+
+        case WHILE_NODE_TYPE:
+        case FOR_NODE_TYPE:
+            checkNode(check, node->data.loop.condNode);
+            checkNode(check, node->data.loop.startNode);
+            checkNode(check, node->data.loop.endNode);
+            checkList(check, node->data.loop.body);
+            break;
+
+        case SET_NODE_TYPE:
+        {
+            SYMBOL_TABLE_NODE *variable;
+            char *ident = node->data.assignment.ident;
+            if (!checkResolveVariable(node, ident, &variable))
+                checkError(check, "set: \"%s\" is not a let variable or an argument", ident);
+            else if (variable != NULL)
+                checkCast(check, variable->val_type, ident, node->data.assignment.valueNode);
+            checkNode(check, node->data.assignment.valueNode);
+            break;
+        }
+    }
+}
+
+int checkForm(CILISP_CONTEXT *ctx, AST_NODE *root, bool freeSymbols)
+{
+    CHECK check = {ctx, freeSymbols, 0};
+
+    checkNode(&check, root);
+
+    return check.errors;
+}
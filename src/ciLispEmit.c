@@ -0,0 +1,889 @@
+#include <inttypes.h>
+#include "ciLisp.h"
+
+// C backend for "cilisp --emit-c".
+// Every top level s-expression is translated into a standalone C translation unit instead of being evaluated.
+// Each AST node becomes a small static function in the generated code, so the order operands are evaluated
+// in (and therefore the order of read and print side effects) is the same as it is in eval().
+// Lambda arguments become file scope variables that are assigned right before the body is called,
+// the same way bindArguments() writes the evaluated parameters into the lambda's argTable.
+//
+// The generated file builds with any C11 compiler:
+//      cc -O2 program.c -o program -lm                             (native binary, read values come from argv)
+//      cc -O2 -shared -fPIC -DCILISP_NO_MAIN program.c -o program.so -lm   (call cilisp_eval() from a service)
+
+// How many operands a builtin evaluates: the arity of ciLispOperators.def, special operators split up.
+typedef enum {
+    EMIT_UNARY,
+    EMIT_BINARY,
+    EMIT_FOLD,
+    EMIT_CHAIN,
+    EMIT_LAZY,
+    EMIT_PRINT,
+    EMIT_MEMO       // read and rand (the interpreter remembers their value for the rest of an evaluation)
+} EMIT_ARITY;
+
+// Every AST node and lambda argument of the current tree that has been emitted, with its generated identifier,
+// in an open addressing table keyed by address (a NULL key is a free slot).
+// Identifiers keep counting up across top level s-expressions so generated names never collide.
+typedef struct {
+    void *key;
+    int id;
+} EMITTED_NODE;
+
+// State of one translation, owned by the context that is emitting.
+struct emitter {
+    CILISP_CONTEXT *ctx;
+    FILE *out;
+    bool failed; // out of memory: nothing more is translated and emitEnd writes nothing
+
+    // Declarations and definitions are collected separately so node functions can call each other
+    // (recursive lambdas) regardless of the order they were emitted in.
+    FILE *decls;
+    FILE *defs;
+    char *declBuffer;
+    char *defBuffer;
+    size_t declSize;
+    size_t defSize;
+
+    // Body of the node function currently being written. Nested nodes get their own body.
+    FILE *body;
+
+    EMITTED_NODE *emitted;
+    size_t emittedMask;
+    size_t emittedCount;
+    int nextId;
+
+    // Root node id of each top level s-expression, in input order.
+    int *forms;
+    int formCount;
+    int formCapacity;
+};
+
+static const char *emitPrelude[] = {
+        "/* Generated by cilisp --emit-c. */",
+        "#include <ctype.h>",
+        "#include <stdbool.h>",
+        "#include <stdint.h>",
+        "#include <stdio.h>",
+        "#include <stdlib.h>",
+        "#include <string.h>",
+        "#include <math.h>",
+        "#include <limits.h>",
+        "",
+        "#define BUFFER_DOUBLE 0.000001",
+        "",
+        "typedef enum { CL_INT_TYPE, CL_DOUBLE_TYPE } cilisp_type;",
+        "",
+        "typedef struct {",
+        "    cilisp_type type;",
+        "    union {",
+        "        double dval;",
+        "        long ival;",
+        "    } value;",
+        "} cilisp_value;",
+        "",
+        "typedef struct {",
+        "    uint64_t s[4];",
+        "} RANDOM_STATE;",
+        "",
+        NULL
+};
+
+// The rest of the runtime, after the settings of the run that generated the file (see emitEnd)
+static const char *emitRuntime[] = {
+        "/* values handed to read, in order; read falls back to stdin once they run out */",
+        "static int cl_input_count = 0;",
+        "static char **cl_inputs = NULL;",
+        "static int cl_input_index = 0;",
+        "",
+        "/* bumped by every run so memoized read and rand nodes are drawn again */",
+        "static unsigned cl_generation = 0;",
+        "",
+        "static inline cilisp_value cl_int(long v) { cilisp_value r; r.type = CL_INT_TYPE; r.value.ival = v; return r; }",
+        "static inline cilisp_value cl_dbl(double v) { cilisp_value r; r.type = CL_DOUBLE_TYPE; r.value.dval = v; return r; }",
+        "static inline cilisp_value cl_nan(void) { return cl_dbl(NAN); }",
+        "static inline double cl_d(cilisp_value v) { return v.type == CL_INT_TYPE ? (double) v.value.ival : v.value.dval; }",
+        "static inline int cl_both_int(cilisp_value a, cilisp_value b) { return a.type == CL_INT_TYPE && b.type == CL_INT_TYPE; }",
+        "static inline int cl_truthy(cilisp_value v) { return v.type == CL_INT_TYPE ? v.value.ival != 0 : v.value.dval != 0; }",
+        "",
+        "static inline void cl_err(const char *s) { fprintf(stderr, \"\\nERROR: %s\\n\", s); }",
+        "",
+        "/* same as powInt() in ciLisp.h */",
+        "static inline long powInt(long a, long b)",
+        "{",
+        "    long result = 1;",
+        "    int negative = a < 0 && (b & 1);",
+        "",
+        "    if (b < 0)",
+        "        return (a == 1 || a == -1) ? (negative ? -1 : 1) : 0;",
+        "",
+        "    for (;;)",
+        "    {",
+        "        if ((b & 1) && __builtin_mul_overflow(result, a, &result))",
+        "            return negative ? LONG_MIN : LONG_MAX;",
+        "        if ((b >>= 1) == 0)",
+        "            return result;",
+        "        if (__builtin_mul_overflow(a, a, &a))",
+        "            return negative ? LONG_MIN : LONG_MAX;",
+        "    }",
+        "}",
+        "",
+        "/* same output as helperPrintOper() */",
+        "static inline cilisp_value cl_print(const cilisp_value *ops, int count)",
+        "{",
+        "    printf(\"print:\");",
+        "    for (int i = 0; i < count; i++)",
+        "    {",
+        "        if (ops[i].type == CL_INT_TYPE)",
+        "            printf(\" %ld,\", ops[i].value.ival);",
+        "        else",
+        "            printf(\" %.2lf,\", ops[i].value.dval);",
+        "    }",
+        "    printf(\"\\n\");",
+        "    if (count > 1)",
+        "        printf(\"WARNING: only the last item in this list is returned.\\n\");",
+        "    return ops[count - 1];",
+        "}",
+        "",
+        "/* same token rule and messages as helperReadOper(); values come from the inputs first, then from stdin */",
+        "static inline cilisp_value cl_read(void)",
+        "{",
+        "    char token[CL_READ_TOKEN];",
+        "    const char *text = token;",
+        "    size_t length = 0;",
+        "    int c;",
+        "",
+        "    if (cl_input_index < cl_input_count)",
+        "    {",
+        "        text = cl_inputs[cl_input_index++];",
+        "        length = strlen(text);",
+        "    }",
+        "    else",
+        "    {",
+        "        if (!cl_quiet)",
+        "        {",
+        "            printf(\"read := \");",
+        "            fflush(stdout);",
+        "        }",
+        "        while ((c = getchar()) != EOF && isspace(c))",
+        "            ;",
+        "        if (c == EOF)",
+        "        {",
+        "            cl_err(\"End of input for read\\n\");",
+        "            return cl_nan();",
+        "        }",
+        "        for (; c != EOF && !isspace(c); c = getchar(), length++)",
+        "        {",
+        "            if (length < CL_READ_TOKEN - 1)",
+        "                token[length] = (char) c;",
+        "        }",
+        "        if (length > CL_READ_TOKEN - 1)",
+        "            length = 0; /* too long, fails the check */",
+        "        token[length] = '\\0';",
+        "    }",
+        "",
+        "    if (!readCheck(text, length))",
+        "    {",
+        "        cl_err(\"Invalid input for a number entered\\n\");",
+        "        return cl_nan();",
+        "    }",
+        "",
+        "    return strchr(text, '.') != NULL ? cl_dbl(strtod(text, NULL)) : cl_int(strtol(text, NULL, 10));",
+        "}",
+        "",
+        "static inline cilisp_value cl_rand(void) { return cl_dbl(randomDouble(&cl_random)); }",
+        "",
+        "/* restarts rand like cilisp --seed N does */",
+        "void cilisp_seed(uint64_t seed)",
+        "{",
+        "    randomSeed(&cl_random, seed);",
+        "}",
+        "",
+        "/* type cast of a let variable, same as evalSymbolNodeHelper() (castType: 0 int, 1 double, 2 none) */",
+        "static inline cilisp_value cl_cast(cilisp_value v, int castType, const char *ident)",
+        "{",
+        "    if (castType == 0 && v.type == CL_DOUBLE_TYPE)",
+        "    {",
+        "        printf(\"WARNING: precision loss in the assignment for variable \\\"%s\\\"\\n\", ident);",
+        "        return cl_int(lround(v.value.dval));",
+        "    }",
+        "    if (castType == 1 && v.type == CL_INT_TYPE)",
+        "        return cl_dbl((double) v.value.ival);",
+        "    return v;",
+        "}",
+        "",
+        NULL
+};
+
+// readCheck() as source text, so read in the generated code takes the same tokens as the interpreter's
+#define EMIT_TEXT(...) #__VA_ARGS__
+#define EMIT_EXPANDED(...) EMIT_TEXT(__VA_ARGS__)
+static const char *emitReadCheck = EMIT_EXPANDED(READ_CHECK_FUNCTION(static inline));
+// and the generator behind rand
+static const char *emitRandom = EMIT_EXPANDED(RANDOM_FUNCTIONS(static inline, static inline));
+
+// The operator kernels as source text, the runtime of the generated code is built from the same lines
+// of ciLispOperators.def as the interpreter.
+static const struct {
+    const char *intKernel;
+    const char *doubleKernel;
+} emitKernels[] = {
+#define OPER(id, name, arity, result, pure, intKernel, doubleKernel) {#intKernel, #doubleKernel},
+#include "ciLispOperators.def"
+#undef OPER
+};
+
+// cl_<name>() for every operator that is not special, same INT/DOUBLE rules as operApply() in ciLisp.c
+static void emitOperators(FILE *out)
+{
+    for (int oper = 0; oper < OPER_COUNT; oper++)
+    {
+        const OPER_SPEC *spec = &operSpecs[oper];
+        char *name = funcNames[oper];
+
+        if (spec->arity == SPECIAL_ARITY)
+            continue;
+
+        fprintf(out, "static inline long cl_%s_int(long a, long b) { (void) a; (void) b; return %s; }\n",
+                name, emitKernels[oper].intKernel);
+        fprintf(out, "static inline double cl_%s_double(double a, double b) { (void) a; (void) b; return %s; }\n",
+                name, emitKernels[oper].doubleKernel);
+
+        if (spec->arity == UNARY_ARITY)
+            fprintf(out, "static inline cilisp_value cl_%s(cilisp_value a) { cilisp_value b = a; ", name);
+        else
+            fprintf(out, "static inline cilisp_value cl_%s(cilisp_value a, cilisp_value b) { ", name);
+
+        // same checks as operApply(), b == -1 is in the kernels
+        if (oper == DIV_OPER || oper == REMAINDER_OPER || oper == POW_OPER)
+            fprintf(out, "if (cl_both_int(a, b) && %s) { "
+                         "cl_err(\"Division by zero in the function \\\"%s\\\".\\n\"); return cl_nan(); } ",
+                    oper == POW_OPER ? "a.value.ival == 0 && b.value.ival < 0" : "b.value.ival == 0", name);
+
+        switch (spec->result)
+        {
+            case SAME_RESULT:
+                fprintf(out, "return cl_both_int(a, b) ? cl_int(cl_%s_int(a.value.ival, b.value.ival)) "
+                             ": cl_dbl(cl_%s_double(cl_d(a), cl_d(b))); }\n", name, name);
+                break;
+            case DOUBLE_RESULT:
+                fprintf(out, "return cl_dbl(cl_%s_double(cl_d(a), cl_d(b))); }\n", name);
+                break;
+            case PREDICATE_RESULT:
+                fprintf(out, "return cl_int(cl_both_int(a, b) ? cl_%s_int(a.value.ival, b.value.ival) "
+                             ": (long) cl_%s_double(cl_d(a), cl_d(b))); }\n", name, name);
+                break;
+        }
+    }
+
+    fprintf(out, "\n");
+}
+
+// FNV-1a over the bytes of the address, like the optimizer's pointer keys
+static size_t emitHash(void *key)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (uint64_t value = (uintptr_t) key, i = 0; i < 8; i++, value >>= 8)
+    {
+        hash ^= value & 0xff;
+        hash *= 0x100000001b3ULL;
+    }
+    return (size_t) (hash ^ (hash >> 32));
+}
+
+static bool emitTableGrow(EMITTER *e)
+{
+    size_t size = e->emitted ? (e->emittedMask + 1) * 2 : 64;
+    EMITTED_NODE *emitted = calloc(size, sizeof(EMITTED_NODE));
+
+    if (emitted == NULL)
+        return false;
+
+    for (size_t i = 0; e->emitted != NULL && i <= e->emittedMask; i++)
+    {
+        if (e->emitted[i].key == NULL)
+            continue;
+
+        size_t slot = emitHash(e->emitted[i].key) & (size - 1);
+        while (emitted[slot].key != NULL)
+            slot = (slot + 1) & (size - 1);
+        emitted[slot] = e->emitted[i];
+    }
+
+    free(e->emitted);
+    e->emitted = emitted;
+    e->emittedMask = size - 1;
+    return true;
+}
+
+// The id of key, a new one (isNew) when it was not emitted yet. When the table cannot grow the error is
+// reported, the emitter fails and key is treated as already emitted so nothing more gets written for it.
+static int emitLookup(EMITTER *e, void *key, bool *isNew)
+{
+    *isNew = false;
+
+    if (e->failed)
+        return e->nextId++;
+
+    if ((e->emitted == NULL || (e->emittedCount + 1) * 2 > e->emittedMask + 1) && !emitTableGrow(e))
+    {
+        ciLispError(e->ctx, "Memory allocation failed!");
+        e->failed = true;
+        return e->nextId++;
+    }
+
+    size_t slot = emitHash(key) & e->emittedMask;
+    for (; e->emitted[slot].key != NULL; slot = (slot + 1) & e->emittedMask)
+    {
+        if (e->emitted[slot].key == key)
+            return e->emitted[slot].id;
+    }
+
+    *isNew = true;
+    e->emittedCount++;
+    e->emitted[slot] = (EMITTED_NODE) {key, e->nextId};
+    return e->nextId++;
+}
+
+// Lambda arguments are shared by every call of the lambda, just like the ARG_TABLE_NODE argVal they mirror.
+static int emitArg(EMITTER *e, ARG_TABLE_NODE *arg)
+{
+    bool isNew;
+    int id = emitLookup(e, arg, &isNew);
+
+    if (isNew)
+        fprintf(e->decls, "static cilisp_value cl_arg_%d; /* %s */\n", id, arg->ident);
+
+    return id;
+}
+
+// A let variable can be given a new value by set for the rest of one run, like SYMBOL_TABLE_NODE assigned.
+static int emitVariable(EMITTER *e, SYMBOL_TABLE_NODE *symbol)
+{
+    bool isNew;
+    int id = emitLookup(e, symbol, &isNew);
+
+    if (isNew)
+        fprintf(e->decls, "static cilisp_value cl_var_%d; static unsigned cl_var_%d_generation; /* %s */\n",
+                id, id, symbol->ident);
+
+    return id;
+}
+
+// Same search as evalSymbolNode(), done once at translation time since the tree does not change.
+static void *emitResolveSymbol(AST_NODE *node, char *ident, bool *isArg)
+{
+    while (node != NULL)
+    {
+        SYMBOL_TABLE_NODE *currSymbol = findInScope(node, ident, VARIABLE_TYPE);
+        if (currSymbol != NULL)
+        {
+            *isArg = false;
+            return currSymbol;
+        }
+
+        for (ARG_TABLE_NODE *currArg = node->argTable; currArg != NULL; currArg = currArg->next)
+        {
+            if (!strcmp(ident, currArg->ident))
+            {
+                *isArg = true;
+                return currArg;
+            }
+        }
+
+        node = node->parent;
+    }
+
+    return NULL;
+}
+
+// Same search as helperCustomOper()
+static SYMBOL_TABLE_NODE *emitResolveLambda(AST_NODE *node, char *ident)
+{
+    while (node != NULL)
+    {
+        SYMBOL_TABLE_NODE *currSymbol = findInScope(node, ident, LAMBDA_TYPE);
+        if (currSymbol != NULL)
+            return currSymbol;
+
+        node = node->parent;
+    }
+
+    return NULL;
+}
+
+static EMIT_ARITY emitArity(OPER_TYPE oper)
+{
+    switch (operSpecs[oper].arity)
+    {
+        case FOLD_ARITY:
+            return EMIT_FOLD;
+        case BINARY_ARITY:
+            return EMIT_BINARY;
+        case CHAIN_ARITY:
+            return EMIT_CHAIN;
+        case LAZY_ARITY:
+            return EMIT_LAZY;
+        case UNARY_ARITY:
+            return EMIT_UNARY;
+        default:
+            return (oper == PRINT_OPER) ? EMIT_PRINT : EMIT_MEMO;
+    }
+}
+
+static int emitNode(EMITTER *e, AST_NODE *node);
+
+static void emitBuiltinBody(EMITTER *e, FUNC_AST_NODE *funcNode)
+{
+    char *name = funcNames[funcNode->oper];
+    int count = 0;
+    AST_NODE *currOp;
+
+    for (currOp = funcNode->opList; currOp != NULL; currOp = currOp->next)
+        count++;
+
+    // comparisons return an int 0 instead of nan when they are missing parameters
+    char *missing = (operSpecs[funcNode->oper].result == PREDICATE_RESULT) ? "cl_int(0)" : "cl_nan()";
+
+    switch (emitArity(funcNode->oper))
+    {
+        case EMIT_MEMO:
+            fprintf(e->body, "    static unsigned generation = 0;\n");
+            fprintf(e->body, "    static cilisp_value memo;\n");
+            // rand with --fresh-rand draws every time it is reached
+            fprintf(e->body, "    if (generation != cl_generation%s)\n    {\n",
+                    funcNode->oper == RAND_OPER ? " || cl_fresh_rand" : "");
+            fprintf(e->body, "        memo = cl_%s();\n", name);
+            fprintf(e->body, "        generation = cl_generation;\n    }\n");
+            fprintf(e->body, "    return memo;\n");
+            return;
+
+        case EMIT_PRINT:
+            if (count == 0)
+            {
+                fprintf(e->body, "    printf(\"Warning: This operation did not retrieve a number\\n\");\n");
+                fprintf(e->body, "    return cl_nan();\n");
+                return;
+            }
+            fprintf(e->body, "    cilisp_value ops[%d];\n", count);
+            count = 0;
+            for (currOp = funcNode->opList; currOp != NULL; currOp = currOp->next)
+                fprintf(e->body, "    ops[%d] = cl_node_%d();\n", count++, emitNode(e, currOp));
+            fprintf(e->body, "    return cl_print(ops, %d);\n", count);
+            return;
+
+        case EMIT_UNARY:
+            if (count == 0)
+            {
+                fprintf(e->body, "    return %s;\n", missing);
+                return;
+            }
+            fprintf(e->body, "    cilisp_value result = cl_%s(cl_node_%d());\n", name, emitNode(e, funcNode->opList));
+            if (count > 1)
+                fprintf(e->body, "    cl_err(\"Too many parameters for the function \\\"%s\\\".\");\n", name);
+            fprintf(e->body, "    return result;\n");
+            return;
+
+        case EMIT_CHAIN:
+            // same early exit as evalChainOper()
+            if (count < 2)
+            {
+                if (count == 1)
+                    fprintf(e->body, "    cl_err(\"Too few parameters for the function \\\"%s\\\".\");\n", name);
+                fprintf(e->body, "    return %s;\n", missing);
+                return;
+            }
+            currOp = funcNode->opList;
+            fprintf(e->body, "    cilisp_value a = cl_node_%d();\n", emitNode(e, currOp));
+            fprintf(e->body, "    cilisp_value b;\n");
+            for (currOp = currOp->next; currOp != NULL; currOp = currOp->next)
+            {
+                fprintf(e->body, "    b = cl_node_%d();\n", emitNode(e, currOp));
+                fprintf(e->body, "    if (!cl_%s(a, b).value.ival)\n        return cl_int(0);\n", name);
+                if (currOp->next != NULL)
+                    fprintf(e->body, "    a = b;\n");
+            }
+            fprintf(e->body, "    return cl_int(1);\n");
+            return;
+
+        case EMIT_LAZY:
+            // same early exit as evalLazyOper()
+            if (count == 0)
+            {
+                fprintf(e->body, "    return %s;\n", missing);
+                return;
+            }
+            currOp = funcNode->opList;
+            fprintf(e->body, "    long result = cl_truthy(cl_node_%d());\n", emitNode(e, currOp));
+            for (currOp = currOp->next; currOp != NULL; currOp = currOp->next)
+            {
+                fprintf(e->body, "    if (cl_%s_int(result, 0) == cl_%s_int(result, 1))\n        return cl_int(result);\n",
+                        name, name);
+                fprintf(e->body, "    result = cl_%s_int(result, cl_truthy(cl_node_%d()));\n", name, emitNode(e, currOp));
+            }
+            fprintf(e->body, "    return cl_int(result);\n");
+            return;
+
+        case EMIT_BINARY:
+        case EMIT_FOLD:
+            if (count < 2)
+            {
+                if (count == 1)
+                    fprintf(e->body, "    cl_err(\"Too few parameters for the function \\\"%s\\\".\");\n", name);
+                fprintf(e->body, "    return %s;\n", missing);
+                return;
+            }
+            currOp = funcNode->opList;
+            fprintf(e->body, "    cilisp_value result = cl_node_%d();\n", emitNode(e, currOp));
+            for (currOp = currOp->next; currOp != NULL; currOp = currOp->next)
+            {
+                fprintf(e->body, "    result = cl_%s(result, cl_node_%d());\n", name, emitNode(e, currOp));
+                if (emitArity(funcNode->oper) == EMIT_BINARY)
+                    break;
+            }
+            if (emitArity(funcNode->oper) == EMIT_BINARY && count > 2)
+                fprintf(e->body, "    cl_err(\"Too many parameters for the function \\\"%s\\\".\");\n", name);
+            fprintf(e->body, "    return result;\n");
+            return;
+    }
+}
+
+// Same parameter handling as bindArguments():
+// every parameter is evaluated before any argument is overwritten.
+static void emitCustomBody(EMITTER *e, AST_NODE *node)
+{
+    SYMBOL_TABLE_NODE *lambda = emitResolveLambda(node, node->data.function.ident);
+    AST_NODE *paramList = node->data.function.opList;
+
+    if (lambda == NULL)
+    {
+        fprintf(e->body, "    return cl_nan(); /* undefined function %s */\n", node->data.function.ident);
+        return;
+    }
+
+    if (paramList == NULL)
+    {
+        fprintf(e->body, "    cl_err(\"No parameters entered for lambda function\\n\");\n");
+        fprintf(e->body, "    return cl_nan();\n");
+        return;
+    }
+
+    int bodyId = emitNode(e, lambda->val);
+    int argCount = 0;
+    ARG_TABLE_NODE *currArg;
+    AST_NODE *currOp = paramList;
+
+    for (currArg = lambda->val->argTable; currArg != NULL; currArg = currArg->next)
+        argCount++;
+
+    fprintf(e->body, "    cilisp_value params[%d];\n", argCount ? argCount : 1);
+    argCount = 0;
+    for (currArg = lambda->val->argTable; currArg != NULL; currArg = currArg->next)
+    {
+        if (currOp != NULL)
+        {
+            fprintf(e->body, "    params[%d] = cl_node_%d();\n", argCount, emitNode(e, currOp));
+            currOp = currOp->next;
+        }
+        else
+        {
+            fprintf(e->body, "    params[%d] = cl_int(1); /* missing parameter defaults to 1 */\n", argCount);
+        }
+        argCount++;
+    }
+
+    if (currOp != NULL)
+        fprintf(e->body, "    cl_err(\"Too many parameters for lambda function.\");\n");
+
+    argCount = 0;
+    for (currArg = lambda->val->argTable; currArg != NULL; currArg = currArg->next)
+        fprintf(e->body, "    cl_arg_%d = params[%d];\n", emitArg(e, currArg), argCount++);
+
+    fprintf(e->body, "    return cl_node_%d(); /* %s */\n", bodyId, lambda->ident);
+}
+
+// Calls the node function of every s-expression of a body list in order, keeping the last value in result
+static void emitBody(EMITTER *e, AST_NODE *body, const char *indent)
+{
+    for (AST_NODE *currNode = body; currNode != NULL; currNode = currNode->next)
+        fprintf(e->body, "%sresult = cl_node_%d();\n", indent, emitNode(e, currNode));
+}
+
+// Emits the function for one node (and everything it reaches) and returns its id.
+// A node that was already e->emitted only returns its id.
+static int emitNode(EMITTER *e, AST_NODE *node)
+{
+    bool isNew;
+    int id = emitLookup(e, node, &isNew);
+
+    if (!isNew)
+        return id;
+
+    fprintf(e->decls, "static cilisp_value cl_node_%d(void);\n", id);
+
+    // children are e->emitted into their own functions while this body is being written
+    char *body = NULL;
+    size_t bodySize = 0;
+    FILE *outerBody = e->body;
+    e->body = open_memstream(&body, &bodySize);
+
+    switch (node->type)
+    {
+        case NUM_NODE_TYPE:
+            if (node->data.number.type == INT_TYPE)
+                fprintf(e->body, "    return cl_int(%ldL);\n", node->data.number.value.ival);
+            else
+                fprintf(e->body, "    return cl_dbl(%.17g);\n", node->data.number.value.dval);
+            break;
+
+        case FUNC_NODE_TYPE:
+            if (node->data.function.oper == CUSTOM_OPER)
+                emitCustomBody(e, node);
+            else
+                emitBuiltinBody(e, &node->data.function);
+            break;
+
+        case SYMBOL_NODE_TYPE:
+        {
+            bool isArg;
+            void *symbol = emitResolveSymbol(node, node->data.symbol.ident, &isArg);
+
+            if (symbol == NULL)
+                fprintf(e->body, "    return cl_nan(); /* undefined symbol %s */\n", node->data.symbol.ident);
+            else if (isArg)
+                fprintf(e->body, "    return cl_arg_%d;\n", emitArg(e, symbol));
+            else
+            {
+                int var = emitVariable(e, symbol);
+                fprintf(e->body, "    if (cl_var_%d_generation == cl_generation)\n        return cl_var_%d;\n", var, var);
+                fprintf(e->body, "    return cl_cast(cl_node_%d(), %d, \"%s\");\n",
+                        emitNode(e, ((SYMBOL_TABLE_NODE *) symbol)->val),
+                        ((SYMBOL_TABLE_NODE *) symbol)->val_type,
+                        ((SYMBOL_TABLE_NODE *) symbol)->ident);
+            }
+            break;
+        }
+
+        case COND_NODE_TYPE:
+            fprintf(e->body, "    if (cl_truthy(cl_node_%d()))\n", emitNode(e, node->data.condition.condNode));
+            fprintf(e->body, "        return cl_node_%d();\n", emitNode(e, node->data.condition.trueNode));
+            fprintf(e->body, "    return cl_node_%d();\n", emitNode(e, node->data.condition.falseNode));
+            break;
+
+        case PROGN_NODE_TYPE:
+            fprintf(e->body, "    cilisp_value result = cl_nan();\n");
+            emitBody(e, node->data.sequence.body, "    ");
+            fprintf(e->body, "    return result;\n");
+            break;
+
+        case WHILE_NODE_TYPE:
+            fprintf(e->body, "    cilisp_value result = cl_nan();\n");
+            fprintf(e->body, "    while (cl_truthy(cl_node_%d()))\n    {\n", emitNode(e, node->data.loop.condNode));
+            emitBody(e, node->data.loop.body, "        ");
+            fprintf(e->body, "    }\n    return result;\n");
+            break;
+
+        case FOR_NODE_TYPE:
+        {
+            // same counting as evalForNode(): an int counter when both bounds are ints
+            int counter = emitArg(e, node->argTable);
+            if (node->data.loop.startNode != NULL)
+                fprintf(e->body, "    cilisp_value start = cl_node_%d();\n", emitNode(e, node->data.loop.startNode));
+            else
+                fprintf(e->body, "    cilisp_value start = cl_int(0);\n");
+            fprintf(e->body, "    cilisp_value end = cl_node_%d();\n", emitNode(e, node->data.loop.endNode));
+            fprintf(e->body, "    cilisp_value result = cl_nan();\n");
+            fprintf(e->body, "    if (cl_both_int(start, end))\n    {\n");
+            fprintf(e->body, "        for (long i = start.value.ival; i < end.value.ival; i++)\n        {\n");
+            fprintf(e->body, "            cl_arg_%d = cl_int(i);\n", counter);
+            emitBody(e, node->data.loop.body, "            ");
+            fprintf(e->body, "        }\n        return result;\n    }\n");
+            fprintf(e->body, "    for (double d = cl_d(start); d < cl_d(end); d += 1)\n    {\n");
+            fprintf(e->body, "        cl_arg_%d = cl_dbl(d);\n", counter);
+            emitBody(e, node->data.loop.body, "        ");
+            fprintf(e->body, "    }\n    return result;\n");
+            break;
+        }
+
+        case SET_NODE_TYPE:
+        {
+            bool isArg;
+            void *symbol = emitResolveSymbol(node, node->data.assignment.ident, &isArg);
+            int value = emitNode(e, node->data.assignment.valueNode);
+
+            if (symbol == NULL)
+            {
+                fprintf(e->body, "    cl_err(\"set: \\\"%s\\\" is not a let variable or an argument\");\n",
+                        node->data.assignment.ident);
+                fprintf(e->body, "    return cl_node_%d();\n", value);
+            }
+            else if (isArg)
+                fprintf(e->body, "    cl_arg_%d = cl_node_%d();\n    return cl_arg_%d;\n", emitArg(e, symbol), value,
+                        emitArg(e, symbol));
+            else
+            {
+                int var = emitVariable(e, symbol);
+                fprintf(e->body, "    cl_var_%d = cl_cast(cl_node_%d(), %d, \"%s\");\n", var, value,
+                        ((SYMBOL_TABLE_NODE *) symbol)->val_type, ((SYMBOL_TABLE_NODE *) symbol)->ident);
+                fprintf(e->body, "    cl_var_%d_generation = cl_generation;\n    return cl_var_%d;\n", var, var);
+            }
+            break;
+        }
+    }
+
+    fclose(e->body);
+    e->body = outerBody;
+
+    fprintf(e->defs, "\nstatic cilisp_value cl_node_%d(void)\n{\n%s}\n", id, body);
+    free(body);
+
+    return id;
+}
+
+bool isEmitting(CILISP_CONTEXT *ctx)
+{
+    return ctx->emitter != NULL;
+}
+
+void emitBegin(CILISP_CONTEXT *ctx, FILE *out)
+{
+    EMITTER *e;
+
+    if ((e = calloc(sizeof(EMITTER), 1)) == NULL)
+    {
+        ciLispError(ctx, "Memory allocation failed!");
+        return;
+    }
+
+    e->ctx = ctx;
+    e->out = out;
+    e->decls = open_memstream(&e->declBuffer, &e->declSize);
+    e->defs = open_memstream(&e->defBuffer, &e->defSize);
+    ctx->emitter = e;
+}
+
+void emitForm(CILISP_CONTEXT *ctx, AST_NODE *root)
+{
+    EMITTER *e = ctx->emitter;
+
+    if (e == NULL || root == NULL || e->failed)
+        return;
+
+    if (e->formCount == e->formCapacity)
+    {
+        int capacity = e->formCapacity ? e->formCapacity * 2 : 16;
+        int *forms = realloc(e->forms, capacity * sizeof(int));
+
+        if (forms == NULL)
+        {
+            ciLispError(ctx, "Memory allocation failed!");
+            e->failed = true;
+            return;
+        }
+        e->forms = forms;
+        e->formCapacity = capacity;
+    }
+
+    int id = emitNode(e, root);
+    if (!e->failed)
+        e->forms[e->formCount++] = id;
+
+    // the tree is freed after this, so its addresses may show up again in the next form
+    if (e->emittedCount > 0)
+        memset(e->emitted, 0, (e->emittedMask + 1) * sizeof(EMITTED_NODE));
+    e->emittedCount = 0;
+}
+
+static void emitTranslationUnit(CILISP_CONTEXT *ctx, EMITTER *e)
+{
+    for (int i = 0; emitPrelude[i] != NULL; i++)
+        fprintf(e->out, "%s\n", emitPrelude[i]);
+    // the generator starts where the interpreter's would have: nothing was drawn from it while translating
+    fprintf(e->out, "/* settings of the cilisp run that generated this file */\n"
+                    "#define CL_READ_TOKEN %d\n"
+                    "static const int cl_quiet = %d;\n"
+                    "static const int cl_fresh_rand = %d;\n"
+                    "static RANDOM_STATE cl_random = {{",
+            READ_TOKEN, ctx->quiet, ctx->freshRand);
+    for (int i = 0; i < 4; i++)
+        fprintf(e->out, "%s0x%016" PRIx64 "ULL", i == 0 ? "" : ", ", ctx->random.s[i]);
+    fprintf(e->out, "}};\n\n");
+    fprintf(e->out, "/* readCheck() of the interpreter */\n%s\n\n", emitReadCheck);
+    fprintf(e->out, "/* xoshiro256** and splitmix64 of the interpreter */\n%s\n\n", emitRandom);
+    for (int i = 0; emitRuntime[i] != NULL; i++)
+        fprintf(e->out, "%s\n", emitRuntime[i]);
+    emitOperators(e->out);
+
+    fputs(e->declBuffer, e->out);
+    fputs(e->defBuffer, e->out);
+
+    fprintf(e->out, "\nstatic cilisp_value (*const cl_forms[])(void) = {\n");
+    for (int i = 0; i < e->formCount; i++)
+        fprintf(e->out, "        cl_node_%d,\n", e->forms[i]);
+    fprintf(e->out, "        NULL\n};\n\n");
+
+    fprintf(e->out, "int cilisp_form_count(void)\n{\n    return %d;\n}\n\n", e->formCount);
+    fprintf(e->out,
+            "/* Evaluates one top level s-expression. inputs are consumed by read, in order, before stdin is used. */\n"
+            "cilisp_value cilisp_eval(int form, int inputCount, char **inputs)\n"
+            "{\n"
+            "    if (form < 0 || form >= cilisp_form_count())\n"
+            "        return cl_nan();\n"
+            "    cl_input_count = inputCount;\n"
+            "    cl_inputs = inputs;\n"
+            "    cl_input_index = 0;\n"
+            "    cl_generation++;\n"
+            "    return cl_forms[form]();\n"
+            "}\n\n"
+            "/* Evaluates every s-expression in order and prints the results like the interpreter does. */\n"
+            "int cilisp_run(int inputCount, char **inputs)\n"
+            "{\n"
+            "    cl_input_count = inputCount;\n"
+            "    cl_inputs = inputs;\n"
+            "    cl_input_index = 0;\n"
+            "    cl_generation++;\n"
+            "    for (int i = 0; cl_forms[i] != NULL; i++)\n"
+            "    {\n"
+            "        cilisp_value val = cl_forms[i]();\n"
+            "        if (val.type == CL_INT_TYPE)\n"
+            "            printf(\"Int Type: %%ld\\n\", val.value.ival);\n"
+            "        else\n"
+            "            printf(\"Double Type: %%lf\\n\", val.value.dval);\n"
+            "    }\n"
+            "    return EXIT_SUCCESS;\n"
+            "}\n\n"
+            "#ifndef CILISP_NO_MAIN\n"
+            "int main(int argc, char **argv)\n"
+            "{\n"
+            "    return cilisp_run(argc - 1, argv + 1);\n"
+            "}\n"
+            "#endif\n");
+}
+
+// Writes out the translation unit and frees the emitter. Safe to call when nothing is being emitted.
+// An emitter that ran out of memory writes nothing, its error was reported already.
+void emitEnd(CILISP_CONTEXT *ctx)
+{
+    EMITTER *e = ctx->emitter;
+
+    if (e == NULL)
+        return;
+
+    fclose(e->decls);
+    fclose(e->defs);
+
+    if (!e->failed)
+        emitTranslationUnit(ctx, e);
+
+    fflush(e->out);
+    if (e->out != stdout)
+        fclose(e->out);
+
+    free(e->declBuffer);
+    free(e->defBuffer);
+    free(e->forms);
+    free(e->emitted);
+    free(e);
+    ctx->emitter = NULL;
+}
@@ -0,0 +1,229 @@
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include "ciLisp.h"
+
+// Input sources for read.
+// Streams are scanned a character at a time straight out of the stdio buffer (getc_unlocked under one lock
+// per number), so a stream can be shared with other stdio readers such as the REPL's getline.
+// Files opened by readFromFile get a READ_BUFFER sized buffer so large inputs are pulled in big blocks.
+
+// Whether stdio holds bytes of in it has not handed out yet. Only glibc tells; elsewhere every stream is taken
+// to have some, which keeps it on stdio.
+static bool streamBuffered(FILE *in)
+{
+#ifdef __GLIBC__
+    return in->_IO_read_ptr < in->_IO_read_end;
+#else
+    (void) in;
+    return true;
+#endif
+}
+
+// A stream with a descriptor and nothing in its stdio buffer is read with whatever the pipe has instead of
+// waiting for a whole buffer, so a form is evaluated as soon as its closing parenthesis arrives. Anything
+// else (fmemopen, open_memstream, a stream stdio already read ahead in) goes through stdio, up to the end
+// of a line or of what is buffered, so none of it is skipped and a pipe still gives its forms as they come.
+size_t streamInput(CILISP_CONTEXT *ctx, FILE *in, char *buffer, size_t size)
+{
+    int fd = fileno(in);
+    ssize_t count = 0;
+
+    if (fd < 0 || streamBuffered(in))
+    {
+        int c = 0;
+
+        flockfile(in);
+        while ((size_t) count < size && c != '\n' && (count == 0 || fd < 0 || streamBuffered(in)) &&
+               (c = getc_unlocked(in)) != EOF)
+            buffer[count++] = (char) c;
+        funlockfile(in);
+
+        if (count == 0 && ferror(in))
+            count = -1;
+    }
+    else
+    {
+        while ((count = read(fd, buffer, size)) < 0 && errno == EINTR)
+            ;
+    }
+
+    if (count < 0)
+    {
+        char message[ERROR_BUFFER];
+        snprintf(message, ERROR_BUFFER, "The program could not be read: %s", strerror(errno));
+        ciLispError(ctx, message);
+        ctx->quit = true; // the scanner would only ask again
+        return 0;
+    }
+
+    return (size_t) count;
+}
+
+void readFromStream(READ_SOURCE *source, FILE *stream)
+{
+    readClose(source);
+    source->stream = stream;
+}
+
+bool readFromFile(READ_SOURCE *source, const char *path)
+{
+    FILE *stream = fopen(path, "r");
+
+    if (stream == NULL)
+        return false;
+
+    readClose(source);
+    source->stream = stream;
+    source->ownsStream = true;
+
+    // the buffer has to be set before the first read
+    if ((source->buffer = malloc(READ_BUFFER)) != NULL)
+        setvbuf(stream, source->buffer, _IOFBF, READ_BUFFER);
+
+    return true;
+}
+
+void readFromValues(READ_SOURCE *source, const RET_VAL *values, size_t count)
+{
+    readClose(source);
+    source->values = values;
+    source->valueCount = count;
+}
+
+void readClose(READ_SOURCE *source)
+{
+    if (source->ownsStream)
+        fclose(source->stream);
+
+    free(source->buffer);
+    memset(source, 0, sizeof(READ_SOURCE));
+}
+
+// exact powers of ten of the fast path of parseDecimal
+static const double exactPowers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Literals are [+-]?digits with an optional '.' and fraction, shared by the scanner and read.
+// Ints are accumulated exactly. A double whose digits fit in 53 bits and with at most 22 of them after the
+// point is one division of two exact doubles, which IEEE rounds correctly (Clinger's fast path); any
+// other double (very long or very precise) goes through strtod, so results always match strtod.
+// text has to end right after the literal (at a '\0', a space or a parenthesis).
+RET_VAL parseDecimal(const char *text, size_t length)
+{
+    const char *cursor = text;
+    const char *end = text + length;
+    bool negative = false;
+
+    if (cursor < end && (*cursor == '-' || *cursor == '+'))
+        negative = (*cursor++ == '-');
+
+    uint64_t mantissa = 0;
+    int digits = 0; // significant digits in mantissa
+    int fraction = -1; // digits after the point, -1 for an int
+    bool exact = true;
+
+    for (; cursor < end; cursor++)
+    {
+        if (*cursor == '.')
+        {
+            fraction = 0;
+            continue;
+        }
+
+        if (fraction >= 0)
+            fraction++;
+
+        if (digits == 0 && *cursor == '0')
+            continue;
+
+        if (++digits > 19)
+            exact = false;
+        else
+            mantissa = mantissa * 10 + (uint64_t) (*cursor - '0');
+    }
+
+    RET_VAL val = {INT_TYPE};
+
+    if (fraction < 0)
+    {
+        if (exact && mantissa <= (uint64_t) LONG_MAX)
+            val.value.ival = negative ? -(long) mantissa : (long) mantissa;
+        else
+            val.value.ival = strtol(text, NULL, 10);
+        return val;
+    }
+
+    // trailing zeros of the fraction do not change the value
+    while (exact && fraction > 0 && mantissa != 0 && mantissa % 10 == 0)
+    {
+        mantissa /= 10;
+        fraction--;
+    }
+
+    val.type = DOUBLE_TYPE;
+    if (!exact || mantissa > (1ULL << 53) || fraction > 22)
+        val.value.dval = strtod(text, NULL);
+    else
+    {
+        val.value.dval = (double) mantissa / exactPowers[fraction];
+        if (negative)
+            val.value.dval = -val.value.dval;
+    }
+
+    return val;
+}
+
+READ_CHECK_FUNCTION()
+
+// One whitespace separated token of at most READ_TOKEN - 1 characters, checked by readCheck
+static READ_STATUS readToken(FILE *stream, RET_VAL *val)
+{
+    char token[READ_TOKEN];
+    size_t length = 0;
+    int c;
+
+    while ((c = getc_unlocked(stream)) != EOF && isspace(c))
+        ;
+
+    if (c == EOF)
+        return READ_END;
+
+    // the whitespace that ends the token is consumed along with it
+    for (; c != EOF && !isspace(c); c = getc_unlocked(stream), length++)
+    {
+        if (length < READ_TOKEN - 1)
+            token[length] = (char) c;
+    }
+
+    if (length > READ_TOKEN - 1 || !readCheck(token, length))
+        return READ_INVALID;
+
+    token[length] = '\0';
+    *val = parseDecimal(token, length);
+    return READ_OK;
+}
+
+READ_STATUS readNumber(READ_SOURCE *source, RET_VAL *val)
+{
+    if (source->values != NULL)
+    {
+        if (source->nextValue >= source->valueCount)
+            return READ_END;
+
+        *val = source->values[source->nextValue++];
+        return READ_OK;
+    }
+
+    if (source->stream == NULL)
+        return READ_END;
+
+    flockfile(source->stream);
+    READ_STATUS status = readToken(source->stream, val);
+    funlockfile(source->stream);
+
+    return status;
+}
@@ -0,0 +1,226 @@
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "ciLisp.h"
+
+// Corpus runner (--jobs).
+// Every file is a stream of forms evaluated by evalStream in a context of its own, so files do not see each
+// other's definitions, rand state or errors. A pool of threads takes the next file as soon as it is done with
+// one (files vary a lot in size, a fixed split would leave threads idle). Each file's output, errors included,
+// goes to a memory buffer; the calling thread writes the buffers out in the order of the files as they finish.
+
+typedef struct {
+    char *path;
+    char *output;
+    size_t outputLength;
+    long forms;
+    long failed; // forms with errors, -1 when the file could not be read
+    bool done;
+} JOB;
+
+typedef struct {
+    JOB *jobs;
+    int jobCount;
+    int nextJob; // the next file no thread has taken yet
+    uint64_t seed;
+    bool freshRand;
+    BUDGET budget;
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+} JOB_QUEUE;
+
+static void runJob(JOB_QUEUE *queue, JOB *job)
+{
+    FILE *out = open_memstream(&job->output, &job->outputLength);
+    FILE *in = fopen(job->path, "r");
+    CILISP_CONTEXT ctx;
+
+    ciLispContextInit(&ctx);
+    ctx.out = out;
+    ctx.errorStream = out;
+    ctx.quiet = true;
+    randomSeed(&ctx.random, queue->seed);
+    ctx.freshRand = queue->freshRand;
+    ctx.budget = queue->budget;
+
+    if (in == NULL || out == NULL || (job->forms = evalStream(&ctx, in, &job->failed)) < 0)
+    {
+        job->forms = 0;
+        job->failed = -1;
+    }
+
+    ciLispContextFree(&ctx);
+    if (in != NULL)
+        fclose(in);
+    if (out != NULL)
+        fclose(out); // sets output and outputLength
+}
+
+static void *jobWorker(void *argument)
+{
+    JOB_QUEUE *queue = argument;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&queue->lock);
+        int next = queue->nextJob < queue->jobCount ? queue->nextJob++ : -1;
+        pthread_mutex_unlock(&queue->lock);
+
+        if (next < 0)
+            return NULL;
+
+        runJob(queue, &queue->jobs[next]);
+
+        pthread_mutex_lock(&queue->lock);
+        queue->jobs[next].done = true;
+        pthread_cond_broadcast(&queue->finished);
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+static int comparePaths(const void *a, const void *b)
+{
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+static void appendPath(char ***paths, int *count, int *capacity, char *path)
+{
+    if (*count == *capacity)
+    {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        *paths = realloc(*paths, *capacity * sizeof(char *));
+    }
+    (*paths)[(*count)++] = path;
+}
+
+// The regular files of a directory (not its subdirectories, nor hidden files) in name order, or the path itself
+static void addPath(const char *path, char ***paths, int *count, int *capacity)
+{
+    struct stat info;
+    int first = *count;
+
+    if (stat(path, &info) == 0 && S_ISDIR(info.st_mode))
+    {
+        DIR *dir = opendir(path);
+        struct dirent *entry;
+
+        while (dir != NULL && (entry = readdir(dir)) != NULL)
+        {
+            if (entry->d_name[0] == '.')
+                continue;
+
+            size_t length = strlen(path) + strlen(entry->d_name) + 2;
+            char *file = malloc(length);
+            snprintf(file, length, "%s%s%s", path, path[strlen(path) - 1] == '/' ? "" : "/", entry->d_name);
+
+            if (stat(file, &info) != 0 || !S_ISREG(info.st_mode))
+            {
+                free(file);
+                continue;
+            }
+
+            appendPath(paths, count, capacity, file);
+        }
+
+        if (dir != NULL)
+            closedir(dir);
+        qsort(*paths + first, *count - first, sizeof(char *), comparePaths);
+        return;
+    }
+
+    appendPath(paths, count, capacity, strdup(path));
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int runJobs(int threadCount, char **paths, int pathCount, uint64_t seed, bool freshRand, const BUDGET *budget,
+            FILE *out, FILE *report)
+{
+    JOB_QUEUE queue = {NULL, 0, 0, seed, freshRand, *budget};
+    char **files = NULL;
+    int capacity = 0;
+
+    for (int i = 0; i < pathCount; i++)
+        addPath(paths[i], &files, &queue.jobCount, &capacity);
+
+    if (queue.jobCount == 0)
+    {
+        fprintf(report, "--jobs: no files to run\n");
+        return -1;
+    }
+
+    if (threadCount <= 0)
+        threadCount = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (threadCount > queue.jobCount)
+        threadCount = queue.jobCount;
+
+    queue.jobs = calloc(queue.jobCount, sizeof(JOB));
+    for (int i = 0; i < queue.jobCount; i++)
+        queue.jobs[i].path = files[i];
+    free(files);
+
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.finished, NULL);
+
+    double start = now();
+    pthread_t threads[threadCount];
+    int started = 0;
+    while (started < threadCount && pthread_create(&threads[started], NULL, jobWorker, &queue) == 0)
+        started++;
+    if (started == 0)
+        jobWorker(&queue); // no thread could be started: everything on this one
+    threadCount = started > 0 ? started : 1;
+
+    // outputs in file order, each as soon as it and the ones before it are done
+    long forms = 0;
+    long failedForms = 0;
+    int failedFiles = 0;
+    for (int i = 0; i < queue.jobCount; i++)
+    {
+        JOB *job = &queue.jobs[i];
+
+        pthread_mutex_lock(&queue.lock);
+        while (!job->done)
+            pthread_cond_wait(&queue.finished, &queue.lock);
+        pthread_mutex_unlock(&queue.lock);
+
+        fprintf(out, "==> %s <==\n", job->path);
+        if (job->failed < 0)
+            fprintf(out, "ERROR: %s could not be read\n", job->path);
+        else if (job->outputLength > 0)
+            fwrite(job->output, 1, job->outputLength, out);
+        fflush(out);
+
+        forms += job->forms;
+        if (job->failed != 0)
+        {
+            failedFiles++;
+            failedForms += (job->failed > 0) ? job->failed : 0;
+        }
+
+        free(job->output);
+        free(job->path);
+    }
+
+    while (started-- > 0)
+        pthread_join(threads[started], NULL);
+    double elapsed = now() - start;
+
+    fprintf(report, "--jobs: %d files, %ld forms in %.3f s with %d threads (%.0f files/s, %.0f forms/s), "
+                    "%d files failed (%ld forms with errors)\n",
+            queue.jobCount, forms, elapsed, threadCount, queue.jobCount / elapsed, forms / elapsed,
+            failedFiles, failedForms);
+
+    pthread_cond_destroy(&queue.finished);
+    pthread_mutex_destroy(&queue.lock);
+    free(queue.jobs);
+
+    return failedFiles;
+}
@@ -0,0 +1,310 @@
+#include <unistd.h>
+#include "ciLisp.h"
+
+// Batch mode: inputs are either one CSV table (stdin when there is none) or name=file binary columns
+static int runBatch(CILISP_CONTEXT *ctx, char *expr, bool binary, int inputCount, char **inputs) {
+    AST_NODE *root = ciLispParse(ctx, expr);
+    long rows = -1;
+
+    if (root != NULL && ctx->errorCount == 0 && checkForm(ctx, root, true) == 0) // the columns bind the free symbols
+        optimizeForm(ctx, root);
+
+    if (root == NULL || ctx->errorCount > 0) {
+        fprintf(ctx->errorStream, "--batch: %s\n", ctx->error[0] ? ctx->error : "nothing to evaluate");
+        freeNode(root);
+        ciLispContextFree(ctx);
+        return EXIT_FAILURE;
+    }
+
+    if (inputCount == 0 || strchr(inputs[0], '=') == NULL) {
+        FILE *csv = (inputCount == 0) ? stdin : fopen(inputs[0], "r");
+        if (csv == stdin && ctx->in.stream == stdin)
+            readFromStream(&ctx->in, NULL); // read must not eat the table
+        if (csv == NULL)
+            perror(inputs[0]);
+        else
+            rows = evalBatchCsv(ctx, root, csv, binary);
+        if (csv != NULL && csv != stdin)
+            fclose(csv);
+    } else {
+        char *names[inputCount];
+        FILE *files[inputCount];
+        int opened = 0;
+
+        for (; opened < inputCount; opened++) {
+            char *separator = strchr(inputs[opened], '=');
+            if (separator == NULL) {
+                fprintf(stderr, "--batch: expected name=file, got %s\n", inputs[opened]);
+                break;
+            }
+            *separator = '\0';
+            names[opened] = inputs[opened];
+            if ((files[opened] = fopen(separator + 1, "rb")) == NULL) {
+                perror(separator + 1);
+                break;
+            }
+        }
+
+        if (opened == inputCount)
+            rows = evalBatchColumns(ctx, root, inputCount, names, files, binary);
+        while (opened-- > 0)
+            fclose(files[opened]);
+    }
+
+    if (rows < 0 && ctx->error[0])
+        fprintf(ctx->errorStream, "--batch: %s\n", ctx->error);
+
+    freeNode(root);
+    ciLispContextFree(ctx);
+    return rows < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Stream mode: stdin is a program of any number of forms, spanning as many lines as they like. Each form is
+// evaluated (or translated) as soon as it is complete and freed right after, so memory does not grow with the input.
+// A binary AST file (--dump-ast) on stdin is mapped and its forms are loaded the same way.
+static int runStream(CILISP_CONTEXT *ctx) {
+    long failed;
+
+    if (ctx->in.stream == stdin)
+        readFromStream(&ctx->in, NULL); // read must not eat the program
+
+    long forms = evalStream(ctx, stdin, &failed);
+
+    ciLispContextFree(ctx); // also writes out the C translation unit when emitting, or finishes the AST file
+    return forms < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// The whole file as a string, NULL (and the reason on stderr) when it cannot be read
+static char *readWholeFile(const char *path) {
+    FILE *file = fopen(path, "r");
+    char *text = NULL;
+    size_t length = 0;
+
+    if (file == NULL) {
+        perror(path);
+        return NULL;
+    }
+
+    FILE *buffer = open_memstream(&text, &length);
+    char block[4096];
+    size_t count;
+    while (buffer != NULL && (count = fread(block, 1, sizeof(block), file)) > 0)
+        fwrite(block, 1, count, buffer);
+    fclose(file);
+    if (buffer != NULL)
+        fclose(buffer);
+
+    return text;
+}
+
+// --prelude: the whole file is one let section, errors in it are fatal
+static bool loadPrelude(CILISP_CONTEXT *ctx, const char *path) {
+    char *text = readWholeFile(path);
+
+    ctx->trace = false;
+    bool loaded = text != NULL && preludeLoad(ctx, text);
+    ctx->trace = true;
+    free(text);
+
+    if (!loaded && ctx->error[0])
+        fprintf(stderr, "--prelude: %s\n", ctx->error);
+    ctx->errorCount = 0;
+    ctx->error[0] = '\0';
+    return loaded;
+}
+
+// REPL driver: one s-expression per line from stdin.
+int main(int argc, char **argv) {
+
+    // cilisp --emit-c [file.c]: translate the program read from stdin to C instead of evaluating it
+    // cilisp --dump-ast [file.ast]: write the trees of the program read from stdin instead of evaluating them
+    // cilisp --input FILE: values for read come from FILE instead of stdin
+    // cilisp --quiet: no prompts (for piped input)
+    // cilisp --seed N: seed for rand, for reproducible runs
+    // cilisp --fresh-rand: rand draws a new value every time it is reached (in loops and recursion)
+    // cilisp --batch EXPR [--binary] [table.csv | name=column.bin ...]: evaluate EXPR once per input row
+    // cilisp --stream: stdin is one program, forms may span lines and each is evaluated as soon as it closes
+    // cilisp --prelude FILE: FILE is a let section, every form is evaluated in it (REPL and --stream)
+    // cilisp --fork: each form (REPL and --stream) is evaluated in a child process
+    // cilisp --jobs N PATH...: run every file (or every file of a directory) on N threads, outputs in order
+    // cilisp --serve SOCKET [--workers N]: answer requests on a Unix domain socket with N worker contexts
+    // cilisp --max-steps N --max-depth N --max-memory BYTES --max-time SECONDS: budget of every evaluation
+    // cilisp --metrics-file PATH: counters in the Prometheus text format, rewritten every few seconds and at exit
+    FILE *emitFile = NULL;
+    FILE *dumpFile = NULL;
+    char *batchExpr = NULL;
+    bool binary = false;
+    bool quiet = false;
+    bool stream = false;
+    char *preludeFile = NULL;
+    bool forkForms = false;
+    int jobs = -1;
+    char *serveSocket = NULL;
+    int workers = 0;
+    char *inputFile = NULL;
+    uint64_t seed = RANDOM_DEFAULT_SEED;
+    bool freshRand = false;
+    BUDGET budget = {0};
+    char *metricsFile = NULL;
+    int firstInput = argc;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--emit-c") == 0) {
+            emitFile = stdout;
+            if (i + 1 < argc && argv[i + 1][0] != '-' && (emitFile = fopen(argv[++i], "w")) == NULL) {
+                perror(argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--dump-ast") == 0) {
+            dumpFile = stdout;
+            if (i + 1 < argc && argv[i + 1][0] != '-' && (dumpFile = fopen(argv[++i], "wb")) == NULL) {
+                perror(argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batchExpr = argv[++i];
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            inputFile = argv[++i];
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--fresh-rand") == 0) {
+            freshRand = true;
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serveSocket = argv[++i];
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-steps") == 0 && i + 1 < argc) {
+            budget.steps = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--max-depth") == 0 && i + 1 < argc) {
+            budget.depth = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--max-memory") == 0 && i + 1 < argc) {
+            budget.memory = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--max-time") == 0 && i + 1 < argc) {
+            budget.seconds = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc) {
+            metricsFile = argv[++i];
+        } else if (strcmp(argv[i], "--prelude") == 0 && i + 1 < argc) {
+            preludeFile = argv[++i];
+        } else if (strcmp(argv[i], "--fork") == 0) {
+            forkForms = true;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream = true;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = true;
+        } else if (strcmp(argv[i], "--binary") == 0) {
+            binary = true;
+        } else if ((batchExpr != NULL || jobs >= 0) && firstInput == argc) {
+            firstInput = i; // the rest are batch inputs or the files to run
+            break;
+        }
+    }
+
+    if (metricsFile != NULL && !metricsEnable(metricsFile)) { // before any context is made, they all count
+        perror(metricsFile);
+        return EXIT_FAILURE;
+    }
+
+    if (jobs >= 0) // every file gets a context of its own, read has no input there
+        return runJobs(jobs, argv + firstInput, argc - firstInput, seed, freshRand, &budget, stdout, stderr) == 0
+               ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    if (serveSocket != NULL) { // every worker loads the prelude into a context of its own
+        char *prelude = (preludeFile != NULL) ? readWholeFile(preludeFile) : NULL;
+        int served = (preludeFile == NULL || prelude != NULL) ?
+                     runServer(serveSocket, workers, prelude, seed, freshRand, &budget, stderr) : -1;
+        free(prelude);
+        return served == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    CILISP_CONTEXT ctx;
+    ciLispContextInit(&ctx);
+    ctx.errorStream = stderr;
+    ctx.trace = true;
+    ctx.out = stdout;
+    readFromStream(&ctx.in, stdin);
+    ctx.quiet = quiet;
+    randomSeed(&ctx.random, seed);
+    ctx.freshRand = freshRand;
+    ctx.budget = budget;
+
+    if (inputFile != NULL && !readFromFile(&ctx.in, inputFile)) {
+        perror(inputFile);
+        return EXIT_FAILURE;
+    }
+
+    if (preludeFile != NULL && !loadPrelude(&ctx, preludeFile)) {
+        ciLispContextFree(&ctx);
+        return EXIT_FAILURE;
+    }
+    ctx.forkForms = forkForms;
+
+    // the REPL throws away the parser's debug printouts on stderr, errors still go there through a copy of it
+    FILE *errors = NULL;
+    if (batchExpr == NULL && !stream) {
+        int fd = dup(STDERR_FILENO);
+        if (fd >= 0 && (errors = fdopen(fd, "w")) != NULL)
+            setvbuf(errors, NULL, _IONBF, 0);
+        ctx.errorStream = errors;
+        freopen("/dev/null", "w", stderr);
+    }
+
+    if (batchExpr != NULL) {
+        ctx.trace = false; // stderr is kept for errors in batch mode
+        return runBatch(&ctx, batchExpr, binary, argc - firstInput, argv + firstInput);
+    }
+
+    if (emitFile != NULL)
+        emitBegin(&ctx, emitFile);
+    else if (dumpFile != NULL) {
+        astDumpBegin(&ctx, dumpFile);
+        if (dumpFile == stdout) // warnings and errors must not end up in the file
+            ctx.out = ctx.errorStream; // stderr, or the REPL's copy of it
+    }
+
+    if (stream) {
+        ctx.trace = false; // stderr is kept for errors in stream mode
+        return runStream(&ctx);
+    }
+
+    char *s_expr_str = NULL;
+    size_t s_expr_str_len = 0;
+    AST_NODE *form;
+    while (!ctx.quit) {
+        if (!isEmitting(&ctx) && !isDumpingAst(&ctx) && !ctx.quiet)
+            printf("\n> ");
+        if (getline(&s_expr_str, &s_expr_str_len, stdin) == -1)
+            break;
+
+        ctx.errorCount = 0; // ctx.error keeps the first error of this line
+        ctx.error[0] = '\0';
+        form = sessionParse(&ctx, s_expr_str); // unchanged parts of the last form are not parsed again
+        if (form != NULL && !ctx.quit) {
+            preludeAttach(&ctx, form);
+            // nothing of a form with static errors is evaluated, all of them are reported at once (on stderr)
+            int errors = checkForm(&ctx, form, false);
+            if (errors > 0)
+                outputPrintf(&ctx, "ERROR: %s\n%d error%s found, the form was not evaluated\n",
+                             ctx.error, errors, errors == 1 ? "" : "s");
+            else if (isEmitting(&ctx))
+                emitForm(&ctx, form);
+            else if (isDumpingAst(&ctx))
+                astDumpForm(&ctx, form);
+            else {
+                if (ctx.prelude == NULL) // see evalStream
+                    optimizeForm(&ctx, form); // again for every line, the session may have swapped parts of the tree
+                if (!ctx.forkForms)
+                    printRetVal(&ctx, evalForm(&ctx, form));
+                else
+                    evalFormForked(&ctx, form); // the child, or the refusal to fork, reports the errors
+            }
+        }
+        outputFlush(&ctx); // one write per top level form
+    }
+
+    free(s_expr_str);
+    ciLispContextFree(&ctx); // also writes out the C translation unit when emitting
+    if (errors != NULL)
+        fclose(errors);
+    return EXIT_SUCCESS;
+}
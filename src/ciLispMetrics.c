@@ -0,0 +1,261 @@
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include "ciLisp.h"
+
+// Metrics (--metrics-file).
+// Counting must cost next to nothing where it happens, in eval. So there is no shared counter: every context
+// has its block, and since one thread at a time evaluates in a context, an increment is a plain load and store
+// of that thread's own cache line. The cost moves to the reader, who locks the list of blocks and sums them;
+// blocks of freed contexts are added to the totals first so nothing counted is lost. The metrics file is
+// written by a thread of its own, none of the evaluating threads ever waits for it.
+
+static const char *nodeTypeNames[AST_NODE_TYPES] = {
+        [NUM_NODE_TYPE] = "number",
+        [FUNC_NODE_TYPE] = "function",
+        [SYMBOL_NODE_TYPE] = "symbol",
+        [COND_NODE_TYPE] = "cond",
+        [PROGN_NODE_TYPE] = "progn",
+        [WHILE_NODE_TYPE] = "while",
+        [FOR_NODE_TYPE] = "for",
+        [SET_NODE_TYPE] = "set"
+};
+
+static struct {
+    pthread_mutex_t lock;
+    bool enabled;
+    METRICS *live; // blocks of the contexts in use
+    METRICS retired; // sums of the blocks already detached
+
+    pthread_mutex_t enabling; // one metricsEnable at a time, lock is taken by the file writes it makes
+    char *path; // metrics file, set once the writer is running
+    pthread_t writer;
+    pthread_cond_t wake;
+    bool stopping;
+} metrics = {.lock = PTHREAD_MUTEX_INITIALIZER, .enabling = PTHREAD_MUTEX_INITIALIZER};
+
+static void metricsAdd(METRICS *into, METRICS *from)
+{
+    METRIC_ADD(into->forms, atomic_load_explicit(&from->forms, memory_order_relaxed));
+    for (int i = 0; i < AST_NODE_TYPES; i++)
+        METRIC_ADD(into->nodes[i], atomic_load_explicit(&from->nodes[i], memory_order_relaxed));
+    METRIC_ADD(into->lambdaCalls, atomic_load_explicit(&from->lambdaCalls, memory_order_relaxed));
+    METRIC_ADD(into->argumentAllocations, atomic_load_explicit(&from->argumentAllocations, memory_order_relaxed));
+    METRIC_ADD(into->parseErrors, atomic_load_explicit(&from->parseErrors, memory_order_relaxed));
+    METRIC_ADD(into->cacheHits, atomic_load_explicit(&from->cacheHits, memory_order_relaxed));
+    METRIC_ADD(into->cacheMisses, atomic_load_explicit(&from->cacheMisses, memory_order_relaxed));
+    for (int i = 0; i <= METRICS_LATENCY_BUCKETS; i++)
+        METRIC_ADD(into->latency[i], atomic_load_explicit(&from->latency[i], memory_order_relaxed));
+    METRIC_ADD(into->latencyNanoseconds, atomic_load_explicit(&from->latencyNanoseconds, memory_order_relaxed));
+}
+
+METRICS *metricsAttach(void)
+{
+    METRICS *block;
+
+    pthread_mutex_lock(&metrics.lock);
+    if (metrics.enabled && (block = calloc(1, sizeof(METRICS))) != NULL)
+    {
+        block->next = metrics.live;
+        if (metrics.live != NULL)
+            metrics.live->prev = block;
+        metrics.live = block;
+    }
+    else
+        block = NULL;
+    pthread_mutex_unlock(&metrics.lock);
+
+    return block;
+}
+
+void metricsDetach(METRICS *block)
+{
+    if (block == NULL)
+        return;
+
+    pthread_mutex_lock(&metrics.lock);
+    metricsAdd(&metrics.retired, block);
+    if (block->prev != NULL)
+        block->prev->next = block->next;
+    else
+        metrics.live = block->next;
+    if (block->next != NULL)
+        block->next->prev = block->prev;
+    pthread_mutex_unlock(&metrics.lock);
+
+    free(block);
+}
+
+void metricsEvaluated(METRICS *block, double seconds)
+{
+    int bucket = 0;
+    double bound = 1e-6;
+
+    while (bucket < METRICS_LATENCY_BUCKETS && seconds > bound)
+    {
+        bucket++;
+        bound *= 10;
+    }
+
+    METRIC_ADD(block->forms, 1);
+    METRIC_ADD(block->latency[bucket], 1);
+    METRIC_ADD(block->latencyNanoseconds, (unsigned long) (seconds * 1e9));
+}
+
+static void writeCounter(FILE *out, const char *name, const char *help, unsigned long value)
+{
+    fprintf(out, "# HELP %s %s\n# TYPE %s counter\n%s %lu\n", name, help, name, name, value);
+}
+
+void metricsWrite(FILE *out)
+{
+    METRICS total = {0};
+
+    pthread_mutex_lock(&metrics.lock);
+    metricsAdd(&total, &metrics.retired);
+    for (METRICS *block = metrics.live; block != NULL; block = block->next)
+        metricsAdd(&total, block);
+    pthread_mutex_unlock(&metrics.lock);
+
+    writeCounter(out, "cilisp_forms_evaluated_total", "Top level forms evaluated.", total.forms);
+
+    fprintf(out, "# HELP cilisp_nodes_evaluated_total AST nodes evaluated, by node type.\n"
+                 "# TYPE cilisp_nodes_evaluated_total counter\n");
+    for (int i = 0; i < AST_NODE_TYPES; i++)
+        fprintf(out, "cilisp_nodes_evaluated_total{type=\"%s\"} %lu\n", nodeTypeNames[i],
+                (unsigned long) total.nodes[i]);
+
+    writeCounter(out, "cilisp_lambda_calls_total", "Lambda calls that were not inlined.", total.lambdaCalls);
+    writeCounter(out, "cilisp_argument_allocations_total", "Heap allocations for lambda call arguments.",
+                 total.argumentAllocations);
+    writeCounter(out, "cilisp_parse_errors_total", "Syntax errors reported by the parser.", total.parseErrors);
+    writeCounter(out, "cilisp_cache_hits_total", "Server requests whose expression was already compiled.",
+                 total.cacheHits);
+    writeCounter(out, "cilisp_cache_misses_total", "Server requests whose expression was compiled.",
+                 total.cacheMisses);
+
+    fprintf(out, "# HELP cilisp_eval_seconds Time taken by evaluations of top level forms.\n"
+                 "# TYPE cilisp_eval_seconds histogram\n");
+    unsigned long cumulative = 0;
+    double bound = 1e-6;
+    for (int i = 0; i < METRICS_LATENCY_BUCKETS; i++, bound *= 10)
+    {
+        cumulative += total.latency[i];
+        fprintf(out, "cilisp_eval_seconds_bucket{le=\"%g\"} %lu\n", bound, cumulative);
+    }
+    cumulative += total.latency[METRICS_LATENCY_BUCKETS];
+    fprintf(out, "cilisp_eval_seconds_bucket{le=\"+Inf\"} %lu\n", cumulative);
+    fprintf(out, "cilisp_eval_seconds_sum %.9f\n", total.latencyNanoseconds / 1e9);
+    fprintf(out, "cilisp_eval_seconds_count %lu\n", cumulative);
+}
+
+// a scraper reads either the last file or the one before it, never one being written
+static bool writeMetricsFile(const char *path)
+{
+    size_t length = strlen(path) + 5;
+    char temporary[length];
+    snprintf(temporary, length, "%s.tmp", path);
+
+    FILE *out = fopen(temporary, "w");
+    if (out == NULL)
+        return false;
+
+    metricsWrite(out);
+    if (fclose(out) != 0 || rename(temporary, path) != 0)
+    {
+        unlink(temporary);
+        return false;
+    }
+    return true;
+}
+
+static void *metricsWriter(void *argument)
+{
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    pthread_mutex_lock(&metrics.lock);
+    while (!metrics.stopping)
+    {
+        next.tv_sec += METRICS_INTERVAL;
+        while (!metrics.stopping && pthread_cond_timedwait(&metrics.wake, &metrics.lock, &next) == 0)
+            ;
+        if (metrics.stopping)
+            break;
+
+        pthread_mutex_unlock(&metrics.lock);
+        writeMetricsFile(metrics.path);
+        pthread_mutex_lock(&metrics.lock);
+    }
+    pthread_mutex_unlock(&metrics.lock);
+
+    return NULL;
+}
+
+// at exit: the writer is stopped and the final counts are written
+static void metricsEnd(void)
+{
+    pthread_mutex_lock(&metrics.lock);
+    metrics.stopping = true;
+    pthread_cond_signal(&metrics.wake);
+    pthread_mutex_unlock(&metrics.lock);
+
+    pthread_join(metrics.writer, NULL);
+    if (!writeMetricsFile(metrics.path))
+        perror(metrics.path);
+    free(metrics.path);
+}
+
+// Writes path once and starts the thread that keeps it up to date. Nothing is left behind when that fails.
+static bool metricsStart(const char *path)
+{
+    char *copy = strdup(path);
+    if (copy == NULL || !writeMetricsFile(copy))
+    {
+        free(copy);
+        return false;
+    }
+
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&metrics.wake, &attributes);
+    pthread_condattr_destroy(&attributes);
+    metrics.path = copy;
+
+    // the writer takes no signals, they stay with the threads that wait for them (see runServer)
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &previous);
+    int created = pthread_create(&metrics.writer, NULL, metricsWriter, NULL);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    if (created != 0)
+    {
+        pthread_cond_destroy(&metrics.wake);
+        free(metrics.path);
+        metrics.path = NULL;
+        return false;
+    }
+
+    atexit(metricsEnd);
+    return true;
+}
+
+bool metricsEnable(const char *path)
+{
+    pthread_mutex_lock(&metrics.enabling);
+
+    // the writer is started by the first call with a path, whether counting was on before or not
+    bool ready = path == NULL || metrics.path != NULL || metricsStart(path);
+    if (ready)
+    {
+        pthread_mutex_lock(&metrics.lock);
+        metrics.enabled = true;
+        pthread_mutex_unlock(&metrics.lock);
+    }
+
+    pthread_mutex_unlock(&metrics.enabling);
+    return ready;
+}
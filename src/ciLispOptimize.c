@@ -0,0 +1,838 @@
+#include <limits.h>
+#include "ciLisp.h"
+
+// Optimizations of a checked tree, run by the REPL, cilispCompile and --batch before the first evaluation.
+//
+// Inlining: a call of a small helper lambda goes through helperCustomOper(): the name is looked up through
+// the parent chain, the parameters are put on stack nodes and copied into the arguments, then the body is
+// evaluated. Calls of lambdas that are small (INLINE_MAX_NODES), have no let block in their body and can not
+// reach themselves in the call graph get their own copy of the body instead (FUNC inlined). The copy has
+// its own arguments, renamed in effect since nothing else can see them, and hangs below the scope the lambda
+// was defined in, so its free symbols resolve exactly as in the lambda. Calls inside a copy are inlined
+// again until INLINE_BUDGET nodes were copied for the form.
+//
+// Common subexpressions: generated programs repeat subtrees like (sqrt (add (mult a a) (mult b b))) and
+// eval() computes every copy. Builtin calls are hash-consed instead: all copies of a subtree get the first
+// copy as their common node, which computes the value once per evaluation (ctx->generation) for all of them.
+// Only subtrees whose value cannot change during an evaluation take part. They are pure builtins
+// (ciLispOperators.def), numbers and symbols bound to inputs or to let variables that are themselves
+// stable and never set. Lambda and loop arguments change from call to call, and read, rand, print and lambda
+// calls are not pure, so anything above them is evaluated as before. Two symbols are the same only when they
+// resolve to the same binding, which keeps copies in different scopes apart.
+
+// Open addressing table of pointers, used both for the let variables seen and the distinct subtrees
+typedef struct {
+    uint64_t hash;
+    void *key;
+    int state; // let variables: a SYMBOL_STATE, subtrees: how many copies were found
+} OPTIMIZE_SLOT;
+
+typedef struct {
+    OPTIMIZE_SLOT *slots;
+    size_t mask;
+    size_t count;
+} OPTIMIZE_TABLE;
+
+typedef enum {
+    SYMBOL_UNKNOWN,
+    SYMBOL_VISITING, // a let variable whose value refers to itself
+    SYMBOL_STABLE,
+    SYMBOL_UNSTABLE
+} SYMBOL_STATE;
+
+// a lambda of the call graph
+typedef struct {
+    SYMBOL_TABLE_NODE *lambda;
+    int *callees; // indexes into OPTIMIZER lambdas
+    int calleeCount;
+    int calleeCapacity;
+    bool recursive;
+} INLINE_LAMBDA;
+
+typedef struct {
+    CILISP_CONTEXT *ctx;
+    OPTIMIZE_TABLE symbols;
+    OPTIMIZE_TABLE subtrees;
+    unsigned long copies; // for the trace
+
+    INLINE_LAMBDA *lambdas;
+    int lambdaCount;
+    int lambdaCapacity;
+    OPTIMIZE_TABLE lambdaIndex; // state is the index into lambdas
+    INLINE_LAMBDA *caller; // the lambda whose body is walked by inlineCallees
+    long budget; // nodes that may still be copied
+    unsigned long inlined; // for the trace
+} OPTIMIZER;
+
+// FNV-1a step over 8 bytes
+static uint64_t optimizeMix(uint64_t hash, uint64_t value)
+{
+    for (int i = 0; i < 8; i++, value >>= 8)
+    {
+        hash ^= value & 0xff;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static uint64_t optimizeHashString(uint64_t hash, const char *text)
+{
+    for (; *text != '\0'; text++)
+    {
+        hash ^= (unsigned char) *text;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static bool optimizeTableGrow(OPTIMIZE_TABLE *table)
+{
+    size_t size = table->slots ? (table->mask + 1) * 2 : 64;
+    OPTIMIZE_SLOT *slots = calloc(size, sizeof(OPTIMIZE_SLOT));
+
+    if (slots == NULL)
+        return false;
+
+    for (size_t i = 0; table->slots != NULL && i <= table->mask; i++)
+    {
+        if (table->slots[i].key == NULL)
+            continue;
+
+        size_t slot = (size_t) (table->slots[i].hash ^ (table->slots[i].hash >> 32)) & (size - 1);
+        while (slots[slot].key != NULL)
+            slot = (slot + 1) & (size - 1);
+        slots[slot] = table->slots[i];
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->mask = size - 1;
+    return true;
+}
+
+// The slot of the entry equal to key (by pointer, or by equal when it is given), a new one when there is none.
+// NULL when the table cannot grow.
+static OPTIMIZE_SLOT *optimizeTableFind(OPTIMIZE_TABLE *table, uint64_t hash, void *key, bool (*equal)(void *, void *))
+{
+    if ((table->slots == NULL || (table->count + 1) * 2 > table->mask + 1) && !optimizeTableGrow(table))
+        return NULL;
+
+    size_t slot = (size_t) (hash ^ (hash >> 32)) & table->mask;
+    for (; table->slots[slot].key != NULL; slot = (slot + 1) & table->mask)
+    {
+        OPTIMIZE_SLOT *entry = &table->slots[slot];
+        if (entry->hash == hash && (entry->key == key || (equal != NULL && equal(entry->key, key))))
+            return entry;
+    }
+
+    table->count++;
+    table->slots[slot] = (OPTIMIZE_SLOT) {hash, key, 0};
+    return &table->slots[slot];
+}
+
+static uint64_t optimizePointerHash(void *key)
+{
+    return optimizeMix(0xcbf29ce484222325ULL, (uint64_t) (uintptr_t) key);
+}
+
+// What a symbol stands for, as evalSymbolNode() finds it: a let variable, an argument, or neither (an input)
+static void *optimizeResolve(AST_NODE *node, const char *ident, bool *isArg)
+{
+    *isArg = false;
+
+    for (; node != NULL; node = node->parent)
+    {
+        SYMBOL_TABLE_NODE *variable = findInScope(node, ident, VARIABLE_TYPE);
+        if (variable != NULL)
+            return variable;
+
+        for (ARG_TABLE_NODE *currArg = node->argTable; currArg != NULL; currArg = currArg->next)
+        {
+            if (!strcmp(ident, currArg->ident))
+            {
+                *isArg = true;
+                return currArg;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/*
+       Inlining
+     */
+
+// calls visit for every child of node and every value of its let block, in tree order
+static void optimizeChildren(OPTIMIZER *optimizer, AST_NODE *node, void (*visit)(OPTIMIZER *, AST_NODE *))
+{
+    AST_NODE *currNode;
+
+    for (SYMBOL_TABLE_NODE *symbol = node->symbolTable; symbol != NULL; symbol = symbol->next)
+    {
+        if (symbol->val != NULL)
+            visit(optimizer, symbol->val);
+    }
+
+    switch (node->type)
+    {
+        case FUNC_NODE_TYPE:
+            for (currNode = node->data.function.opList; currNode != NULL; currNode = currNode->next)
+                visit(optimizer, currNode);
+            if (node->data.function.inlined != NULL)
+                visit(optimizer, node->data.function.inlined);
+            break;
+        case COND_NODE_TYPE:
+            if (node->data.condition.condNode != NULL)
+                visit(optimizer, node->data.condition.condNode);
+            if (node->data.condition.trueNode != NULL)
+                visit(optimizer, node->data.condition.trueNode);
+            if (node->data.condition.falseNode != NULL)
+                visit(optimizer, node->data.condition.falseNode);
+            break;
+        case PROGN_NODE_TYPE:
+            for (currNode = node->data.sequence.body; currNode != NULL; currNode = currNode->next)
+                visit(optimizer, currNode);
+            break;
+        case WHILE_NODE_TYPE:
+        case FOR_NODE_TYPE:
+            if (node->data.loop.condNode != NULL)
+                visit(optimizer, node->data.loop.condNode);
+            if (node->data.loop.startNode != NULL)
+                visit(optimizer, node->data.loop.startNode);
+            if (node->data.loop.endNode != NULL)
+                visit(optimizer, node->data.loop.endNode);
+            for (currNode = node->data.loop.body; currNode != NULL; currNode = currNode->next)
+                visit(optimizer, currNode);
+            break;
+        case SET_NODE_TYPE:
+            if (node->data.assignment.valueNode != NULL)
+                visit(optimizer, node->data.assignment.valueNode);
+            break;
+        default:
+            break;
+    }
+}
+
+// copies of an earlier run may have been made from lambdas the REPL session replaced since
+static void inlineDiscard(OPTIMIZER *optimizer, AST_NODE *node)
+{
+    if (node->type == FUNC_NODE_TYPE)
+    {
+        freeNode(node->data.function.inlined);
+        node->data.function.inlined = NULL;
+    }
+
+    optimizeChildren(optimizer, node, inlineDiscard);
+}
+
+static SYMBOL_TABLE_NODE *inlineResolve(AST_NODE *node)
+{
+    SYMBOL_TABLE_NODE *lambda = NULL;
+
+    for (AST_NODE *currNode = node; currNode != NULL && lambda == NULL; currNode = currNode->parent)
+        lambda = findInScope(currNode, node->data.function.ident, LAMBDA_TYPE);
+
+    return lambda;
+}
+
+static int inlineLambdaIndex(OPTIMIZER *optimizer, SYMBOL_TABLE_NODE *lambda)
+{
+    OPTIMIZE_SLOT *slot = optimizeTableFind(&optimizer->lambdaIndex, optimizePointerHash(lambda), lambda, NULL);
+    return slot != NULL && slot->state > 0 ? slot->state - 1 : -1;
+}
+
+static void inlineCollect(OPTIMIZER *optimizer, AST_NODE *node)
+{
+    for (SYMBOL_TABLE_NODE *symbol = node->symbolTable; symbol != NULL; symbol = symbol->next)
+    {
+        if (symbol->sym_type != LAMBDA_TYPE || symbol->val == NULL)
+            continue;
+
+        if (optimizer->lambdaCount == optimizer->lambdaCapacity)
+        {
+            optimizer->lambdaCapacity = optimizer->lambdaCapacity ? optimizer->lambdaCapacity * 2 : 16;
+            optimizer->lambdas = realloc(optimizer->lambdas, optimizer->lambdaCapacity * sizeof(INLINE_LAMBDA));
+        }
+
+        OPTIMIZE_SLOT *slot = optimizeTableFind(&optimizer->lambdaIndex, optimizePointerHash(symbol), symbol, NULL);
+        if (slot == NULL || optimizer->lambdas == NULL)
+            continue;
+
+        optimizer->lambdas[optimizer->lambdaCount] = (INLINE_LAMBDA) {symbol};
+        slot->state = ++optimizer->lambdaCount; // index + 1, 0 is a new slot
+    }
+
+    optimizeChildren(optimizer, node, inlineCollect);
+}
+
+static void inlineCallees(OPTIMIZER *optimizer, AST_NODE *node)
+{
+    SYMBOL_TABLE_NODE *callee;
+    int index;
+
+    if (node->type == FUNC_NODE_TYPE && node->data.function.oper == CUSTOM_OPER &&
+        (callee = inlineResolve(node)) != NULL && (index = inlineLambdaIndex(optimizer, callee)) >= 0)
+    {
+        INLINE_LAMBDA *caller = optimizer->caller;
+        if (caller->calleeCount == caller->calleeCapacity)
+        {
+            caller->calleeCapacity = caller->calleeCapacity ? caller->calleeCapacity * 2 : 4;
+            caller->callees = realloc(caller->callees, caller->calleeCapacity * sizeof(int));
+        }
+        if (caller->callees != NULL)
+            caller->callees[caller->calleeCount++] = index;
+    }
+
+    optimizeChildren(optimizer, node, inlineCallees);
+}
+
+// whether target can be reached from the callees of from
+static bool inlineReaches(OPTIMIZER *optimizer, int from, int target, bool *visited)
+{
+    INLINE_LAMBDA *lambda = &optimizer->lambdas[from];
+
+    for (int i = 0; i < lambda->calleeCount; i++)
+    {
+        int callee = lambda->callees[i];
+        if (callee == target)
+            return true;
+        if (!visited[callee])
+        {
+            visited[callee] = true;
+            if (inlineReaches(optimizer, callee, target, visited))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+// Nodes in a lambda body, INT_MAX when it can not be copied (a let block needs scopes of its own)
+static int inlineSize(AST_NODE *node)
+{
+    if (node == NULL)
+        return 0;
+    if (node->symbolTable != NULL)
+        return INT_MAX;
+
+    long size = 1;
+    AST_NODE *currNode;
+
+    switch (node->type)
+    {
+        case FUNC_NODE_TYPE:
+            for (currNode = node->data.function.opList; currNode != NULL; currNode = currNode->next)
+                size += inlineSize(currNode);
+            break;
+        case COND_NODE_TYPE:
+            size += (long) inlineSize(node->data.condition.condNode) + inlineSize(node->data.condition.trueNode) +
+                    inlineSize(node->data.condition.falseNode);
+            break;
+        case PROGN_NODE_TYPE:
+            for (currNode = node->data.sequence.body; currNode != NULL; currNode = currNode->next)
+                size += inlineSize(currNode);
+            break;
+        case WHILE_NODE_TYPE:
+        case FOR_NODE_TYPE:
+            size += (long) inlineSize(node->data.loop.condNode) + inlineSize(node->data.loop.startNode) +
+                    inlineSize(node->data.loop.endNode);
+            for (currNode = node->data.loop.body; currNode != NULL; currNode = currNode->next)
+                size += inlineSize(currNode);
+            break;
+        case SET_NODE_TYPE:
+            size += inlineSize(node->data.assignment.valueNode);
+            break;
+        default:
+            break;
+    }
+
+    return size > INLINE_MAX_NODES ? INT_MAX : (int) size;
+}
+
+static ARG_TABLE_NODE *inlineCopyArgs(ARG_TABLE_NODE *arg)
+{
+    if (arg == NULL)
+        return NULL;
+
+    return createArgTableList(strdup(arg->ident), inlineCopyArgs(arg->next));
+}
+
+static AST_NODE *inlineCopy(AST_NODE *node, AST_NODE *parent);
+
+static AST_NODE *inlineCopyList(AST_NODE *list, AST_NODE *parent)
+{
+    AST_NODE *head = NULL;
+    AST_NODE **tail = &head;
+
+    for (; list != NULL; list = list->next)
+    {
+        *tail = inlineCopy(list, parent);
+        tail = &(*tail)->next;
+    }
+
+    return head;
+}
+
+// a copy of a tree without let blocks; evaluation state, common and inlined are not copied
+static AST_NODE *inlineCopy(AST_NODE *node, AST_NODE *parent)
+{
+    if (node == NULL)
+        return NULL;
+
+    AST_NODE *copy = newNode(node->type);
+    copy->parent = parent;
+    copy->argTable = inlineCopyArgs(node->argTable);
+
+    switch (node->type)
+    {
+        case NUM_NODE_TYPE:
+            copy->data.number = node->data.number;
+            break;
+        case SYMBOL_NODE_TYPE:
+            copy->data.symbol.ident = strdup(node->data.symbol.ident);
+            break;
+        case FUNC_NODE_TYPE:
+            copy->data.function.oper = node->data.function.oper;
+            if (node->data.function.oper == CUSTOM_OPER)
+                copy->data.function.ident = strdup(node->data.function.ident);
+            copy->data.function.opList = inlineCopyList(node->data.function.opList, copy);
+            break;
+        case COND_NODE_TYPE:
+            copy->data.condition.condNode = inlineCopy(node->data.condition.condNode, copy);
+            copy->data.condition.trueNode = inlineCopy(node->data.condition.trueNode, copy);
+            copy->data.condition.falseNode = inlineCopy(node->data.condition.falseNode, copy);
+            break;
+        case PROGN_NODE_TYPE:
+            copy->data.sequence.body = inlineCopyList(node->data.sequence.body, copy);
+            break;
+        case WHILE_NODE_TYPE:
+        case FOR_NODE_TYPE:
+            copy->data.loop.condNode = inlineCopy(node->data.loop.condNode, copy);
+            copy->data.loop.startNode = inlineCopy(node->data.loop.startNode, copy);
+            copy->data.loop.endNode = inlineCopy(node->data.loop.endNode, copy);
+            copy->data.loop.body = inlineCopyList(node->data.loop.body, copy);
+            break;
+        case SET_NODE_TYPE:
+            copy->data.assignment.ident = strdup(node->data.assignment.ident);
+            copy->data.assignment.valueNode = inlineCopy(node->data.assignment.valueNode, copy);
+            break;
+    }
+
+    return copy;
+}
+
+static void inlineCalls(OPTIMIZER *optimizer, AST_NODE *node)
+{
+    if (node->type == FUNC_NODE_TYPE && node->data.function.oper == CUSTOM_OPER && node->data.function.inlined == NULL)
+    {
+        SYMBOL_TABLE_NODE *lambda = inlineResolve(node);
+        int index = (lambda != NULL) ? inlineLambdaIndex(optimizer, lambda) : -1;
+        int args = 0;
+        int params = 0;
+
+        if (index >= 0 && !optimizer->lambdas[index].recursive)
+        {
+            for (ARG_TABLE_NODE *currArg = lambda->val->argTable; currArg != NULL; currArg = currArg->next)
+                args++;
+            for (AST_NODE *currOp = node->data.function.opList; currOp != NULL; currOp = currOp->next)
+                params++;
+
+            int size = inlineSize(lambda->val);
+            if (args == params && args > 0 && args <= INLINE_MAX_ARGS && size != INT_MAX && size <= optimizer->budget)
+            {
+                // below the scope the lambda was defined in, not below the call
+                node->data.function.inlined = inlineCopy(lambda->val, lambda->val->parent);
+                optimizer->budget -= size;
+                optimizer->inlined++;
+            }
+        }
+    }
+
+    // the copy is walked too, for the calls in it
+    optimizeChildren(optimizer, node, inlineCalls);
+}
+
+static void optimizeInline(OPTIMIZER *optimizer, AST_NODE *root)
+{
+    inlineDiscard(optimizer, root);
+    inlineCollect(optimizer, root);
+
+    for (int i = 0; i < optimizer->lambdaCount; i++)
+    {
+        optimizer->caller = &optimizer->lambdas[i];
+        inlineCallees(optimizer, optimizer->lambdas[i].lambda->val);
+    }
+
+    bool *visited = calloc(optimizer->lambdaCount + 1, sizeof(bool));
+    for (int i = 0; i < optimizer->lambdaCount; i++)
+    {
+        // a lambda that can not tell whether it is recursive is not inlined
+        optimizer->lambdas[i].recursive = visited == NULL || inlineReaches(optimizer, i, i, visited);
+        if (visited != NULL)
+            memset(visited, 0, optimizer->lambdaCount * sizeof(bool));
+    }
+    free(visited);
+
+    optimizer->budget = INLINE_BUDGET;
+    inlineCalls(optimizer, root);
+
+    for (int i = 0; i < optimizer->lambdaCount; i++)
+        free(optimizer->lambdas[i].callees);
+    free(optimizer->lambdas);
+    free(optimizer->lambdaIndex.slots);
+}
+
+/*
+       Common subexpressions
+     */
+
+// let variables given new values by set can not be shared
+static void optimizeMarkSet(OPTIMIZER *optimizer, AST_NODE *node);
+
+static void optimizeMarkSetList(OPTIMIZER *optimizer, AST_NODE *list)
+{
+    for (; list != NULL; list = list->next)
+        optimizeMarkSet(optimizer, list);
+}
+
+static void optimizeMarkSet(OPTIMIZER *optimizer, AST_NODE *node)
+{
+    if (node == NULL)
+        return;
+
+    for (SYMBOL_TABLE_NODE *symbol = node->symbolTable; symbol != NULL; symbol = symbol->next)
+        optimizeMarkSet(optimizer, symbol->val);
+
+    switch (node->type)
+    {
+        case FUNC_NODE_TYPE:
+            optimizeMarkSetList(optimizer, node->data.function.opList);
+            optimizeMarkSet(optimizer, node->data.function.inlined);
+            break;
+        case COND_NODE_TYPE:
+            optimizeMarkSet(optimizer, node->data.condition.condNode);
+            optimizeMarkSet(optimizer, node->data.condition.trueNode);
+            optimizeMarkSet(optimizer, node->data.condition.falseNode);
+            break;
+        case PROGN_NODE_TYPE:
+            optimizeMarkSetList(optimizer, node->data.sequence.body);
+            break;
+        case WHILE_NODE_TYPE:
+        case FOR_NODE_TYPE:
+            optimizeMarkSet(optimizer, node->data.loop.condNode);
+            optimizeMarkSet(optimizer, node->data.loop.startNode);
+            optimizeMarkSet(optimizer, node->data.loop.endNode);
+            optimizeMarkSetList(optimizer, node->data.loop.body);
+            break;
+        case SET_NODE_TYPE:
+        {
+            bool isArg;
+            void *target = optimizeResolve(node, node->data.assignment.ident, &isArg);
+            OPTIMIZE_SLOT *slot;
+            if (target != NULL && !isArg &&
+                (slot = optimizeTableFind(&optimizer->symbols, optimizePointerHash(target), target, NULL)) != NULL)
+                slot->state = SYMBOL_UNSTABLE;
+            optimizeMarkSet(optimizer, node->data.assignment.valueNode);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static bool optimizeStable(OPTIMIZER *optimizer, AST_NODE *node);
+
+static bool optimizeStableSymbol(OPTIMIZER *optimizer, SYMBOL_TABLE_NODE *variable)
+{
+    OPTIMIZE_SLOT *slot = optimizeTableFind(&optimizer->symbols, optimizePointerHash(variable), variable, NULL);
+
+    if (slot == NULL)
+        return false;
+
+    switch (slot->state)
+    {
+        case SYMBOL_STABLE:
+            return true;
+        case SYMBOL_VISITING:
+        case SYMBOL_UNSTABLE:
+            return false;
+        default:
+            break;
+    }
+
+    slot->state = SYMBOL_VISITING;
+    // an int variable given a double warns every time it is read, that output has to stay
+    bool stable = (variable->val_type != INT_TYPE || inferType(variable->val) == INT_TYPE) &&
+                  optimizeStable(optimizer, variable->val);
+
+    // the slot may have moved while the value was looked at
+    slot = optimizeTableFind(&optimizer->symbols, optimizePointerHash(variable), variable, NULL);
+    if (slot != NULL)
+        slot->state = stable ? SYMBOL_STABLE : SYMBOL_UNSTABLE;
+    return stable;
+}
+
+// true when node gives the same value wherever it is reached during one evaluation, without side effects
+static bool optimizeStable(OPTIMIZER *optimizer, AST_NODE *node)
+{
+    switch (node->type)
+    {
+        case NUM_NODE_TYPE:
+            return true;
+
+        case SYMBOL_NODE_TYPE:
+        {
+            bool isArg;
+            void *target = optimizeResolve(node, node->data.symbol.ident, &isArg);
+            if (isArg)
+                return false;
+            return target == NULL || optimizeStableSymbol(optimizer, target);
+        }
+
+        case FUNC_NODE_TYPE:
+        {
+            OPER_TYPE oper = node->data.function.oper;
+            if (oper == CUSTOM_OPER || !operSpecs[oper].pure || operSpecs[oper].arity == SPECIAL_ARITY)
+                return false;
+
+            for (AST_NODE *currOp = node->data.function.opList; currOp != NULL; currOp = currOp->next)
+            {
+                if (!optimizeStable(optimizer, currOp))
+                    return false;
+            }
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+// same value in every evaluation, for two stable subtrees
+static bool optimizeEqual(void *left, void *right)
+{
+    AST_NODE *a = left;
+    AST_NODE *b = right;
+
+    if (a->type != b->type)
+        return false;
+
+    switch (a->type)
+    {
+        case NUM_NODE_TYPE:
+            return a->data.number.type == b->data.number.type &&
+                   !memcmp(&a->data.number.value, &b->data.number.value, sizeof(a->data.number.value));
+
+        case SYMBOL_NODE_TYPE:
+        {
+            bool isArg;
+            void *targetA = optimizeResolve(a, a->data.symbol.ident, &isArg);
+            void *targetB = optimizeResolve(b, b->data.symbol.ident, &isArg);
+            if (targetA == NULL && targetB == NULL)
+                return !strcmp(a->data.symbol.ident, b->data.symbol.ident);
+            return targetA == targetB;
+        }
+
+        case FUNC_NODE_TYPE:
+        {
+            if (a->data.function.oper != b->data.function.oper)
+                return false;
+
+            AST_NODE *opA = a->data.function.opList;
+            AST_NODE *opB = b->data.function.opList;
+            for (; opA != NULL && opB != NULL; opA = opA->next, opB = opB->next)
+            {
+                if (!optimizeEqual(opA, opB))
+                    return false;
+            }
+            return opA == NULL && opB == NULL;
+        }
+
+        default:
+            return false;
+    }
+}
+
+static uint64_t optimizeHash(AST_NODE *node)
+{
+    uint64_t hash = optimizeMix(0xcbf29ce484222325ULL, node->type);
+
+    switch (node->type)
+    {
+        case NUM_NODE_TYPE:
+        {
+            uint64_t bits;
+            memcpy(&bits, &node->data.number.value, sizeof(bits));
+            return optimizeMix(optimizeMix(hash, node->data.number.type), bits);
+        }
+
+        case SYMBOL_NODE_TYPE:
+        {
+            bool isArg;
+            void *target = optimizeResolve(node, node->data.symbol.ident, &isArg);
+            if (target == NULL)
+                return optimizeHashString(hash, node->data.symbol.ident);
+            return optimizeMix(hash, (uint64_t) (uintptr_t) target);
+        }
+
+        case FUNC_NODE_TYPE:
+            hash = optimizeMix(hash, node->data.function.oper);
+            for (AST_NODE *currOp = node->data.function.opList; currOp != NULL; currOp = currOp->next)
+                hash = optimizeMix(hash, optimizeHash(currOp));
+            return hash;
+
+        default:
+            return hash;
+    }
+}
+
+// Gives every stable builtin call the first of its copies as common node. Returns whether node is stable.
+static bool optimizeShare(OPTIMIZER *optimizer, AST_NODE *node);
+
+static void optimizeShareList(OPTIMIZER *optimizer, AST_NODE *list)
+{
+    for (; list != NULL; list = list->next)
+        optimizeShare(optimizer, list);
+}
+
+static bool optimizeShare(OPTIMIZER *optimizer, AST_NODE *node)
+{
+    if (node == NULL)
+        return false;
+
+    for (SYMBOL_TABLE_NODE *symbol = node->symbolTable; symbol != NULL; symbol = symbol->next)
+        optimizeShare(optimizer, symbol->val);
+
+    switch (node->type)
+    {
+        case FUNC_NODE_TYPE:
+        {
+            FUNC_AST_NODE *funcNode = &node->data.function;
+            OPER_TYPE oper = funcNode->oper;
+            bool stable = oper != CUSTOM_OPER && operSpecs[oper].pure && operSpecs[oper].arity != SPECIAL_ARITY;
+
+            // every operand is visited, its own subtrees can be shared even when this call can not
+            for (AST_NODE *currOp = funcNode->opList; currOp != NULL; currOp = currOp->next)
+                stable = optimizeShare(optimizer, currOp) && stable;
+            optimizeShare(optimizer, funcNode->inlined);
+
+            funcNode->common = NULL;
+            if (stable)
+            {
+                OPTIMIZE_SLOT *slot = optimizeTableFind(&optimizer->subtrees, optimizeHash(node), node, optimizeEqual);
+                if (slot != NULL)
+                {
+                    slot->state++;
+                    funcNode->common = slot->key;
+                }
+            }
+            return stable;
+        }
+
+        case SYMBOL_NODE_TYPE:
+        case NUM_NODE_TYPE:
+            return optimizeStable(optimizer, node);
+
+        case COND_NODE_TYPE:
+            optimizeShare(optimizer, node->data.condition.condNode);
+            optimizeShare(optimizer, node->data.condition.trueNode);
+            optimizeShare(optimizer, node->data.condition.falseNode);
+            return false;
+
+        case PROGN_NODE_TYPE:
+            optimizeShareList(optimizer, node->data.sequence.body);
+            return false;
+
+        case WHILE_NODE_TYPE:
+        case FOR_NODE_TYPE:
+            optimizeShare(optimizer, node->data.loop.condNode);
+            optimizeShare(optimizer, node->data.loop.startNode);
+            optimizeShare(optimizer, node->data.loop.endNode);
+            optimizeShareList(optimizer, node->data.loop.body);
+            return false;
+
+        case SET_NODE_TYPE:
+            optimizeShare(optimizer, node->data.assignment.valueNode);
+            return false;
+    }
+
+    return false;
+}
+
+// A subtree without copies evaluates as before, without the memo
+static void optimizeUnshare(OPTIMIZER *optimizer, AST_NODE *node);
+
+static void optimizeUnshareList(OPTIMIZER *optimizer, AST_NODE *list)
+{
+    for (; list != NULL; list = list->next)
+        optimizeUnshare(optimizer, list);
+}
+
+static void optimizeUnshare(OPTIMIZER *optimizer, AST_NODE *node)
+{
+    if (node == NULL)
+        return;
+
+    for (SYMBOL_TABLE_NODE *symbol = node->symbolTable; symbol != NULL; symbol = symbol->next)
+        optimizeUnshare(optimizer, symbol->val);
+
+    switch (node->type)
+    {
+        case FUNC_NODE_TYPE:
+        {
+            FUNC_AST_NODE *funcNode = &node->data.function;
+            if (funcNode->common != NULL)
+            {
+                AST_NODE *common = funcNode->common;
+                OPTIMIZE_SLOT *slot = optimizeTableFind(&optimizer->subtrees, optimizeHash(common), common, optimizeEqual);
+                if (slot == NULL || slot->state < 2)
+                    funcNode->common = NULL;
+                else
+                    optimizer->copies += (common != node);
+            }
+            optimizeUnshareList(optimizer, funcNode->opList);
+            optimizeUnshare(optimizer, funcNode->inlined);
+            break;
+        }
+        case COND_NODE_TYPE:
+            optimizeUnshare(optimizer, node->data.condition.condNode);
+            optimizeUnshare(optimizer, node->data.condition.trueNode);
+            optimizeUnshare(optimizer, node->data.condition.falseNode);
+            break;
+        case PROGN_NODE_TYPE:
+            optimizeUnshareList(optimizer, node->data.sequence.body);
+            break;
+        case WHILE_NODE_TYPE:
+        case FOR_NODE_TYPE:
+            optimizeUnshare(optimizer, node->data.loop.condNode);
+            optimizeUnshare(optimizer, node->data.loop.startNode);
+            optimizeUnshare(optimizer, node->data.loop.endNode);
+            optimizeUnshareList(optimizer, node->data.loop.body);
+            break;
+        case SET_NODE_TYPE:
+            optimizeUnshare(optimizer, node->data.assignment.valueNode);
+            break;
+        default:
+            break;
+    }
+}
+
+void optimizeForm(CILISP_CONTEXT *ctx, AST_NODE *root)
+{
+    OPTIMIZER optimizer = {ctx};
+
+    if (root == NULL)
+        return;
+
+    optimizeInline(&optimizer, root);
+
+    optimizeMarkSet(&optimizer, root);
+    optimizeShare(&optimizer, root);
+    optimizeUnshare(&optimizer, root);
+
+    TRACE(ctx, "optimize: %lu calls inlined, %lu copies of common subexpressions\n", optimizer.inlined, optimizer.copies);
+
+    free(optimizer.symbols.slots);
+    free(optimizer.subtrees.slots);
+}
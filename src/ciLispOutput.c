@@ -0,0 +1,165 @@
+#include "ciLisp.h"
+
+// Output subsystem.
+// Everything a context prints (results, print, warnings, prompts) is collected in a growable buffer
+// and written out with one fwrite when the host calls outputFlush: once per top level form in the REPL,
+// once per cilispEval and once per chunk of a batch. The buffer is only flushed early past OUTPUT_LIMIT.
+
+static void bufferReserve(OUTPUT_BUFFER *buffer, size_t length)
+{
+    if (buffer->length + length <= buffer->capacity)
+        return;
+
+    size_t capacity = (buffer->capacity > 0) ? buffer->capacity : 256;
+    while (capacity < buffer->length + length)
+        capacity *= 2;
+
+    char *data = realloc(buffer->data, capacity);
+    if (data == NULL)
+    {
+        ciLispError(NULL, "Memory allocation failed!");
+        exit(1);
+    }
+
+    buffer->data = data;
+    buffer->capacity = capacity;
+}
+
+void bufferWrite(OUTPUT_BUFFER *buffer, const void *data, size_t length)
+{
+    if (length == 0)
+        return;
+
+    bufferReserve(buffer, length);
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+}
+
+void bufferVprintf(OUTPUT_BUFFER *buffer, const char *format, va_list args)
+{
+    va_list retry;
+    va_copy(retry, args);
+    bufferReserve(buffer, 1);
+
+    // most writes fit in what is left, otherwise grow and format again
+    size_t room = buffer->capacity - buffer->length;
+    int length = vsnprintf(buffer->data + buffer->length, room, format, args);
+
+    if (length >= 0 && (size_t) length >= room)
+    {
+        bufferReserve(buffer, (size_t) length + 1);
+        vsnprintf(buffer->data + buffer->length, (size_t) length + 1, format, retry);
+    }
+
+    if (length > 0)
+        buffer->length += length;
+
+    va_end(retry);
+}
+
+void bufferPrintf(OUTPUT_BUFFER *buffer, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    bufferVprintf(buffer, format, args);
+    va_end(args);
+}
+
+void bufferLong(OUTPUT_BUFFER *buffer, long value)
+{
+    static const char digitPairs[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    char *start = end;
+    unsigned long magnitude = (value < 0) ? 0UL - (unsigned long) value : (unsigned long) value;
+
+    // two digits at a time, from the back
+    while (magnitude >= 100)
+    {
+        unsigned long pair = (magnitude % 100) * 2;
+        magnitude /= 100;
+        *--start = digitPairs[pair + 1];
+        *--start = digitPairs[pair];
+    }
+
+    if (magnitude >= 10)
+    {
+        *--start = digitPairs[magnitude * 2 + 1];
+        *--start = digitPairs[magnitude * 2];
+    }
+    else
+        *--start = (char) ('0' + magnitude);
+
+    if (value < 0)
+        *--start = '-';
+
+    bufferWrite(buffer, start, (size_t) (end - start));
+}
+
+void bufferDouble(OUTPUT_BUFFER *buffer, double value)
+{
+    char digits[32];
+
+    // %g drops trailing zeros, so the first precision that reads back unchanged is also the shortest one
+    for (int precision = 15; precision <= 17; precision++)
+    {
+        snprintf(digits, sizeof(digits), "%.*g", precision, value);
+        if (precision == 17 || strtod(digits, NULL) == value || isnan(value))
+            break;
+    }
+
+    bufferWrite(buffer, digits, strlen(digits));
+}
+
+void bufferFree(OUTPUT_BUFFER *buffer)
+{
+    free(buffer->data);
+    memset(buffer, 0, sizeof(OUTPUT_BUFFER));
+}
+
+static void outputLimit(CILISP_CONTEXT *ctx)
+{
+    if (ctx->output.length >= OUTPUT_LIMIT)
+        outputFlush(ctx);
+}
+
+void outputPrintf(CILISP_CONTEXT *ctx, const char *format, ...)
+{
+    if (ctx->out == NULL)
+        return;
+
+    va_list args;
+    va_start(args, format);
+    bufferVprintf(&ctx->output, format, args);
+    va_end(args);
+
+    outputLimit(ctx);
+}
+
+void outputWrite(CILISP_CONTEXT *ctx, const void *data, size_t length)
+{
+    if (ctx->out == NULL)
+        return;
+
+    bufferWrite(&ctx->output, data, length);
+    outputLimit(ctx);
+}
+
+void outputBuffer(CILISP_CONTEXT *ctx, OUTPUT_BUFFER *buffer)
+{
+    outputWrite(ctx, buffer->data, buffer->length);
+}
+
+void outputFlush(CILISP_CONTEXT *ctx)
+{
+    if (ctx->out != NULL && ctx->output.length > 0)
+    {
+        fwrite(ctx->output.data, 1, ctx->output.length, ctx->out);
+        fflush(ctx->out);
+    }
+
+    ctx->output.length = 0;
+}
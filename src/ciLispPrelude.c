@@ -0,0 +1,157 @@
+#include <errno.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "ciLisp.h"
+
+// Prelude environment (--prelude).
+// A let section is parsed, checked and optimized once. Every later form is then evaluated as the body of that
+// let: it only gets the prelude as its parent, nothing of the prelude is parsed, copied or walked again, so the
+// cost of a form does not depend on the size of the prelude.
+// Evaluations never change the prelude for good. What they write into its nodes (set values, memos of read,
+// rand and common subexpressions) is only valid for the generation it was written in (see evalForm), so every
+// form starts from the same environment, as if from a snapshot.
+// Forms can also be run in a forked child (evalFormForked), which gets the prelude as copy-on-write pages
+// for free: a form that crashes or calls exit can not damage the environment of the next one. The parent
+// draws a seed for the child's rand, so every form still gets a rand sequence of its own. What read takes out
+// of its input in the child would be lost to the parent, so forms that can reach read are not forked.
+
+// whether read is called anywhere in node, its let sections and lambda bodies included
+static bool readsInput(AST_NODE *node)
+{
+    for (; node != NULL; node = node->next)
+    {
+        for (SYMBOL_TABLE_NODE *symbol = node->symbolTable; symbol != NULL; symbol = symbol->next)
+        {
+            if (readsInput(symbol->val))
+                return true;
+        }
+
+        switch (node->type)
+        {
+            case FUNC_NODE_TYPE:
+                if (node->data.function.oper == READ_OPER || readsInput(node->data.function.opList))
+                    return true;
+                break;
+            case COND_NODE_TYPE:
+                if (readsInput(node->data.condition.condNode) || readsInput(node->data.condition.trueNode) ||
+                    readsInput(node->data.condition.falseNode))
+                    return true;
+                break;
+            case PROGN_NODE_TYPE:
+                if (readsInput(node->data.sequence.body))
+                    return true;
+                break;
+            case WHILE_NODE_TYPE:
+            case FOR_NODE_TYPE:
+                if (readsInput(node->data.loop.condNode) || readsInput(node->data.loop.startNode) ||
+                    readsInput(node->data.loop.endNode) || readsInput(node->data.loop.body))
+                    return true;
+                break;
+            case SET_NODE_TYPE:
+                if (readsInput(node->data.assignment.valueNode))
+                    return true;
+                break;
+            default:
+                break;
+        }
+    }
+
+    return false;
+}
+
+bool preludeLoad(CILISP_CONTEXT *ctx, const char *letSection)
+{
+    // parsed as the let of a form with a placeholder body, on one line
+    size_t length = strlen(letSection);
+    char *source = malloc(length + 8);
+
+    if (source == NULL)
+    {
+        ciLispError(ctx, "Memory allocation failed!");
+        return false;
+    }
+
+    source[0] = '(';
+    for (size_t i = 0; i < length; i++)
+        source[i + 1] = (letSection[i] == '\n' || letSection[i] == '\r') ? ' ' : letSection[i];
+    strcpy(source + length + 1, " 0)");
+
+    int errors = ctx->errorCount;
+    AST_NODE *prelude = ciLispParse(ctx, source);
+    free(source);
+
+    if (prelude == NULL || prelude->symbolTable == NULL || ctx->errorCount != errors)
+    {
+        if (ctx->errorCount == errors)
+            ciLispError(ctx, "the prelude has to be a let section: (let (name s_expr)...)");
+        freeNode(prelude);
+        return false;
+    }
+
+    if (checkForm(ctx, prelude, false) > 0)
+    {
+        freeNode(prelude);
+        return false;
+    }
+
+    // lambdas calling lambdas of the prelude are inlined here, once; forms are not optimized (see preludeAttach)
+    optimizeForm(ctx, prelude);
+
+    freeNode(ctx->prelude);
+    ctx->prelude = prelude;
+    ctx->preludeReads = readsInput(prelude); // once, not for every forked form
+    return true;
+}
+
+void preludeAttach(CILISP_CONTEXT *ctx, AST_NODE *form)
+{
+    if (ctx->prelude != NULL && form != NULL)
+        form->parent = ctx->prelude;
+}
+
+bool evalFormForked(CILISP_CONTEXT *ctx, AST_NODE *form)
+{
+    int status;
+
+    if (ctx->preludeReads || readsInput(form))
+    {
+        ciLispError(ctx, "read can not be used with --fork, the form was not evaluated");
+        return false;
+    }
+
+    // drawn here, so the next form does not get the same rand values as this one
+    uint64_t seed = randomNext(&ctx->random);
+
+    // nothing buffered may be written twice
+    outputFlush(ctx);
+    if (ctx->errorStream != NULL)
+        fflush(ctx->errorStream);
+
+    pid_t child = fork();
+    if (child < 0)
+    {
+        ciLispError(ctx, "fork failed, the form was not evaluated");
+        return false;
+    }
+
+    if (child == 0)
+    {
+        randomSeed(&ctx->random, seed);
+        printRetVal(ctx, evalForm(ctx, form));
+        outputFlush(ctx);
+        if (ctx->errorStream != NULL)
+            fflush(ctx->errorStream);
+        _exit(ctx->errorCount > 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+
+    while (waitpid(child, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+            return false;
+    }
+
+    if (WIFSIGNALED(status))
+        outputPrintf(ctx, "ERROR: the evaluation was ended by signal %d\n", WTERMSIG(status));
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
@@ -0,0 +1,20 @@
+#include "ciLisp.h"
+
+// Generator behind rand: xoshiro256** (Blackman and Vigna), one state per context.
+// It passes the usual statistical test suites, has a 2^256 - 1 period and gives 64 bits per step;
+// rand uses the top 53 of them for a uniform double in [0, 1). splitmix64 spreads the seed over the whole state
+// (which must not be all zeros). The definitions are RANDOM_FUNCTIONS in ciLisp.h, which --emit-c copies into
+// the generated code.
+
+RANDOM_FUNCTIONS(static inline, )
+
+void randomFill(RANDOM_STATE *state, double *values, size_t count)
+{
+    // a local copy keeps the state in registers for the whole loop
+    RANDOM_STATE local = *state;
+
+    for (size_t i = 0; i < count; i++)
+        values[i] = randomDouble(&local);
+
+    *state = local;
+}
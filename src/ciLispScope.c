@@ -0,0 +1,108 @@
+#include "ciLisp.h"
+
+// Symbol lookup in one scope (the symbolTable of an AST node).
+// Most let blocks are a handful of definitions and a list scan is the fastest way through them. Generated
+// programs can have hundreds, so a symbol table of SCOPE_INDEX_THRESHOLD or more definitions also gets an
+// open addressing hash table of its nodes. Both find the same node: the first in list order with the
+// identifier and symbol type asked for.
+
+struct symbol_index {
+    SYMBOL_TABLE_NODE **slots;
+    size_t mask;
+};
+
+// FNV-1a. Every table masks the hash down to its low bits, which barely depend on the start of the text, the
+// high ones do: they are folded in so that identifiers like v1 ... v900 still spread over the slots
+uint64_t hashText(const char *text, size_t length)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char) text[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash ^ (hash >> 32);
+}
+
+static size_t scopeSlot(SYMBOL_INDEX *index, const char *ident)
+{
+    return (size_t) hashText(ident, strlen(ident)) & index->mask;
+}
+
+void freeScopeIndex(AST_NODE *node)
+{
+    if (node->symbolIndex == NULL)
+        return;
+
+    free(node->symbolIndex->slots);
+    free(node->symbolIndex);
+    node->symbolIndex = NULL;
+}
+
+void indexScope(AST_NODE *node)
+{
+    size_t count = 0;
+    size_t size = 16;
+
+    freeScopeIndex(node);
+
+    for (SYMBOL_TABLE_NODE *symbol = node->symbolTable; symbol != NULL; symbol = symbol->next)
+        count++;
+
+    if (count < SCOPE_INDEX_THRESHOLD)
+        return;
+
+    while (size < count * 2)
+        size *= 2;
+
+    // without an index lookups just scan the list
+    SYMBOL_INDEX *index = malloc(sizeof(SYMBOL_INDEX));
+    if (index == NULL || (index->slots = calloc(size, sizeof(SYMBOL_TABLE_NODE *))) == NULL)
+    {
+        free(index);
+        return;
+    }
+    index->mask = size - 1;
+
+    for (SYMBOL_TABLE_NODE *symbol = node->symbolTable; symbol != NULL; symbol = symbol->next)
+    {
+        size_t slot = scopeSlot(index, symbol->ident);
+
+        // a later duplicate is shadowed by the first definition, as in the list
+        while (index->slots[slot] != NULL && (index->slots[slot]->sym_type != symbol->sym_type ||
+                                             strcmp(index->slots[slot]->ident, symbol->ident) != 0))
+            slot = (slot + 1) & index->mask;
+
+        if (index->slots[slot] == NULL)
+            index->slots[slot] = symbol;
+    }
+
+    node->symbolIndex = index;
+}
+
+SYMBOL_TABLE_NODE *findInScope(AST_NODE *node, const char *ident, SYMBOL_TYPE type)
+{
+    SYMBOL_INDEX *index = node->symbolIndex;
+
+    if (index == NULL)
+    {
+        for (SYMBOL_TABLE_NODE *symbol = node->symbolTable; symbol != NULL; symbol = symbol->next)
+        {
+            if (symbol->sym_type == type && !strcmp(ident, symbol->ident))
+                return symbol;
+        }
+
+        return NULL;
+    }
+
+    for (size_t slot = scopeSlot(index, ident); index->slots[slot] != NULL; slot = (slot + 1) & index->mask)
+    {
+        SYMBOL_TABLE_NODE *symbol = index->slots[slot];
+        if (symbol->sym_type == type && !strcmp(ident, symbol->ident))
+            return symbol;
+    }
+
+    return NULL;
+}
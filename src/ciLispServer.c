@@ -0,0 +1,688 @@
+#define _GNU_SOURCE // accept4
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "ciLisp.h"
+
+// Evaluation server (--serve).
+// Every message either way is a frame: a 4 byte length in network byte order, then that many bytes of text.
+//      request:    the expression on the first line, then one "name value" line per input
+//      response:   "int 42", "double 0.5" or "error <message>"
+// A client can send any number of requests without waiting; each connection gets its responses in the order
+// of its requests. One thread runs an epoll loop over the socket and the connections and cuts the requests out
+// of what they send; a pool of workers, each with a context of its own (and its own copy of the prelude),
+// evaluates them and hands the responses back to the loop through an eventfd.
+// Workers keep the compiled expressions they saw last (SERVER_CACHE of them, by the text of the expression and
+// the names of its inputs): a request that only changes input values is not parsed or checked again.
+
+typedef struct connection CONNECTION;
+
+typedef struct request {
+    CONNECTION *connection;
+    char *body; // '\0' terminated
+    OUTPUT_BUFFER response;
+    bool failed;
+    bool done;
+    struct request *next; // the connection's next request
+    struct request *nextWork; // in the work queue, then in the finished list
+} REQUEST;
+
+struct connection {
+    int fd;
+    char *input; // received, not cut into requests yet
+    size_t inputLength;
+    size_t inputCapacity;
+    OUTPUT_BUFFER output; // responses not written yet
+    size_t written;
+    REQUEST *first; // requests not answered yet, in the order they came
+    REQUEST *last;
+    int pending;
+    uint32_t events; // what epoll waits for
+    bool closing; // nothing more is read: the peer is done or sent a frame that is too long
+    bool closed; // the fd is closed, the connection is freed once the events epoll returned with it are handled
+    CONNECTION *prev; // open connections, only the loop touches them
+    CONNECTION *next; // or the closed ones
+    CONNECTION *nextAnswered; // connections with newly answered requests
+    bool answered;
+};
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    REQUEST *queueHead;
+    REQUEST *queueTail;
+    REQUEST *finished;
+    int wakeFd; // eventfd written by the workers when they finish requests
+    bool stopping;
+    int epollFd;
+    CONNECTION *connections;
+    CONNECTION *closed;
+    const char *prelude;
+    uint64_t seed;
+    bool freshRand;
+    BUDGET budget;
+} SERVER;
+
+typedef struct {
+    char *key;
+    AST_NODE *form;
+} CACHED_FORM;
+
+// A "name value" line binds name, the value is a number literal like read accepts
+static bool bindInputLine(CILISP_CONTEXT *ctx, char *line, OUTPUT_BUFFER *key)
+{
+    char *value = strchr(line, ' ');
+    if (value == NULL || value == line)
+    {
+        ciLispError(ctx, "an input line is \"name value\"");
+        return false;
+    }
+    *value++ = '\0';
+
+    size_t length = strlen(value);
+    if (length >= READ_TOKEN || !readCheck(value, length))
+    {
+        ciLispError(ctx, "an input value is not a number");
+        return false;
+    }
+
+    bindInput(ctx, line, parseDecimal(value, length));
+    bufferWrite(key, "\n", 1);
+    bufferWrite(key, line, strlen(line));
+    return true;
+}
+
+// The checked tree of the request's expression for the inputs it binds, from the cache or compiled into it
+static AST_NODE *requestForm(CILISP_CONTEXT *ctx, CACHED_FORM *cache, const char *expression, OUTPUT_BUFFER *key)
+{
+    CACHED_FORM *slot = &cache[hashText(key->data, key->length) % SERVER_CACHE];
+    if (slot->key != NULL && !strcmp(slot->key, key->data))
+    {
+        if (ctx->metrics != NULL)
+            METRIC_ADD(ctx->metrics->cacheHits, 1);
+        return slot->form;
+    }
+
+    if (ctx->metrics != NULL)
+        METRIC_ADD(ctx->metrics->cacheMisses, 1);
+
+    AST_NODE *form = ciLispParse(ctx, expression);
+    ctx->quit = false;
+
+    if (form == NULL || ctx->errorCount > 0)
+    {
+        if (ctx->errorCount == 0)
+            ciLispError(ctx, "no s-expression to evaluate");
+        freeNode(form);
+        return NULL;
+    }
+
+    // inputs the request does not bind are unbound symbols, as in the REPL
+    preludeAttach(ctx, form);
+    if (checkForm(ctx, form, false) > 0)
+    {
+        freeNode(form);
+        return NULL;
+    }
+    if (ctx->prelude == NULL) // see evalStream
+        optimizeForm(ctx, form);
+
+    free(slot->key);
+    freeNode(slot->form);
+    slot->key = strdup(key->data);
+    slot->form = form;
+    return form;
+}
+
+static void serveRequest(CILISP_CONTEXT *ctx, CACHED_FORM *cache, REQUEST *request)
+{
+    char *expression = request->body;
+    char *line = strchr(expression, '\n');
+    OUTPUT_BUFFER key = {0};
+    AST_NODE *form = NULL;
+
+    ctx->errorCount = 0;
+    ctx->error[0] = '\0';
+    ctx->endOfInput = false;
+    clearInputs(ctx);
+
+    if (line != NULL)
+        *line++ = '\0';
+    bufferWrite(&key, expression, strlen(expression));
+
+    while (line != NULL && ctx->errorCount == 0)
+    {
+        char *next = strchr(line, '\n');
+        if (next != NULL)
+            *next++ = '\0';
+        if (*line != '\0')
+            bindInputLine(ctx, line, &key);
+        line = next;
+    }
+    bufferWrite(&key, "", 1);
+
+    if (ctx->errorCount == 0)
+        form = requestForm(ctx, cache, expression, &key);
+    bufferFree(&key);
+
+    RET_VAL val = {DOUBLE_TYPE, NAN};
+    if (form != NULL)
+        val = evalForm(ctx, form);
+
+    request->failed = ctx->errorCount > 0;
+    if (request->failed)
+        bufferPrintf(&request->response, "error %s", ctx->error);
+    else if (val.type == INT_TYPE)
+    {
+        bufferWrite(&request->response, "int ", 4);
+        bufferLong(&request->response, val.value.ival);
+    }
+    else
+    {
+        bufferWrite(&request->response, "double ", 7);
+        bufferDouble(&request->response, val.value.dval);
+    }
+}
+
+static void *serverWorker(void *argument)
+{
+    SERVER *server = argument;
+    CACHED_FORM cache[SERVER_CACHE] = {{0}};
+    CILISP_CONTEXT ctx;
+
+    ciLispContextInit(&ctx);
+    ctx.quiet = true; // no output, and read has no input: a request is answered with its value only
+    randomSeed(&ctx.random, server->seed);
+    ctx.freshRand = server->freshRand;
+    ctx.budget = server->budget; // a request over budget gets an error, the worker goes on with the next one
+    if (server->prelude != NULL)
+        preludeLoad(&ctx, server->prelude); // already loaded once by runServer, it does not fail
+
+    for (;;)
+    {
+        pthread_mutex_lock(&server->lock);
+        while (server->queueHead == NULL && !server->stopping)
+            pthread_cond_wait(&server->work, &server->lock);
+        REQUEST *request = server->queueHead;
+        if (request != NULL && (server->queueHead = request->nextWork) == NULL)
+            server->queueTail = NULL;
+        pthread_mutex_unlock(&server->lock);
+
+        if (request == NULL)
+            break;
+
+        serveRequest(&ctx, cache, request);
+
+        pthread_mutex_lock(&server->lock);
+        request->nextWork = server->finished;
+        server->finished = request;
+        pthread_mutex_unlock(&server->lock);
+
+        // an eventfd write only fails when the counter would overflow, the loop is woken up then anyway
+        uint64_t one = 1;
+        ssize_t written = write(server->wakeFd, &one, sizeof(one));
+        (void) written;
+    }
+
+    for (int i = 0; i < SERVER_CACHE; i++)
+    {
+        free(cache[i].key);
+        freeNode(cache[i].form);
+    }
+    ciLispContextFree(&ctx);
+    return NULL;
+}
+
+static void freeRequest(REQUEST *request)
+{
+    free(request->body);
+    bufferFree(&request->response);
+    free(request);
+}
+
+// Waits for reads while the connection takes requests and neither its open requests nor the responses it did
+// not read yet pile up, for writes while output is left
+static void updateEvents(int epollFd, CONNECTION *connection)
+{
+    uint32_t events = 0;
+    if (!connection->closing && connection->pending < SERVER_MAX_PENDING &&
+        connection->output.length - connection->written < OUTPUT_LIMIT)
+        events |= EPOLLIN;
+    if (connection->written < connection->output.length)
+        events |= EPOLLOUT;
+
+    if (events == connection->events)
+        return;
+
+    // with nothing to wait for the connection leaves the set, epoll would still report it hung up over and over
+    struct epoll_event event = {events, {.ptr = connection}};
+    int operation = (events == 0) ? EPOLL_CTL_DEL : (connection->events == 0) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    epoll_ctl(epollFd, operation, connection->fd, &event);
+    connection->events = events;
+}
+
+// Another event of the same epoll_wait() may still point at the connection, so it is only moved to the closed
+// ones here and freeClosed() frees it after the loop is through all of them
+static void closeConnection(SERVER *server, CONNECTION *connection)
+{
+    while (connection->first != NULL)
+    {
+        REQUEST *request = connection->first;
+        connection->first = request->next;
+        freeRequest(request);
+    }
+
+    if (connection->prev != NULL)
+        connection->prev->next = connection->next;
+    else
+        server->connections = connection->next;
+    if (connection->next != NULL)
+        connection->next->prev = connection->prev;
+
+    close(connection->fd); // also takes it out of the epoll set
+    connection->closed = true;
+    connection->next = server->closed;
+    server->closed = connection;
+}
+
+static void freeClosed(SERVER *server)
+{
+    while (server->closed != NULL)
+    {
+        CONNECTION *connection = server->closed;
+        server->closed = connection->next;
+        free(connection->input);
+        bufferFree(&connection->output);
+        free(connection);
+    }
+}
+
+// Closes the connection once it is closing and nothing is left to answer or to write; otherwise makes epoll
+// wait for what it needs next
+static void updateConnection(SERVER *server, CONNECTION *connection)
+{
+    if (connection->closing && connection->first == NULL && connection->written == connection->output.length)
+        closeConnection(server, connection);
+    else
+        updateEvents(server->epollFd, connection);
+}
+
+// The peer is gone: nothing more is read or written, the connection goes once the workers are done with it
+static void abandonConnection(SERVER *server, CONNECTION *connection)
+{
+    connection->closing = true;
+    connection->written = connection->output.length = 0;
+    updateConnection(server, connection);
+}
+
+// Writes out what the answered requests at the head of the connection have for it, as far as the socket takes it
+static void writeResponses(SERVER *server, CONNECTION *connection)
+{
+    while (connection->first != NULL && connection->first->done)
+    {
+        REQUEST *request = connection->first;
+        uint32_t length = htonl((uint32_t) request->response.length);
+
+        bufferWrite(&connection->output, &length, sizeof(length));
+        bufferWrite(&connection->output, request->response.data, request->response.length);
+
+        if ((connection->first = request->next) == NULL)
+            connection->last = NULL;
+        connection->pending--;
+        freeRequest(request);
+    }
+
+    while (connection->written < connection->output.length)
+    {
+        ssize_t count = send(connection->fd, connection->output.data + connection->written,
+                             connection->output.length - connection->written, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (count <= 0)
+        {
+            abandonConnection(server, connection);
+            return;
+        }
+        connection->written += (size_t) count;
+    }
+
+    if (connection->written == connection->output.length)
+        connection->written = connection->output.length = 0;
+
+    updateConnection(server, connection);
+}
+
+// Reads what the connection sent and queues every complete frame in it as a request. Out of memory, the
+// connection is abandoned: the requests already queued are finished, then it is closed.
+static void readRequests(SERVER *server, CONNECTION *connection)
+{
+    bool failed = false;
+
+    for (;;)
+    {
+        if (connection->inputCapacity - connection->inputLength < 4096)
+        {
+            size_t capacity = connection->inputCapacity ? connection->inputCapacity * 2 : 16384;
+            char *input = realloc(connection->input, capacity);
+            if (input == NULL)
+            {
+                abandonConnection(server, connection);
+                return;
+            }
+            connection->input = input;
+            connection->inputCapacity = capacity;
+        }
+
+        ssize_t count = recv(connection->fd, connection->input + connection->inputLength,
+                             connection->inputCapacity - connection->inputLength, 0);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (count <= 0)
+        {
+            connection->closing = true; // what was sent before is still answered
+            break;
+        }
+        connection->inputLength += (size_t) count;
+    }
+
+    REQUEST *head = NULL;
+    REQUEST *tail = NULL;
+    size_t used = 0;
+
+    while (connection->inputLength - used >= 4)
+    {
+        uint32_t length;
+        memcpy(&length, connection->input + used, sizeof(length));
+        length = ntohl(length);
+
+        if (length > SERVER_MAX_FRAME)
+        {
+            connection->closing = true;
+            break;
+        }
+        if (connection->inputLength - used - 4 < length)
+            break;
+
+        REQUEST *request = calloc(1, sizeof(REQUEST));
+        char *body = malloc(length + 1);
+        if (request == NULL || body == NULL)
+        {
+            free(request);
+            free(body);
+            failed = true;
+            break;
+        }
+        request->connection = connection;
+        request->body = body;
+        memcpy(request->body, connection->input + used + 4, length);
+        request->body[length] = '\0';
+        used += 4 + length;
+
+        if (connection->last != NULL)
+            connection->last->next = request;
+        else
+            connection->first = request;
+        connection->last = request;
+        connection->pending++;
+
+        if (tail != NULL)
+            tail->nextWork = request;
+        else
+            head = request;
+        tail = request;
+    }
+
+    memmove(connection->input, connection->input + used, connection->inputLength - used);
+    connection->inputLength -= used;
+
+    // everything one read brought in goes to the workers at once
+    if (head != NULL)
+    {
+        pthread_mutex_lock(&server->lock);
+        if (server->queueTail != NULL)
+            server->queueTail->nextWork = head;
+        else
+            server->queueHead = head;
+        server->queueTail = tail;
+        pthread_cond_broadcast(&server->work);
+        pthread_mutex_unlock(&server->lock);
+    }
+
+    if (failed)
+        abandonConnection(server, connection);
+    else
+        updateConnection(server, connection);
+}
+
+static int listenOn(const char *path, FILE *report)
+{
+    struct sockaddr_un address = {AF_UNIX};
+
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        fprintf(report, "--serve: the socket path is too long\n");
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(path); // left behind by a server that did not stop cleanly
+    if (fd < 0 || bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        fprintf(report, "--serve: %s: %s\n", path, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int runServer(const char *path, int workerCount, const char *prelude, uint64_t seed, bool freshRand,
+              const BUDGET *budget, FILE *report)
+{
+    SERVER server = {.prelude = prelude, .seed = seed, .freshRand = freshRand, .budget = *budget};
+
+    if (prelude != NULL)
+    {
+        CILISP_CONTEXT ctx;
+        ciLispContextInit(&ctx);
+        bool loaded = preludeLoad(&ctx, prelude);
+        if (!loaded)
+            fprintf(report, "--prelude: %s\n", ctx.error);
+        ciLispContextFree(&ctx);
+        if (!loaded)
+            return -1;
+    }
+
+    int listenFd = listenOn(path, report);
+    if (listenFd < 0)
+        return -1;
+
+    // SIGINT and SIGTERM stop the loop, the workers inherit the mask
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    int signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    server.epollFd = epoll_create1(EPOLL_CLOEXEC);
+    server.wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    struct epoll_event event = {EPOLLIN};
+    bool running = signalFd >= 0 && server.epollFd >= 0 && server.wakeFd >= 0;
+    event.data.ptr = &listenFd;
+    running = running && epoll_ctl(server.epollFd, EPOLL_CTL_ADD, listenFd, &event) == 0;
+    event.data.ptr = &signalFd;
+    running = running && epoll_ctl(server.epollFd, EPOLL_CTL_ADD, signalFd, &event) == 0;
+    event.data.ptr = &server.wakeFd;
+    running = running && epoll_ctl(server.epollFd, EPOLL_CTL_ADD, server.wakeFd, &event) == 0;
+    if (!running)
+        fprintf(report, "--serve: %s\n", strerror(errno));
+
+    if (workerCount <= 0)
+        workerCount = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.work, NULL);
+
+    pthread_t workers[workerCount];
+    int started = 0;
+    while (running && started < workerCount && pthread_create(&workers[started], NULL, serverWorker, &server) == 0)
+        started++;
+
+    if (running && started == 0)
+    {
+        fprintf(report, "--serve: no worker could be started\n");
+        running = false;
+    }
+    bool failedToStart = !running;
+    if (running)
+        fprintf(report, "--serve: listening on %s with %d workers\n", path, started);
+    fflush(report);
+
+    double start = now();
+    long served = 0;
+    long failed = 0;
+    long connections = 0;
+    struct epoll_event events[64];
+
+    while (running)
+    {
+        int count = epoll_wait(server.epollFd, events, 64, -1);
+        if (count < 0 && errno != EINTR)
+            break;
+
+        for (int i = 0; i < count; i++)
+        {
+            void *source = events[i].data.ptr;
+
+            if (source == &signalFd)
+            {
+                struct signalfd_siginfo signal;
+                if (read(signalFd, &signal, sizeof(signal)) == sizeof(signal)) // it is not delivered again later
+                    running = false;
+            }
+            else if (source == &listenFd)
+            {
+                int fd;
+                while ((fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                {
+                    CONNECTION *connection = calloc(1, sizeof(CONNECTION));
+                    if (connection == NULL)
+                    {
+                        close(fd);
+                        continue;
+                    }
+                    connection->fd = fd;
+                    connection->events = EPOLLIN;
+                    if ((connection->next = server.connections) != NULL)
+                        connection->next->prev = connection;
+                    server.connections = connection;
+
+                    struct epoll_event added = {EPOLLIN, {.ptr = connection}};
+                    epoll_ctl(server.epollFd, EPOLL_CTL_ADD, fd, &added);
+                    connections++;
+                }
+            }
+            else if (source == &server.wakeFd)
+            {
+                uint64_t counter;
+                if (read(server.wakeFd, &counter, sizeof(counter)) < 0)
+                    continue;
+
+                pthread_mutex_lock(&server.lock);
+                REQUEST *finished = server.finished;
+                server.finished = NULL;
+                pthread_mutex_unlock(&server.lock);
+
+                // all of them are marked first, so each connection writes out as much as it can at once
+                CONNECTION *answered = NULL;
+                for (REQUEST *request = finished; request != NULL; request = request->nextWork)
+                {
+                    request->done = true;
+                    served++;
+                    failed += request->failed;
+                    if (!request->connection->answered)
+                    {
+                        request->connection->answered = true;
+                        request->connection->nextAnswered = answered;
+                        answered = request->connection;
+                    }
+                }
+                while (answered != NULL)
+                {
+                    CONNECTION *connection = answered;
+                    answered = connection->nextAnswered;
+                    connection->answered = false;
+                    writeResponses(&server, connection); // frees the requests, maybe closes the connection
+                }
+            }
+            else
+            {
+                CONNECTION *connection = source;
+                if (connection->closed) // by the answers to an earlier event of this batch
+                    continue;
+                if ((events[i].events & (EPOLLERR | EPOLLHUP)) && !(events[i].events & EPOLLIN))
+                    abandonConnection(&server, connection);
+                else if (events[i].events & EPOLLOUT)
+                    writeResponses(&server, connection);
+                else if (events[i].events & EPOLLIN)
+                    readRequests(&server, connection);
+            }
+        }
+        freeClosed(&server);
+    }
+
+    // the workers finish the request they are on and leave the rest
+    pthread_mutex_lock(&server.lock);
+    server.stopping = true;
+    server.queueHead = server.queueTail = NULL;
+    pthread_cond_broadcast(&server.work);
+    pthread_mutex_unlock(&server.lock);
+
+    while (started-- > 0)
+        pthread_join(workers[started], NULL);
+
+    if (!failedToStart)
+        fprintf(report, "--serve: %ld requests (%ld failed) from %ld connections in %.1f s\n",
+                served, failed, connections, now() - start);
+
+    // every request left, queued or finished, is still in the list of its connection
+    while (server.connections != NULL)
+        closeConnection(&server, server.connections);
+    freeClosed(&server);
+
+    close(listenFd);
+    unlink(path);
+    if (signalFd >= 0)
+        close(signalFd);
+    if (server.epollFd >= 0)
+        close(server.epollFd);
+    if (server.wakeFd >= 0)
+        close(server.wakeFd);
+    pthread_cond_destroy(&server.work);
+    pthread_mutex_destroy(&server.lock);
+    pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+
+    return failedToStart ? -1 : 0;
+}
@@ -0,0 +1,371 @@
+#include <ctype.h>
+#include "ciLisp.h"
+
+// Parse cache of the REPL.
+// Sessions keep re-sending one big ((let ...) body) form with small edits. Only the let elements and the
+// body whose text changed are parsed again; unchanged ones are moved over from the previous tree, so
+// the cost of a line is proportional to what changed in it.
+// Parts are matched by a hash of their text (then compared in full). Symbols are looked up through
+// parent pointers at evaluation time, so a moved definition only needs to be relinked to its new body.
+
+typedef struct session_part {
+    uint64_t hash;
+    char *text;
+    SYMBOL_TABLE_NODE *definition;
+    struct session_part *claim; // the part of the previous form with the same text
+    bool claimed;
+    struct session_part *next;
+} SESSION_PART;
+
+struct session {
+    char *source; // the whole last line, an identical line reuses the whole tree
+    AST_NODE *form;
+
+    // parts of form when it has the ((let elem...) body) shape
+    SESSION_PART *definitions; // in source order
+    char *bodyText;
+
+    // how many parts were parsed and how many taken over, for the trace
+    unsigned long parsed;
+    unsigned long reused;
+};
+
+static const char *skipSpace(const char *cursor)
+{
+    while (*cursor == ' ' || *cursor == '\t' || *cursor == '|' || *cursor == '\n' || *cursor == '\r')
+        cursor++;
+    return cursor;
+}
+
+// past the parenthesis closing the one at cursor, NULL when it is not closed
+static const char *skipList(const char *cursor)
+{
+    int depth = 0;
+
+    for (; *cursor != '\0'; cursor++)
+    {
+        if (*cursor == '(')
+            depth++;
+        else if (*cursor == ')' && --depth == 0)
+            return cursor + 1;
+    }
+
+    return NULL;
+}
+
+// past an atom or a list
+static const char *skipExpr(const char *cursor)
+{
+    if (*cursor == '(')
+        return skipList(cursor);
+
+    while (*cursor != '\0' && *cursor != '(' && *cursor != ')' && !isspace((unsigned char) *cursor) && *cursor != '|')
+        cursor++;
+
+    return cursor;
+}
+
+typedef struct {
+    const char *start;
+    size_t length;
+} SOURCE_RANGE;
+
+// Cuts ((let elem...) body) into its parts. Returns the number of elements, -1 for any other shape.
+static int sessionSplit(const char *source, SOURCE_RANGE **elements, SOURCE_RANGE *body)
+{
+    const char *cursor = skipSpace(source);
+    int count = 0;
+    int capacity = 0;
+
+    *elements = NULL;
+
+    if (*cursor != '(')
+        return -1;
+    cursor = skipSpace(cursor + 1);
+    if (*cursor != '(')
+        return -1;
+    cursor = skipSpace(cursor + 1);
+    if (strncmp(cursor, "let", 3) != 0 || (cursor[3] != '(' && !isspace((unsigned char) cursor[3])))
+        return -1;
+    cursor = skipSpace(cursor + 3);
+
+    while (*cursor == '(')
+    {
+        const char *end = skipList(cursor);
+        if (end == NULL)
+            break;
+
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 16;
+            *elements = realloc(*elements, capacity * sizeof(SOURCE_RANGE));
+        }
+        (*elements)[count++] = (SOURCE_RANGE) {cursor, (size_t) (end - cursor)};
+        cursor = skipSpace(end);
+    }
+
+    if (count == 0 || *cursor != ')')
+    {
+        free(*elements);
+        *elements = NULL;
+        return -1;
+    }
+
+    // the body is the one expression left before the closing parenthesis of the form
+    cursor = skipSpace(cursor + 1);
+    const char *bodyEnd = skipExpr(cursor);
+    if (bodyEnd == NULL || bodyEnd == cursor || *(bodyEnd = skipSpace(bodyEnd)) != ')' || *skipSpace(bodyEnd + 1) != '\0')
+    {
+        free(*elements);
+        *elements = NULL;
+        return -1;
+    }
+
+    *body = (SOURCE_RANGE) {cursor, (size_t) (bodyEnd - cursor)};
+    return count;
+}
+
+static void sessionFreeDefinition(SYMBOL_TABLE_NODE *definition)
+{
+    if (definition == NULL)
+        return;
+
+    free(definition->ident);
+    freeNode(definition->val);
+    free(definition);
+}
+
+static void sessionFreeParts(SESSION_PART *part)
+{
+    while (part != NULL)
+    {
+        SESSION_PART *next = part->next;
+        sessionFreeDefinition(part->definition);
+        free(part->text);
+        free(part);
+        part = next;
+    }
+}
+
+// Takes the form apart: the definitions stay in session->definitions, free to be taken over
+static void sessionDetach(SESSION *session)
+{
+    if (session->form != NULL && session->definitions != NULL)
+    {
+        session->form->symbolTable = NULL;
+        freeScopeIndex(session->form);
+    }
+
+    for (SESSION_PART *part = session->definitions; part != NULL; part = part->next)
+        part->claimed = false;
+}
+
+static void sessionForget(SESSION *session)
+{
+    sessionDetach(session);
+    freeNode(session->form);
+    sessionFreeParts(session->definitions);
+    free(session->bodyText);
+    free(session->source);
+
+    session->form = NULL;
+    session->definitions = NULL;
+    session->bodyText = NULL;
+    session->source = NULL;
+}
+
+static SESSION *sessionGet(CILISP_CONTEXT *ctx)
+{
+    if (ctx->session == NULL && (ctx->session = calloc(sizeof(SESSION), 1)) == NULL)
+        ciLispError(ctx, "Memory allocation failed!");
+
+    return ctx->session;
+}
+
+// Open addressing index of the previous form's parts by hash, so matching a line is linear in its length
+typedef struct {
+    SESSION_PART **slots;
+    size_t mask;
+} SESSION_INDEX;
+
+static size_t sessionSlot(SESSION_INDEX *index, uint64_t hash)
+{
+    return (size_t) hash & index->mask;
+}
+
+static void sessionIndex(SESSION_INDEX *index, SESSION_PART *parts)
+{
+    size_t count = 0;
+    size_t size = 16;
+
+    for (SESSION_PART *part = parts; part != NULL; part = part->next)
+        count++;
+    while (size < count * 2)
+        size *= 2;
+
+    index->slots = calloc(size, sizeof(SESSION_PART *));
+    index->mask = size - 1;
+
+    for (SESSION_PART *part = parts; part != NULL && index->slots != NULL; part = part->next)
+    {
+        size_t slot = sessionSlot(index, part->hash);
+        while (index->slots[slot] != NULL)
+            slot = (slot + 1) & index->mask;
+        index->slots[slot] = part;
+    }
+}
+
+// an unclaimed part of the previous form with the same text
+static SESSION_PART *sessionClaim(SESSION_INDEX *index, SESSION_PART *part)
+{
+    if (index->slots == NULL)
+        return NULL;
+
+    for (size_t slot = sessionSlot(index, part->hash); index->slots[slot] != NULL; slot = (slot + 1) & index->mask)
+    {
+        SESSION_PART *old = index->slots[slot];
+        if (!old->claimed && old->hash == part->hash && !strcmp(old->text, part->text))
+        {
+            old->claimed = true;
+            return old;
+        }
+    }
+
+    return NULL;
+}
+
+static AST_NODE *sessionParseParts(CILISP_CONTEXT *ctx, SESSION *session, const char *source,
+                                   SOURCE_RANGE *elements, int count, SOURCE_RANGE body)
+{
+    SESSION_PART *parts = NULL;
+    SESSION_PART **tail = &parts;
+    int errors = ctx->errorCount;
+    bool failed = false;
+    SESSION_INDEX index;
+
+    sessionIndex(&index, session->definitions);
+
+    // new definitions first, so a syntax error leaves the previous form untouched
+    for (int i = 0; i < count && !failed; i++)
+    {
+        SESSION_PART *part = calloc(sizeof(SESSION_PART), 1);
+        part->hash = hashText(elements[i].start, elements[i].length);
+        part->text = strndup(elements[i].start, elements[i].length);
+        *tail = part;
+        tail = &part->next;
+
+        part->claim = sessionClaim(&index, part);
+        if (part->claim == NULL && (part->definition = ciLispParseDefinition(ctx, part->text)) == NULL)
+            failed = true;
+    }
+
+    free(index.slots);
+
+    bool sameBody = (session->bodyText != NULL && strlen(session->bodyText) == body.length &&
+                     !strncmp(session->bodyText, body.start, body.length));
+    AST_NODE *bodyNode = NULL;
+
+    if (!sameBody && ctx->errorCount == errors)
+    {
+        char *bodyText = strndup(body.start, body.length);
+        bodyNode = ciLispParse(ctx, bodyText);
+        free(bodyText);
+    }
+
+    if (failed || ctx->errorCount != errors || ctx->quit || (!sameBody && bodyNode == NULL))
+    {
+        for (SESSION_PART *part = parts; part != NULL; part = part->next)
+        {
+            if (part->claim != NULL)
+                part->claim->claimed = false;
+        }
+
+        freeNode(bodyNode);
+        sessionFreeParts(parts);
+        return NULL;
+    }
+
+    // take over the unchanged definitions, then the body
+    sessionDetach(session);
+    SYMBOL_TABLE_NODE *letList = NULL;
+
+    for (SESSION_PART *part = parts; part != NULL; part = part->next)
+    {
+        if (part->claim != NULL)
+        {
+            part->definition = part->claim->definition;
+            part->claim->definition = NULL;
+            part->claim = NULL;
+            session->reused++;
+        }
+        else
+            session->parsed++;
+
+        // same order linkLetSection gives: later definitions come first
+        letList = linkLetSection(letList, part->definition);
+    }
+
+    if (sameBody)
+    {
+        bodyNode = session->form;
+        session->form = NULL;
+        session->reused++;
+    }
+    else
+        session->parsed++;
+
+    sessionForget(session);
+    session->form = linkASTtoLetList(letList, bodyNode);
+    session->definitions = parts;
+    session->bodyText = strndup(body.start, body.length);
+    session->source = strdup(source);
+
+    TRACE(ctx, "session: %lu parts parsed, %lu taken over so far\n", session->parsed, session->reused);
+    return session->form;
+}
+
+AST_NODE *sessionParse(CILISP_CONTEXT *ctx, const char *source)
+{
+    SESSION *session = sessionGet(ctx);
+
+    if (session == NULL)
+        return NULL;
+
+    if (session->source != NULL && !strcmp(session->source, source))
+    {
+        session->reused++;
+        return session->form;
+    }
+
+    SOURCE_RANGE *elements;
+    SOURCE_RANGE body;
+    int count = sessionSplit(source, &elements, &body);
+
+    if (count > 0)
+    {
+        AST_NODE *form = sessionParseParts(ctx, session, source, elements, count, body);
+        free(elements);
+        return form;
+    }
+
+    // any other shape is parsed as a whole
+    AST_NODE *form = ciLispParse(ctx, source);
+    if (form == NULL)
+        return NULL;
+
+    sessionForget(session);
+    session->form = form;
+    session->source = strdup(source);
+    session->parsed++;
+    return form;
+}
+
+void sessionEnd(CILISP_CONTEXT *ctx)
+{
+    if (ctx->session == NULL)
+        return;
+
+    sessionForget(ctx->session);
+    free(ctx->session);
+    ctx->session = NULL;
+}